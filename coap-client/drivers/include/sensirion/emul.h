@@ -0,0 +1,118 @@
+#ifndef SENSIRION_EMUL_H
+#define SENSIRION_EMUL_H
+
+#include <stdint.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/drivers/sensor.h>
+
+/* Faults injected into the transfers of an emulated Sensirion sensor */
+enum sensirion_emul_fault {
+	SENSIRION_EMUL_FAULT_NONE,
+	/* The address is not acknowledged, the transfer fails with -EIO */
+	SENSIRION_EMUL_FAULT_NACK,
+	/* The first CRC byte of a response is inverted */
+	SENSIRION_EMUL_FAULT_CRC,
+	/* SDA is held low: every transfer fails until the fault is cleared */
+	SENSIRION_EMUL_FAULT_STUCK_BUS,
+};
+
+/*
+ * Synthetic signal: a triangle wave around base with the given amplitude and
+ * period, plus uniform noise of +/- noise. Values are in milli-units of the
+ * channel (ppm, degC, %RH, ug/m3). The noise sequence only depends on seed,
+ * so runs are reproducible.
+ */
+struct sensirion_emul_signal {
+	int32_t base;
+	int32_t amplitude;
+	uint32_t period_ms;
+	uint32_t noise;
+	uint32_t seed;
+};
+
+static inline int32_t sensirion_emul_signal_at(struct sensirion_emul_signal *sig, int64_t t_ms)
+{
+	int64_t value = sig->base;
+
+	if (sig->period_ms > 0 && sig->amplitude != 0) {
+		int64_t phase = t_ms % sig->period_ms;
+		int64_t half = sig->period_ms / 2;
+
+		/* -amplitude at phase 0, +amplitude at half a period */
+		if (phase < half) {
+			value += -sig->amplitude + (2 * (int64_t)sig->amplitude * phase) / MAX(half, 1);
+		} else {
+			value += sig->amplitude -
+				 (2 * (int64_t)sig->amplitude * (phase - half)) / MAX(half, 1);
+		}
+	}
+
+	if (sig->noise > 0) {
+		/* Numerical Recipes LCG */
+		sig->seed = sig->seed * 1664525U + 1013904223U;
+		value += (int64_t)(sig->seed >> 8) % (2 * (int64_t)sig->noise + 1) - sig->noise;
+	}
+
+	return (int32_t)value;
+}
+
+/*
+ * Seed of a noise sequence. The I2C address alone repeats on every bus, so the
+ * devicetree ordinal of the bus controller is mixed in, and the channel tells
+ * the signals of one sensor apart.
+ */
+static inline uint32_t sensirion_emul_seed(uint16_t addr, uint32_t bus_ord, uint32_t channel)
+{
+	/* Knuth's multiplicative hash */
+	return ((bus_ord << 16) | addr) * 2654435761U + channel;
+}
+
+/**
+ * @brief Inject a fault into the next transfers of an emulated SCD4x.
+ *
+ * @param target Emulator of the sensor
+ * @param fault Fault to inject, SENSIRION_EMUL_FAULT_NONE clears any fault
+ * @param count Number of transfers affected by a NACK or CRC fault, 0 for all
+ *              until cleared. Ignored for a stuck bus.
+ */
+void scd4x_emul_set_fault(const struct emul *target, enum sensirion_emul_fault fault,
+			  uint32_t count);
+
+/**
+ * @brief Set the signal sampled by an emulated SCD4x.
+ *
+ * @param target Emulator of the sensor
+ * @param chan SENSOR_CHAN_CO2_SCD, SENSOR_CHAN_AMBIENT_TEMP or SENSOR_CHAN_HUMIDITY
+ * @param sig Signal, copied
+ *
+ * @return 0 if successful, -EINVAL for another channel.
+ */
+int scd4x_emul_set_signal(const struct emul *target, enum sensor_channel chan,
+			  const struct sensirion_emul_signal *sig);
+
+/**
+ * @brief Inject a fault into the next transfers of an emulated SPS30.
+ *
+ * Same semantics as scd4x_emul_set_fault().
+ */
+void sps30_emul_set_fault(const struct emul *target, enum sensirion_emul_fault fault,
+			  uint32_t count);
+
+/**
+ * @brief Set the PM2.5 mass concentration signal of an emulated SPS30.
+ *
+ * The other mass and number concentrations follow PM2.5 with fixed ratios of
+ * a typical indoor size distribution.
+ *
+ * @param target Emulator of the sensor
+ * @param sig Signal in milli-ug/m3, copied
+ */
+void sps30_emul_set_signal(const struct emul *target, const struct sensirion_emul_signal *sig);
+
+/**
+ * @brief Set the flags reported by the Device Status Register of an emulated SPS30.
+ */
+void sps30_emul_set_status(const struct emul *target, uint32_t flags);
+
+#endif /* SENSIRION_EMUL_H */
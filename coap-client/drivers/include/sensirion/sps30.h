@@ -0,0 +1,37 @@
+#ifndef SENSIRION_SPS30_H
+#define SENSIRION_SPS30_H
+
+#include <zephyr/drivers/sensor.h>
+
+/* Channels of the SPS30 beyond SENSOR_CHAN_PM_1_0, SENSOR_CHAN_PM_2_5 and SENSOR_CHAN_PM_10 */
+#define SENSOR_CHAN_PM_4_0 (0x1000)
+#define SENSOR_CHAN_PM_0_5 (0x1001)
+#define SENSOR_CHAN_PM_1_0_NC (0x1002)
+#define SENSOR_CHAN_PM_2_5_NC (0x1003)
+#define SENSOR_CHAN_PM_4_0_NC (0x1004)
+#define SENSOR_CHAN_PM_10_NC (0x1005)
+#define SENSOR_CHAN_PM_TYPICAL_PARTICLE_SIZE (0x1006)
+
+#ifdef CONFIG_SENSIRION_I2C_ASYNC
+struct sensirion_i2c_async;
+
+/**
+ * Start reading a measurement without blocking, the counterpart of
+ * sensor_sample_fetch(). Completion is reported through the signal and/or
+ * callback @p op was initialized with.
+ *
+ * @return 0 if the read was started, -EBUSY if @p op is still in flight,
+ *         another error code otherwise
+ */
+int sps30_sample_fetch_async(const struct device *dev, struct sensirion_i2c_async *op);
+
+/**
+ * Collect a read started with sps30_sample_fetch_async(). On success the
+ * values are available through sensor_channel_get().
+ *
+ * @return 0 on success, the transfer or CRC error otherwise
+ */
+int sps30_sample_fetch_finish(const struct device *dev, const struct sensirion_i2c_async *op);
+#endif /* CONFIG_SENSIRION_I2C_ASYNC */
+
+#endif /* SENSIRION_SPS30_H */
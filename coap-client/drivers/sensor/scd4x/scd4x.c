@@ -16,6 +16,7 @@
 #include <zephyr/sys/crc.h>
 // #include <zephyr/devicetree.h>
 
+#include "aqm_trace.h"
 #include "scd4x.h"
 
 // enum sensor_attribute_scd4x {
@@ -28,7 +29,7 @@
 // };
 
 
-const struct cmds_t scd4x_cmds[] = {
+const struct cmds_t scd4x_cmds[SCD4X_CMD_COUNT] = {
 	{0x3646, 30},   {0x21B1, 0},  {0x3F86, 500}, {0xEC05, 1},   {0x241D, 1},     {0x2318, 1},
 	{0x2427, 1},    {0x2322, 1},  {0xE000, 1},   {0xE000, 1},   {0x362F, 400},   {0x2416, 1},
 	{0x2313, 1},    {0x21AC, 0},  {0xE4B8, 1},   {0x3615, 800}, {0x3639, 10000}, {0x3632, 1200},
@@ -49,6 +50,26 @@ static uint8_t scd4x_calc_crc(uint16_t value)
 	return crc8(buf, 2, SCD4X_CRC_POLY, SCD4X_CRC_INIT, false);
 }
 
+static int scd4x_check_crc(const uint8_t *rx_buf, uint8_t rx_buf_size)
+{
+	for (uint8_t i = 0; i < (rx_buf_size / 3); i++) {
+		if (scd4x_calc_crc(sys_get_be16(&rx_buf[i * 3])) != rx_buf[(i * 3) + 2]) {
+			LOG_ERR("Invalid CRC.");
+			return -EIO;
+		}
+	}
+
+	return 0;
+}
+
+/* Wait out the execution time of a command, visible as a span in the trace */
+static void scd4x_cmd_sleep(uint8_t cmd)
+{
+	AQM_TRACE("scd4x_sleep_start", scd4x_cmds[cmd].cmd, scd4x_cmds[cmd].cmd_duration_ms);
+	k_msleep(scd4x_cmds[cmd].cmd_duration_ms);
+	AQM_TRACE("scd4x_sleep_end", scd4x_cmds[cmd].cmd, 0);
+}
+
 static int scd4x_write_command(const struct device *dev, uint8_t cmd)
 {
 	const struct scd4x_config *cfg = dev->config;
@@ -57,10 +78,11 @@ static int scd4x_write_command(const struct device *dev, uint8_t cmd)
 
 	sys_put_be16(scd4x_cmds[cmd].cmd, tx_buf);
 
+	AQM_TRACE("scd4x_cmd", scd4x_cmds[cmd].cmd, cfg->bus.addr);
 	ret = i2c_write_dt(&cfg->bus, tx_buf, sizeof(tx_buf));
 
 	if (scd4x_cmds[cmd].cmd_duration_ms) {
-		k_msleep(scd4x_cmds[cmd].cmd_duration_ms);
+		scd4x_cmd_sleep(cmd);
 	}
 
 	return ret;
@@ -77,15 +99,25 @@ static int scd4x_read_reg(const struct device *dev, uint8_t *rx_buf, uint8_t rx_
 		return ret;
 	}
 
-	for (uint8_t i = 0; i < (rx_buf_size / 3); i++) {
-		ret = scd4x_calc_crc(sys_get_be16(&rx_buf[i * 3]));
-		if (ret != rx_buf[(i * 3) + 2]) {
-			LOG_ERR("Invalid CRC.");
-			return -EIO;
-		}
+	return scd4x_check_crc(rx_buf, rx_buf_size);
+}
+
+/*
+ * Every SCD4x read command has an execution time between the write and the read, so unlike
+ * the SPS30 none of them can use a combined write-then-read transaction.
+ */
+static int scd4x_read_cmd(const struct device *dev, uint8_t cmd, uint8_t *rx_buf,
+			  uint8_t rx_buf_size)
+{
+	int ret;
+
+	ret = scd4x_write_command(dev, cmd);
+	if (ret < 0) {
+		LOG_ERR("Failed to write command 0x%04x.", scd4x_cmds[cmd].cmd);
+		return ret;
 	}
 
-	return 0;
+	return scd4x_read_reg(dev, rx_buf, rx_buf_size);
 }
 
 static int scd4x_write_reg(const struct device *dev, uint8_t cmd, uint16_t *data, uint8_t data_size)
@@ -104,6 +136,7 @@ static int scd4x_write_reg(const struct device *dev, uint8_t cmd, uint16_t *data
 		tx_buf[tx_buf_pos++] = scd4x_calc_crc(data[i]);
 	}
 
+	AQM_TRACE("scd4x_cmd", scd4x_cmds[cmd].cmd, cfg->bus.addr);
 	ret = i2c_write_dt(&cfg->bus, tx_buf, sizeof(tx_buf));
 	if (ret < 0) {
 		LOG_ERR("Failed to write i2c data.");
@@ -111,7 +144,7 @@ static int scd4x_write_reg(const struct device *dev, uint8_t cmd, uint16_t *data
 	}
 
 	if (scd4x_cmds[cmd].cmd_duration_ms) {
-		k_msleep(scd4x_cmds[cmd].cmd_duration_ms);
+		scd4x_cmd_sleep(cmd);
 	}
 	return 0;
 }
@@ -122,13 +155,7 @@ static int scd4x_data_ready(const struct device *dev, bool *is_data_ready)
 	int ret;
 	*is_data_ready = false;
 
-	ret = scd4x_write_command(dev, SCD4X_CMD_GET_DATA_READY_STATUS);
-	if (ret < 0) {
-		LOG_ERR("Failed to write get_data_ready_status command.");
-		return ret;
-	}
-
-	ret = scd4x_read_reg(dev, rx_data, sizeof(rx_data));
+	ret = scd4x_read_cmd(dev, SCD4X_CMD_GET_DATA_READY_STATUS, rx_data, sizeof(rx_data));
 	if (ret < 0) {
 		LOG_ERR("Failed to read get_data_ready_status register.");
 		return ret;
@@ -149,13 +176,7 @@ static int scd4x_read_sample(const struct device *dev)
 	uint8_t rx_data[9];
 	int ret;
 
-	ret = scd4x_write_command(dev, SCD4X_CMD_READ_MEASUREMENT);
-	if (ret < 0) {
-		LOG_ERR("Failed to write read_measurement command.");
-		return ret;
-	}
-
-	ret = scd4x_read_reg(dev, rx_data, sizeof(rx_data));
+	ret = scd4x_read_cmd(dev, SCD4X_CMD_READ_MEASUREMENT, rx_data, sizeof(rx_data));
 	if (ret < 0) {
 		LOG_ERR("Failed to read read_measurement register.");
 		return ret;
@@ -228,9 +249,9 @@ static int scd4x_set_idle_mode(const struct device *dev)
 static int scd4x_set_temperature_offset(const struct device *dev, const struct sensor_value *val)
 {
 	int ret;
-	/*Calculation from Datasheet*/
+	/*Calculation from Datasheet, offset * 65535 / 175 in fixed point*/
 	uint16_t offset_temp =
-		(float)(val->val1 + (val->val2 / 1000000.0)) * 0xFFFF / SCD4X_MAX_TEMP;
+		scd4x_micro_to_temp_raw((int64_t)val->val1 * 1000000 + val->val2);
 
 	ret = scd4x_write_reg(dev, SCD4X_CMD_SET_TEMPERATURE_OFFSET, &offset_temp, 1);
 	if (ret < 0) {
@@ -332,12 +353,9 @@ static int scd4x_get_temperature_offset(const struct device *dev, struct sensor_
 		return ret;
 	}
 
-	int32_t temp;
-
 	/*Calculation from Datasheet*/
-	temp = sys_get_be16(rx_buf) * SCD4X_MAX_TEMP;
-	val->val1 = (int32_t)(temp / 0xFFFF);
-	val->val2 = ((temp % 0xFFFF) * 1000000) / 0xFFFF;
+	scd4x_micro_to_sensor_value(
+		scd4x_raw_to_micro(sys_get_be16(rx_buf), SCD4X_TEMP_SPAN_MICRO_Q16), val);
 
 	return 0;
 }
@@ -627,7 +645,8 @@ static int scd4x_sample_fetch(const struct device *dev, enum sensor_channel chan
 			return ret;
 		}
 		if (!is_data_ready) {
-			return 0;
+			/* the previous sample is still in place, but it is not a new one */
+			return -ENODATA;
 		}
 	}
 
@@ -651,20 +670,19 @@ static int scd4x_channel_get(const struct device *dev, enum sensor_channel chan,
 			     struct sensor_value *val)
 {
 	const struct scd4x_data *data = dev->data;
-	int64_t tmp_val;
 
 	switch (chan) {
 	case SENSOR_CHAN_AMBIENT_TEMP:
 		/*Calculation from Datasheet*/
-		tmp_val = data->temp_sample * SCD4X_MAX_TEMP;
-		val->val1 = (int32_t)(tmp_val / 0xFFFF) + SCD4X_MIN_TEMP;
-		val->val2 = ((tmp_val % 0xFFFF) * 1000000) / 0xFFFF;
+		scd4x_micro_to_sensor_value(
+			SCD4X_MIN_TEMP * 1000000 +
+				scd4x_raw_to_micro(data->temp_sample, SCD4X_TEMP_SPAN_MICRO_Q16),
+			val);
 		break;
 	case SENSOR_CHAN_HUMIDITY:
 		/*Calculation from Datasheet*/
-		tmp_val = data->humi_sample * 100;
-		val->val1 = (int32_t)(tmp_val / 0xFFFF);
-		val->val2 = ((tmp_val % 0xFFFF) * 1000000) / 0xFFFF;
+		scd4x_micro_to_sensor_value(
+			scd4x_raw_to_micro(data->humi_sample, SCD4X_HUMI_SPAN_MICRO_Q16), val);
 		break;
 	case SENSOR_CHAN_CO2_SCD:
 		val->val1 = data->co2_sample;
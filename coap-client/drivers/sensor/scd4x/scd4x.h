@@ -10,6 +10,7 @@
 #include <zephyr/drivers/sensor.h>
 #include <zephyr/drivers/i2c.h>
 #include <zephyr/device.h>
+#include <sensirion/scd4x.h>
 
 #define SCD4X_CMD_REINIT                         0
 #define SCD4X_CMD_START_PERIODIC_MEASUREMENT     1
@@ -37,6 +38,7 @@
 #define SCD4X_CMD_GET_SELF_CALIB_INITIAL_PERIOD  23
 #define SCD4X_CMD_SET_SELF_CALIB_STANDARD_PERIOD 24
 #define SCD4X_CMD_GET_SELF_CALIB_STANDARD_PERIOD 25
+#define SCD4X_CMD_COUNT                          26
 
 #define SCD4X_CRC_POLY 0x31
 #define SCD4X_CRC_INIT 0xFF
@@ -51,17 +53,21 @@
 #define SCD4X_MAX_TEMP 175
 #define SCD4X_MIN_TEMP -45
 
+/*
+ * The datasheet scales raw words by x / (2^16 - 1). In fixed point that is
+ * (x * K + 2^15) >> 16 with K = scale * 2^16 / (2^16 - 1), rounded to the
+ * nearest millionth with one 32x32->64 multiply and no division.
+ */
+#define SCD4X_TEMP_SPAN_MICRO_Q16 175002670ULL /* 175e6 * 65536 / 65535 */
+#define SCD4X_HUMI_SPAN_MICRO_Q16 100001526ULL /* 100e6 * 65536 / 65535 */
+/* Inverse for the temperature offset, 65535 / 175e6 in Q40 */
+#define SCD4X_TEMP_RAW_PER_MICRO_Q40 411751397ULL
+
 enum scd4x_model_t {
 	SCD4X_MODEL_SCD40,
 	SCD4X_MODEL_SCD41,
 };
 
-enum scd4x_mode_t {
-	SCD4X_MODE_NORMAL,
-	SCD4X_MODE_LOW_POWER,
-	SCD4X_MODE_SINGLE_SHOT,
-};
-
 struct scd4x_config {
 	struct i2c_dt_spec bus;
 	enum scd4x_model_t model;
@@ -79,88 +85,28 @@ struct cmds_t {
 	uint16_t cmd_duration_ms;
 };
 
-
-
- enum sensor_attribute_scd4x {
-     /* Offset temperature: Toffset_actual = Tscd4x – Treference + Toffset_previous
-      * 0 - 20°C
-      */
-     SENSOR_ATTR_SCD4X_TEMPERATURE_OFFSET = SENSOR_ATTR_PRIV_START,
-     /* Altidude of the sensor;
-      * 0 - 3000m
-      */
-     SENSOR_ATTR_SCD4X_SENSOR_ALTITUDE,
-     /* Ambient pressure in hPa
-      * 700 - 1200hPa
-      */
-     SENSOR_ATTR_SCD4X_AMBIENT_PRESSURE,
-     /* Set the current state (enabled: 1 / disabled: 0).
-      * Default: enabled.
-      */
-     SENSOR_ATTR_SCD4X_AUTOMATIC_CALIB_ENABLE,
-     /* Set the initial period for automatic self calibration correction in hours. Allowed values
-      * are integer multiples of 4 hours.
-      * Default: 44
-      */
-     SENSOR_ATTR_SCD4X_SELF_CALIB_INITIAL_PERIOD,
-     /* Set the standard period for automatic self calibration correction in hours. Allowed
-      * values are integer multiples of 4 hours. Default: 156
-      */
-     SENSOR_ATTR_SCD4X_SELF_CALIB_STANDARD_PERIOD,
- };
- 
- /**
-  * @brief Performs a forced recalibration.
-  *
-  * Operate the SCD4x in the operation mode for at least 3 minutes in an environment with a
-  * homogeneous and constant CO2 concentration. Otherwise the recalibratioin will fail. The sensor
-  * must be operated at the voltage desired for the application when performing the FRC sequence.
-  *
-  * @param dev Pointer to the sensor device
-  * @param target_concentration Reference CO2 concentration.
-  * @param frc_correction Previous differences from the target concentration
-  *
-  * @return 0 if successful, negative errno code if failure.
-  */
- int scd4x_forced_recalibration(const struct device *dev, uint16_t target_concentration,
-                    uint16_t *frc_correction);
- 
- /**
-  * @brief Performs a self test.
-  *
-  * The self_test command can be used as an end-of-line test to check the sensor functionality
-  *
-  * @param dev Pointer to the sensor device
-  *
-  * @return 0 if successful, negative errno code if failure.
-  */
- int scd4x_self_test(const struct device *dev);
- 
- /**
-  * @brief Performs a self test.
-  *
-  * The persist_settings command can be used to save the actual configuration. This command
-  * should only be sent when persistence is required and if actual changes to the configuration have
-  * been made. The EEPROM is guaranteed to withstand at least 2000 write cycles
-  *
-  * @param dev Pointer to the sensor device
-  *
-  * @return 0 if successful, negative errno code if failure.
-  */
- int scd4x_persist_settings(const struct device *dev);
- 
- /**
-  * @brief Performs a factory reset.
-  *
-  * The perform_factory_reset command resets all configuration settings stored in the EEPROM and
-  * erases the FRC and ASC algorithm history.
-  *
-  * @param dev Pointer to the sensor device
-  *
-  * @return 0 if successful, negative errno code if failure.
-  */
- int scd4x_factory_reset(const struct device *dev);
- #define SENSOR_CHAN_CO2_SCD (0x1007)
-
+/* Command codes and execution times, indexed by SCD4X_CMD_* */
+extern const struct cmds_t scd4x_cmds[SCD4X_CMD_COUNT];
+
+/* Millionths as sensor_value, 32-bit division by constants only */
+static inline void scd4x_micro_to_sensor_value(int32_t micro, struct sensor_value *val)
+{
+	val->val1 = micro / 1000000;
+	val->val2 = micro % 1000000;
+}
+
+/* raw * span / (2^16 - 1) in millionths, see SCD4X_TEMP_SPAN_MICRO_Q16 */
+static inline int32_t scd4x_raw_to_micro(uint16_t raw, uint64_t span_q16)
+{
+	return (int32_t)((raw * span_q16 + BIT(15)) >> 16);
+}
+
+/* Temperature span in millionths to a raw word, clamped to 0..SCD4X_MAX_TEMP */
+static inline uint16_t scd4x_micro_to_temp_raw(int64_t micro)
+{
+	micro = CLAMP(micro, 0, SCD4X_MAX_TEMP * 1000000LL);
+
+	return (uint16_t)((micro * SCD4X_TEMP_RAW_PER_MICRO_Q40 + BIT64(39)) >> 40);
+}
 
 #endif /* ZEPHYR_DRIVERS_SENSOR_SCD4X_H_ */
@@ -0,0 +1,476 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include <sensirion/emul.h>
+
+#include "scd4x.h"
+
+LOG_MODULE_REGISTER(SCD4X_EMUL, CONFIG_SENSOR_LOG_LEVEL);
+
+#define SCD4X_EMUL_PERIOD_MS           5000
+#define SCD4X_EMUL_LOW_POWER_PERIOD_MS 30000
+#define SCD4X_EMUL_MAX_WORDS           3
+
+/* Datasheet factory defaults */
+#define SCD4X_EMUL_DEFAULT_TEMP_OFFSET    0x0912
+#define SCD4X_EMUL_DEFAULT_PRESSURE       1013
+#define SCD4X_EMUL_DEFAULT_INITIAL_PERIOD 44
+#define SCD4X_EMUL_DEFAULT_STANDARD_PERIOD 156
+
+enum scd4x_emul_state {
+	SCD4X_EMUL_IDLE,
+	SCD4X_EMUL_PERIODIC,
+	SCD4X_EMUL_SINGLE_SHOT,
+	SCD4X_EMUL_POWER_DOWN,
+};
+
+struct scd4x_emul_data {
+	enum scd4x_emul_state state;
+	/* Commands and reads before this uptime are not acknowledged */
+	int64_t busy_until;
+	int64_t next_sample;
+	uint32_t period_ms;
+	bool data_ready;
+	bool rht_only;
+
+	/* Command the next read answers, -1 if there is nothing to read */
+	int cmd;
+	uint16_t frc_target;
+
+	uint16_t co2;
+	uint16_t temp;
+	uint16_t humi;
+
+	uint16_t temp_offset;
+	uint16_t altitude;
+	uint16_t pressure;
+	uint16_t asc_enabled;
+	uint16_t asc_initial_period;
+	uint16_t asc_standard_period;
+
+	struct sensirion_emul_signal co2_signal;
+	struct sensirion_emul_signal temp_signal;
+	struct sensirion_emul_signal humi_signal;
+
+	enum sensirion_emul_fault fault;
+	uint32_t fault_count;
+};
+
+struct scd4x_emul_cfg {
+	enum scd4x_model_t model;
+	/* Devicetree ordinal of the I2C controller */
+	uint32_t bus_ord;
+};
+
+static uint8_t scd4x_emul_crc(uint16_t value)
+{
+	uint8_t buf[2];
+
+	sys_put_be16(value, buf);
+
+	return crc8(buf, 2, SCD4X_CRC_POLY, SCD4X_CRC_INIT, false);
+}
+
+static int scd4x_emul_find_cmd(uint16_t code, bool has_arg)
+{
+	for (int i = 0; i < SCD4X_CMD_COUNT; i++) {
+		if (scd4x_cmds[i].cmd != code) {
+			continue;
+		}
+		/* Set and get ambient pressure share one code */
+		if (i == SCD4X_CMD_SET_AMBIENT_PRESSURE && !has_arg) {
+			return SCD4X_CMD_GET_AMBIENT_PRESSURE;
+		}
+		return i;
+	}
+
+	return -1;
+}
+
+static uint16_t scd4x_emul_clamp(int64_t raw)
+{
+	return (uint16_t)CLAMP(raw, 0, UINT16_MAX);
+}
+
+/* Signals are in milli-units, the raw formats are the inverse of the datasheet conversions */
+static void scd4x_emul_sample(struct scd4x_emul_data *data, int64_t t_ms)
+{
+	int32_t temp_mc = sensirion_emul_signal_at(&data->temp_signal, t_ms);
+	int32_t humi_mrh = sensirion_emul_signal_at(&data->humi_signal, t_ms);
+
+	data->temp = scd4x_emul_clamp(((int64_t)temp_mc + 45000) * UINT16_MAX / 175000);
+	data->humi = scd4x_emul_clamp((int64_t)humi_mrh * UINT16_MAX / 100000);
+	data->co2 = data->rht_only ? 0 :
+		    scd4x_emul_clamp(sensirion_emul_signal_at(&data->co2_signal, t_ms) / 1000);
+	data->data_ready = true;
+}
+
+/* Catch up with the measurements that completed since the last transfer */
+static void scd4x_emul_update(struct scd4x_emul_data *data, int64_t now)
+{
+	switch (data->state) {
+	case SCD4X_EMUL_PERIODIC:
+		while (now >= data->next_sample) {
+			scd4x_emul_sample(data, data->next_sample);
+			data->next_sample += data->period_ms;
+		}
+		break;
+	case SCD4X_EMUL_SINGLE_SHOT:
+		if (now >= data->busy_until) {
+			scd4x_emul_sample(data, data->busy_until);
+			data->state = SCD4X_EMUL_IDLE;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static bool scd4x_emul_allowed(const struct scd4x_emul_data *data, int cmd)
+{
+	switch (data->state) {
+	case SCD4X_EMUL_PERIODIC:
+		return cmd == SCD4X_CMD_READ_MEASUREMENT || cmd == SCD4X_CMD_GET_DATA_READY_STATUS ||
+		       cmd == SCD4X_CMD_STOP_PERIODIC_MEASUREMENT ||
+		       cmd == SCD4X_CMD_SET_AMBIENT_PRESSURE ||
+		       cmd == SCD4X_CMD_GET_AMBIENT_PRESSURE;
+	case SCD4X_EMUL_POWER_DOWN:
+		return cmd == SCD4X_CMD_WAKE_UP;
+	default:
+		return true;
+	}
+}
+
+static int scd4x_emul_write(const struct emul *target, const uint8_t *buf, uint32_t len,
+			    int64_t now)
+{
+	const struct scd4x_emul_cfg *cfg = target->cfg;
+	struct scd4x_emul_data *data = target->data;
+	uint16_t arg = 0;
+	int cmd;
+
+	if (len < 2 || (len - 2) % 3 != 0) {
+		return -EIO;
+	}
+
+	if (len > 2) {
+		arg = sys_get_be16(&buf[2]);
+		if (scd4x_emul_crc(arg) != buf[4]) {
+			LOG_WRN("Argument CRC mismatch");
+			return -EIO;
+		}
+	}
+
+	cmd = scd4x_emul_find_cmd(sys_get_be16(buf), len > 2);
+	if (cmd < 0 || !scd4x_emul_allowed(data, cmd)) {
+		return -EIO;
+	}
+
+	if (cfg->model == SCD4X_MODEL_SCD40 &&
+	    (cmd == SCD4X_CMD_MEASURE_SINGLE_SHOT || cmd == SCD4X_CMD_MEASURE_SINGLE_SHOT_RHT ||
+	     cmd == SCD4X_CMD_POWER_DOWN || cmd == SCD4X_CMD_WAKE_UP)) {
+		return -EIO;
+	}
+
+	data->cmd = -1;
+	data->busy_until = now + scd4x_cmds[cmd].cmd_duration_ms;
+
+	switch (cmd) {
+	case SCD4X_CMD_START_PERIODIC_MEASUREMENT:
+	case SCD4X_CMD_LOW_POWER_PERIODIC_MEASUREMENT:
+		data->period_ms = cmd == SCD4X_CMD_START_PERIODIC_MEASUREMENT
+					  ? SCD4X_EMUL_PERIOD_MS
+					  : SCD4X_EMUL_LOW_POWER_PERIOD_MS;
+		data->state = SCD4X_EMUL_PERIODIC;
+		data->next_sample = now + data->period_ms;
+		data->rht_only = false;
+		break;
+	case SCD4X_CMD_STOP_PERIODIC_MEASUREMENT:
+		data->state = SCD4X_EMUL_IDLE;
+		break;
+	case SCD4X_CMD_MEASURE_SINGLE_SHOT:
+	case SCD4X_CMD_MEASURE_SINGLE_SHOT_RHT:
+		data->state = SCD4X_EMUL_SINGLE_SHOT;
+		data->rht_only = cmd == SCD4X_CMD_MEASURE_SINGLE_SHOT_RHT;
+		break;
+	case SCD4X_CMD_POWER_DOWN:
+		data->state = SCD4X_EMUL_POWER_DOWN;
+		break;
+	case SCD4X_CMD_WAKE_UP:
+		if (data->state == SCD4X_EMUL_POWER_DOWN) {
+			/* The sensor wakes up but does not acknowledge the command */
+			data->state = SCD4X_EMUL_IDLE;
+			return -EIO;
+		}
+		break;
+	case SCD4X_CMD_SET_TEMPERATURE_OFFSET:
+		data->temp_offset = arg;
+		break;
+	case SCD4X_CMD_SET_SENSOR_ALTITUDE:
+		data->altitude = arg;
+		break;
+	case SCD4X_CMD_SET_AMBIENT_PRESSURE:
+		data->pressure = arg;
+		break;
+	case SCD4X_CMD_SET_AUTOMATIC_CALIB_ENABLE:
+		data->asc_enabled = arg;
+		break;
+	case SCD4X_CMD_SET_SELF_CALIB_INITIAL_PERIOD:
+		data->asc_initial_period = arg;
+		break;
+	case SCD4X_CMD_SET_SELF_CALIB_STANDARD_PERIOD:
+		data->asc_standard_period = arg;
+		break;
+	case SCD4X_CMD_FORCED_RECALIB:
+		data->frc_target = arg;
+		data->cmd = cmd;
+		break;
+	case SCD4X_CMD_FACTORY_RESET:
+		data->temp_offset = SCD4X_EMUL_DEFAULT_TEMP_OFFSET;
+		data->altitude = 0;
+		data->pressure = SCD4X_EMUL_DEFAULT_PRESSURE;
+		data->asc_enabled = 1;
+		data->asc_initial_period = SCD4X_EMUL_DEFAULT_INITIAL_PERIOD;
+		data->asc_standard_period = SCD4X_EMUL_DEFAULT_STANDARD_PERIOD;
+		break;
+	case SCD4X_CMD_READ_MEASUREMENT:
+	case SCD4X_CMD_GET_DATA_READY_STATUS:
+	case SCD4X_CMD_GET_TEMPERATURE_OFFSET:
+	case SCD4X_CMD_GET_SENSOR_ALTITUDE:
+	case SCD4X_CMD_GET_AMBIENT_PRESSURE:
+	case SCD4X_CMD_GET_AUTOMATIC_CALIB_ENABLE:
+	case SCD4X_CMD_GET_SELF_CALIB_INITIAL_PERIOD:
+	case SCD4X_CMD_GET_SELF_CALIB_STANDARD_PERIOD:
+	case SCD4X_CMD_SELF_TEST:
+		data->cmd = cmd;
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static int scd4x_emul_read(const struct emul *target, uint8_t *buf, uint32_t len, bool corrupt)
+{
+	struct scd4x_emul_data *data = target->data;
+	uint16_t words[SCD4X_EMUL_MAX_WORDS] = {0};
+	uint32_t num_words = 1;
+
+	switch (data->cmd) {
+	case SCD4X_CMD_READ_MEASUREMENT:
+		if (!data->data_ready) {
+			return -EIO;
+		}
+		words[0] = data->co2;
+		words[1] = data->temp;
+		words[2] = data->humi;
+		num_words = 3;
+		data->data_ready = false;
+		break;
+	case SCD4X_CMD_GET_DATA_READY_STATUS:
+		/* Only the lower 11 bits carry the flag */
+		words[0] = data->data_ready ? 0x8006 : 0x8000;
+		break;
+	case SCD4X_CMD_GET_TEMPERATURE_OFFSET:
+		words[0] = data->temp_offset;
+		break;
+	case SCD4X_CMD_GET_SENSOR_ALTITUDE:
+		words[0] = data->altitude;
+		break;
+	case SCD4X_CMD_GET_AMBIENT_PRESSURE:
+		words[0] = data->pressure;
+		break;
+	case SCD4X_CMD_GET_AUTOMATIC_CALIB_ENABLE:
+		words[0] = data->asc_enabled;
+		break;
+	case SCD4X_CMD_GET_SELF_CALIB_INITIAL_PERIOD:
+		words[0] = data->asc_initial_period;
+		break;
+	case SCD4X_CMD_GET_SELF_CALIB_STANDARD_PERIOD:
+		words[0] = data->asc_standard_period;
+		break;
+	case SCD4X_CMD_FORCED_RECALIB:
+		/* Correction is reported with an offset of 0x8000 */
+		words[0] = 0x8000 + data->frc_target - data->co2;
+		break;
+	case SCD4X_CMD_SELF_TEST:
+		words[0] = 0;
+		break;
+	default:
+		return -EIO;
+	}
+
+	if (len > num_words * 3) {
+		return -EIO;
+	}
+
+	for (uint32_t i = 0; i < len; i++) {
+		uint16_t word = words[i / 3];
+
+		switch (i % 3) {
+		case 0:
+			buf[i] = word >> 8;
+			break;
+		case 1:
+			buf[i] = word & 0xFF;
+			break;
+		default:
+			buf[i] = scd4x_emul_crc(word);
+			break;
+		}
+	}
+
+	if (corrupt && len >= 3) {
+		buf[2] ^= 0xFF;
+	}
+
+	return 0;
+}
+
+/* Returns true if the fault applies to this transfer, counting it down */
+static bool scd4x_emul_take_fault(struct scd4x_emul_data *data, enum sensirion_emul_fault fault)
+{
+	if (data->fault != fault) {
+		return false;
+	}
+
+	if (data->fault_count > 0 && --data->fault_count == 0) {
+		data->fault = SENSIRION_EMUL_FAULT_NONE;
+	}
+
+	return true;
+}
+
+static int scd4x_emul_transfer(const struct emul *target, struct i2c_msg *msgs, int num_msgs,
+			       int addr)
+{
+	struct scd4x_emul_data *data = target->data;
+	int64_t now = k_uptime_get();
+	int ret;
+
+	ARG_UNUSED(addr);
+
+	if (data->fault == SENSIRION_EMUL_FAULT_STUCK_BUS ||
+	    scd4x_emul_take_fault(data, SENSIRION_EMUL_FAULT_NACK)) {
+		return -EIO;
+	}
+
+	scd4x_emul_update(data, now);
+
+	/* The sensor does not acknowledge while a command is executing */
+	if (now < data->busy_until) {
+		return -EIO;
+	}
+
+	for (int i = 0; i < num_msgs; i++) {
+		if (msgs[i].flags & I2C_MSG_READ) {
+			ret = scd4x_emul_read(target, msgs[i].buf, msgs[i].len,
+					      scd4x_emul_take_fault(data, SENSIRION_EMUL_FAULT_CRC));
+		} else {
+			ret = scd4x_emul_write(target, msgs[i].buf, msgs[i].len, now);
+		}
+
+		if (ret < 0) {
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+void scd4x_emul_set_fault(const struct emul *target, enum sensirion_emul_fault fault,
+			  uint32_t count)
+{
+	struct scd4x_emul_data *data = target->data;
+
+	data->fault = fault;
+	data->fault_count = count;
+}
+
+int scd4x_emul_set_signal(const struct emul *target, enum sensor_channel chan,
+			  const struct sensirion_emul_signal *sig)
+{
+	struct scd4x_emul_data *data = target->data;
+
+	switch ((int)chan) {
+	case SENSOR_CHAN_CO2_SCD:
+		data->co2_signal = *sig;
+		break;
+	case SENSOR_CHAN_AMBIENT_TEMP:
+		data->temp_signal = *sig;
+		break;
+	case SENSOR_CHAN_HUMIDITY:
+		data->humi_signal = *sig;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static const struct i2c_emul_api scd4x_emul_api_i2c = {
+	.transfer = scd4x_emul_transfer,
+};
+
+static int scd4x_emul_init(const struct emul *target, const struct device *parent)
+{
+	struct scd4x_emul_data *data = target->data;
+	const struct scd4x_emul_cfg *cfg = target->cfg;
+	uint16_t addr = target->bus.i2c->addr;
+
+	ARG_UNUSED(parent);
+
+	data->state = SCD4X_EMUL_IDLE;
+	data->cmd = -1;
+	/* The sensor is not accessible before it has started up */
+	data->busy_until = SCD4X_STARTUP_TIME_MS;
+	data->temp_offset = SCD4X_EMUL_DEFAULT_TEMP_OFFSET;
+	data->pressure = SCD4X_EMUL_DEFAULT_PRESSURE;
+	data->asc_enabled = 1;
+	data->asc_initial_period = SCD4X_EMUL_DEFAULT_INITIAL_PERIOD;
+	data->asc_standard_period = SCD4X_EMUL_DEFAULT_STANDARD_PERIOD;
+
+	/* Indoor room: slow CO2 swing, stable temperature and humidity */
+	data->co2_signal = (struct sensirion_emul_signal){
+		.base = 650000, .amplitude = 150000, .period_ms = 600000, .noise = 5000,
+		.seed = sensirion_emul_seed(addr, cfg->bus_ord, 0),
+	};
+	data->temp_signal = (struct sensirion_emul_signal){
+		.base = 23000, .amplitude = 500, .period_ms = 600000, .noise = 50,
+		.seed = sensirion_emul_seed(addr, cfg->bus_ord, 1),
+	};
+	data->humi_signal = (struct sensirion_emul_signal){
+		.base = 45000, .amplitude = 2000, .period_ms = 600000, .noise = 200,
+		.seed = sensirion_emul_seed(addr, cfg->bus_ord, 2),
+	};
+
+	return 0;
+}
+
+#define SCD4X_EMUL(n, scd4x_model)                                                                 \
+	static struct scd4x_emul_data scd4x_emul_data_##scd4x_model##_##n;                         \
+	static const struct scd4x_emul_cfg scd4x_emul_cfg_##scd4x_model##_##n = {                  \
+		.model = scd4x_model,                                                              \
+		.bus_ord = DT_DEP_ORD(DT_INST_BUS(n)),                                             \
+	};                                                                                         \
+	EMUL_DT_INST_DEFINE(n, scd4x_emul_init, &scd4x_emul_data_##scd4x_model##_##n,              \
+			    &scd4x_emul_cfg_##scd4x_model##_##n, &scd4x_emul_api_i2c, NULL)
+
+#define DT_DRV_COMPAT sensirion_scd40
+DT_INST_FOREACH_STATUS_OKAY_VARGS(SCD4X_EMUL, SCD4X_MODEL_SCD40)
+#undef DT_DRV_COMPAT
+
+#define DT_DRV_COMPAT sensirion_scd41
+DT_INST_FOREACH_STATUS_OKAY_VARGS(SCD4X_EMUL, SCD4X_MODEL_SCD41)
+#undef DT_DRV_COMPAT
@@ -37,6 +37,7 @@
 
 #include "sensirion_common.h"
 #include "sensirion_i2c.h"
+#include <string.h>
 #include <zephyr/drivers/i2c.h>
 
 uint16_t sensirion_bytes_to_uint16_t(const uint8_t* bytes) {
@@ -58,6 +59,45 @@ float sensirion_bytes_to_float(const uint8_t* bytes) {
     return tmp.float32;
 }
 
+void sensirion_bytes_to_fixed(const uint8_t* bytes, int32_t* integer,
+                              int32_t* micro) {
+    uint32_t bits = sensirion_bytes_to_uint32_t(bytes);
+    uint32_t exponent = (bits >> 23) & 0xff;
+    /* value = mantissa * 2^-shift, with the implicit leading one */
+    uint32_t mantissa = (bits & 0x7fffff) | 0x800000;
+    int32_t shift = 150 - (int32_t)exponent;
+    uint32_t int_part;
+    uint32_t frac_part;
+
+    if (exponent == 0 || exponent == 0xff) {
+        /* Zero, subnormals (below 1e-38) and NaN; infinity saturates */
+        int_part = (exponent == 0xff && !(bits & 0x7fffff)) ? INT32_MAX : 0;
+        frac_part = 0;
+    } else if (shift <= 0) {
+        /* Integer, 2^24 or more */
+        int_part = shift >= -7 ? mantissa << -shift : INT32_MAX;
+        frac_part = 0;
+    } else if (shift < 32) {
+        int_part = mantissa >> shift;
+        frac_part = (uint32_t)(((uint64_t)(mantissa & ((1UL << shift) - 1)) *
+                                1000000) >> shift);
+    } else {
+        /* Below 1, the product has at most 44 significant bits */
+        int_part = 0;
+        frac_part = shift < 64
+                        ? (uint32_t)(((uint64_t)mantissa * 1000000) >> shift)
+                        : 0;
+    }
+
+    if (bits & 0x80000000) {
+        *integer = -(int32_t)int_part;
+        *micro = -(int32_t)frac_part;
+    } else {
+        *integer = (int32_t)int_part;
+        *micro = (int32_t)frac_part;
+    }
+}
+
 uint8_t sensirion_common_generate_crc(const uint8_t* data, uint16_t count) {
     uint16_t current_byte;
     uint8_t crc = CRC8_INIT;
@@ -84,8 +124,16 @@ int8_t sensirion_common_check_crc(const uint8_t* data, uint16_t count,
 }
 
 int16_t sensirion_i2c_general_call_reset(void) {
-    const uint8_t data = 0x06;
-    return sensirion_i2c_write(0, &data, (uint16_t)sizeof(data));
+    uint8_t data = 0x06;
+    const struct i2c_dt_spec general_call = {
+        .bus = sensirion_i2c_selected_bus(),
+        .addr = 0,
+    };
+
+    if (!general_call.bus)
+        return STATUS_FAIL;
+
+    return sensirion_i2c_write(&general_call, &data, (uint16_t)sizeof(data));
 }
 
 uint16_t sensirion_fill_cmd_send_buf(uint8_t* buf, uint16_t cmd,
@@ -108,17 +156,11 @@ uint16_t sensirion_fill_cmd_send_buf(uint8_t* buf, uint16_t cmd,
     return idx;
 }
 
-int16_t sensirion_i2c_read_words_as_bytes(const struct i2c_dt_spec *dev_bus, uint8_t* data,
-                                          uint16_t num_words) {
+static int16_t sensirion_unpack_words_as_bytes(const uint8_t* buf8, uint8_t* data,
+                                               uint16_t num_words) {
     int16_t ret;
     uint16_t i, j;
     uint16_t size = num_words * (SENSIRION_WORD_SIZE + CRC8_LEN);
-    uint16_t word_buf[SENSIRION_MAX_BUFFER_WORDS];
-    uint8_t* const buf8 = (uint8_t*)word_buf;
-
-    ret = sensirion_i2c_read(dev_bus, buf8, size);
-    if (ret != NO_ERROR)
-        return ret;
 
     /* check the CRC for each word */
     for (i = 0, j = 0; i < size; i += SENSIRION_WORD_SIZE + CRC8_LEN) {
@@ -135,22 +177,41 @@ int16_t sensirion_i2c_read_words_as_bytes(const struct i2c_dt_spec *dev_bus, uin
     return NO_ERROR;
 }
 
+static void sensirion_words_to_host_order(uint16_t* data_words,
+                                          uint16_t num_words) {
+    uint8_t i;
+    const uint8_t* word_bytes;
+
+    for (i = 0; i < num_words; ++i) {
+        word_bytes = (uint8_t*)&data_words[i];
+        data_words[i] = ((uint16_t)word_bytes[0] << 8) | word_bytes[1];
+    }
+}
+
+int16_t sensirion_i2c_read_words_as_bytes(const struct i2c_dt_spec *dev_bus, uint8_t* data,
+                                          uint16_t num_words) {
+    int16_t ret;
+    uint16_t size = num_words * (SENSIRION_WORD_SIZE + CRC8_LEN);
+    uint16_t word_buf[SENSIRION_MAX_BUFFER_WORDS];
+    uint8_t* const buf8 = (uint8_t*)word_buf;
+
+    ret = sensirion_i2c_read(dev_bus, buf8, size);
+    if (ret != NO_ERROR)
+        return ret;
+
+    return sensirion_unpack_words_as_bytes(buf8, data, num_words);
+}
+
 int16_t sensirion_i2c_read_words(const struct i2c_dt_spec *dev_bus, uint16_t* data_words,
                                  uint16_t num_words) {
     int16_t ret;
-    uint8_t i;
-    const uint8_t* word_bytes;
 
     ret = sensirion_i2c_read_words_as_bytes(dev_bus, (uint8_t*)data_words,
                                             num_words);
     if (ret != NO_ERROR)
         return ret;
 
-    for (i = 0; i < num_words; ++i) {
-        word_bytes = (uint8_t*)&data_words[i];
-        data_words[i] = ((uint16_t)word_bytes[0] << 8) | word_bytes[1];
-    }
-
+    sensirion_words_to_host_order(data_words, num_words);
     return NO_ERROR;
 }
 
@@ -177,6 +238,16 @@ int16_t sensirion_i2c_delayed_read_cmd(const struct i2c_dt_spec *dev_bus, uint16
     int16_t ret;
     uint8_t buf[SENSIRION_COMMAND_SIZE];
 
+    if (IS_ENABLED(CONFIG_SENSIRION_I2C_COMBINED_READ) && !delay_us) {
+        ret = sensirion_i2c_read_cmd_as_bytes(dev_bus, cmd, (uint8_t*)data_words,
+                                              num_words);
+        if (ret != NO_ERROR)
+            return ret;
+
+        sensirion_words_to_host_order(data_words, num_words);
+        return NO_ERROR;
+    }
+
     sensirion_fill_cmd_send_buf(buf, cmd, NULL, 0);
     ret = sensirion_i2c_write(dev_bus, buf, SENSIRION_COMMAND_SIZE);
     if (ret != NO_ERROR)
@@ -193,3 +264,189 @@ int16_t sensirion_i2c_read_cmd(const struct i2c_dt_spec *dev_bus, uint16_t cmd,
     return sensirion_i2c_delayed_read_cmd(dev_bus, cmd, 0, data_words,
                                           num_words);
 }
+
+int16_t sensirion_i2c_read_cmd_as_bytes(const struct i2c_dt_spec *dev_bus, uint16_t cmd,
+                                        uint8_t* data, uint16_t num_words) {
+    int16_t ret;
+    uint8_t cmd_buf[SENSIRION_COMMAND_SIZE];
+    uint16_t size = num_words * (SENSIRION_WORD_SIZE + CRC8_LEN);
+    uint16_t word_buf[SENSIRION_MAX_BUFFER_WORDS];
+    uint8_t* const buf8 = (uint8_t*)word_buf;
+
+    sensirion_fill_cmd_send_buf(cmd_buf, cmd, NULL, 0);
+
+    if (!IS_ENABLED(CONFIG_SENSIRION_I2C_COMBINED_READ)) {
+        ret = sensirion_i2c_write(dev_bus, cmd_buf, SENSIRION_COMMAND_SIZE);
+        if (ret != NO_ERROR)
+            return ret;
+
+        return sensirion_i2c_read_words_as_bytes(dev_bus, data, num_words);
+    }
+
+    ret = sensirion_i2c_write_read(dev_bus, cmd_buf, SENSIRION_COMMAND_SIZE,
+                                   buf8, size);
+    if (ret != NO_ERROR)
+        return ret;
+
+    return sensirion_unpack_words_as_bytes(buf8, data, num_words);
+}
+
+#ifdef CONFIG_SENSIRION_I2C_ASYNC
+enum sensirion_async_phase {
+    SENSIRION_ASYNC_WRITE,
+    SENSIRION_ASYNC_READ,
+    SENSIRION_ASYNC_WRITE_READ,
+};
+
+static void sensirion_async_complete(struct sensirion_i2c_async* op,
+                                     int result) {
+    op->result = result;
+    atomic_clear(&op->busy);
+
+    if (op->cb)
+        op->cb(op, op->result);
+    if (op->signal)
+        k_poll_signal_raise(op->signal, op->result);
+}
+
+static void sensirion_async_phase_done(struct sensirion_i2c_async* op,
+                                       int result) {
+    if (result == NO_ERROR && op->phase == SENSIRION_ASYNC_WRITE) {
+        /* replaces sensirion_sleep_usec(), schedulable from ISR context */
+        op->phase = SENSIRION_ASYNC_READ;
+        k_work_reschedule(&op->work, K_USEC(op->delay_us));
+        return;
+    }
+
+    sensirion_async_complete(op, result);
+}
+
+#ifdef CONFIG_I2C_CALLBACK
+static void sensirion_async_i2c_cb(const struct device* dev, int result,
+                                   void* data) {
+    ARG_UNUSED(dev);
+
+    sensirion_async_phase_done(data, result);
+}
+#endif /* CONFIG_I2C_CALLBACK */
+
+static int sensirion_async_start_phase(struct sensirion_i2c_async* op) {
+#ifdef CONFIG_I2C_CALLBACK
+    const bool tx = op->phase != SENSIRION_ASYNC_READ;
+    const bool rx = op->phase != SENSIRION_ASYNC_WRITE;
+
+    return sensirion_i2c_transfer_cb(op->dev_bus, &op->xfer, op->tx_buf,
+                                     tx ? op->tx_size : 0, op->rx_buf,
+                                     rx ? op->rx_size : 0,
+                                     sensirion_async_i2c_cb, op);
+#else
+    ARG_UNUSED(op);
+    return -ENOSYS;
+#endif
+}
+
+/* Fallback for controllers without callback support, runs in the work queue */
+static int sensirion_async_run_phase(struct sensirion_i2c_async* op) {
+    switch (op->phase) {
+        case SENSIRION_ASYNC_WRITE:
+            return sensirion_i2c_write(op->dev_bus, op->tx_buf, op->tx_size);
+        case SENSIRION_ASYNC_READ:
+            return sensirion_i2c_read(op->dev_bus, op->rx_buf, op->rx_size);
+        default:
+            return sensirion_i2c_write_read(op->dev_bus, op->tx_buf,
+                                            op->tx_size, op->rx_buf,
+                                            op->rx_size);
+    }
+}
+
+static void sensirion_async_work_handler(struct k_work* work) {
+    struct k_work_delayable* dwork = k_work_delayable_from_work(work);
+    struct sensirion_i2c_async* op =
+        CONTAINER_OF(dwork, struct sensirion_i2c_async, work);
+    int ret;
+
+    ret = sensirion_async_start_phase(op);
+    if (ret == -ENOSYS)
+        ret = sensirion_async_run_phase(op);
+    else if (ret == NO_ERROR)
+        return;
+
+    sensirion_async_phase_done(op, ret);
+}
+
+void sensirion_i2c_async_init(struct sensirion_i2c_async* op,
+                              struct k_poll_signal* signal,
+                              sensirion_i2c_async_cb_t cb, void* user_data) {
+    memset(op, 0, sizeof(*op));
+    k_work_init_delayable(&op->work, sensirion_async_work_handler);
+    op->signal = signal;
+    op->cb = cb;
+    op->user_data = user_data;
+}
+
+int16_t sensirion_i2c_delayed_read_cmd_async(struct sensirion_i2c_async* op,
+                                             const struct i2c_dt_spec* dev_bus,
+                                             uint16_t cmd, uint32_t delay_us,
+                                             uint16_t num_words) {
+    int ret;
+    uint16_t rx_size = num_words * (SENSIRION_WORD_SIZE + CRC8_LEN);
+
+    if (!num_words || rx_size > sizeof(op->rx_buf))
+        return -EINVAL;
+
+    if (!atomic_cas(&op->busy, 0, 1))
+        return -EBUSY;
+
+    op->dev_bus = dev_bus;
+    op->tx_size = sensirion_fill_cmd_send_buf(op->tx_buf, cmd, NULL, 0);
+    op->rx_size = rx_size;
+    op->delay_us = delay_us;
+    op->result = NO_ERROR;
+    op->phase = (IS_ENABLED(CONFIG_SENSIRION_I2C_COMBINED_READ) && !delay_us)
+                    ? SENSIRION_ASYNC_WRITE_READ
+                    : SENSIRION_ASYNC_WRITE;
+
+    if (op->signal)
+        k_poll_signal_reset(op->signal);
+
+    ret = sensirion_async_start_phase(op);
+    if (ret == -ENOSYS) {
+        k_work_reschedule(&op->work, K_NO_WAIT);
+        return NO_ERROR;
+    }
+
+    if (ret != NO_ERROR) {
+        atomic_clear(&op->busy);
+        return ret;
+    }
+
+    return NO_ERROR;
+}
+
+int16_t sensirion_i2c_async_get_words_as_bytes(const struct sensirion_i2c_async* op,
+                                               uint8_t* data, uint16_t num_words) {
+    if (atomic_get(&op->busy))
+        return -EBUSY;
+
+    if (op->result != NO_ERROR)
+        return op->result;
+
+    if (num_words * (SENSIRION_WORD_SIZE + CRC8_LEN) > op->rx_size)
+        return -EINVAL;
+
+    return sensirion_unpack_words_as_bytes(op->rx_buf, data, num_words);
+}
+
+int16_t sensirion_i2c_async_get_words(const struct sensirion_i2c_async* op,
+                                      uint16_t* data_words, uint16_t num_words) {
+    int16_t ret;
+
+    ret = sensirion_i2c_async_get_words_as_bytes(op, (uint8_t*)data_words,
+                                                 num_words);
+    if (ret != NO_ERROR)
+        return ret;
+
+    sensirion_words_to_host_order(data_words, num_words);
+    return NO_ERROR;
+}
+#endif /* CONFIG_SENSIRION_I2C_ASYNC */
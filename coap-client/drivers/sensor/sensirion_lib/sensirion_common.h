@@ -90,13 +90,29 @@ uint32_t sensirion_bytes_to_uint32_t(const uint8_t* bytes);
  */
 float sensirion_bytes_to_float(const uint8_t* bytes);
 
+/**
+ * sensirion_bytes_to_fixed() - Convert a big-endian IEEE 754 float to fixed
+ * point without floating point instructions
+ *
+ * The value is split like a Zephyr sensor_value: integer part and millionths,
+ * both truncated toward zero and with the sign of the value. Magnitudes beyond
+ * INT32_MAX saturate, NaN and subnormals give 0.
+ *
+ * @param bytes   An array of at least four bytes (MSB first)
+ * @param integer Integer part
+ * @param micro   Fractional part in millionths
+ */
+void sensirion_bytes_to_fixed(const uint8_t* bytes, int32_t* integer,
+                              int32_t* micro);
+
 uint8_t sensirion_common_generate_crc(const uint8_t* data, uint16_t count);
 
 int8_t sensirion_common_check_crc(const uint8_t* data, uint16_t count,
                                   uint8_t checksum);
 
 /**
- * sensirion_i2c_general_call_reset() - Send a general call reset.
+ * sensirion_i2c_general_call_reset() - Send a general call reset on the bus
+ *                                      chosen with sensirion_i2c_select_bus().
  *
  * @warning This will reset all attached I2C devices on the bus which support
  *          general call reset.
@@ -204,6 +220,128 @@ int16_t sensirion_i2c_delayed_read_cmd(const struct i2c_dt_spec *dev_bus, uint16
 int16_t sensirion_i2c_read_cmd(const struct i2c_dt_spec *dev_bus, uint16_t cmd,
                                uint16_t* data_words, uint16_t num_words);
 
+/**
+ * sensirion_i2c_read_cmd_as_bytes() - issue a command and read the response
+ *                                     words as byte-stream in one transaction
+ *
+ * With CONFIG_SENSIRION_I2C_COMBINED_READ the command and the read are sent as
+ * one write-then-read transfer (repeated start), otherwise as two separate
+ * transfers. Only use this for commands without an execution delay.
+ *
+ * @address:    Sensor i2c address
+ * @cmd:        Command
+ * @data:       Allocated buffer to store the read bytes
+ * @num_words:  Data words to read (without CRC bytes)
+ *
+ * @return      NO_ERROR on success, an error code otherwise
+ */
+int16_t sensirion_i2c_read_cmd_as_bytes(const struct i2c_dt_spec *dev_bus, uint16_t cmd,
+                                        uint8_t* data, uint16_t num_words);
+
+#ifdef CONFIG_SENSIRION_I2C_ASYNC
+#include <zephyr/kernel.h>
+#include "sensirion_i2c.h"
+
+#define SENSIRION_MAX_RX_BYTES (SENSIRION_MAX_BUFFER_WORDS * SENSIRION_WORD_SIZE)
+
+struct sensirion_i2c_async;
+
+/**
+ * Completion callback of an asynchronous command. It may run in ISR context
+ * and must not block.
+ */
+typedef void (*sensirion_i2c_async_cb_t)(struct sensirion_i2c_async* op,
+                                         int16_t result);
+
+/**
+ * struct sensirion_i2c_async - state of one asynchronous command/response
+ *                              exchange
+ *
+ * The structure is owned by the driver from the start of a command until its
+ * completion is reported, so it must not live on the stack of a function that
+ * returns before that. One structure handles one command at a time.
+ */
+struct sensirion_i2c_async {
+    const struct i2c_dt_spec* dev_bus;
+    struct k_work_delayable work;
+    struct k_poll_signal* signal;
+    sensirion_i2c_async_cb_t cb;
+    void* user_data;
+    atomic_t busy;
+    int16_t result;
+    uint8_t phase;
+    uint8_t tx_size;
+    uint16_t rx_size;
+    uint32_t delay_us;
+#ifdef CONFIG_I2C_CALLBACK
+    struct sensirion_i2c_xfer xfer;
+#endif
+    uint8_t tx_buf[SENSIRION_COMMAND_SIZE];
+    uint8_t rx_buf[SENSIRION_MAX_RX_BYTES];
+};
+
+/**
+ * sensirion_i2c_async_init() - prepare an asynchronous command context
+ * @op:         Context to initialize
+ * @signal:     Signal raised with the result on completion, may be NULL
+ * @cb:         Callback invoked with the result on completion, may be NULL
+ * @user_data:  Free for use by the owner of the context
+ */
+void sensirion_i2c_async_init(struct sensirion_i2c_async* op,
+                              struct k_poll_signal* signal,
+                              sensirion_i2c_async_cb_t cb, void* user_data);
+
+/**
+ * sensirion_i2c_delayed_read_cmd_async() - send a command, wait for the
+ *                                          sensor to process and read data
+ *                                          back without blocking the caller
+ *
+ * The command write and the read are issued with callback-based transfers when
+ * the I2C controller supports them, otherwise from the system work queue. The
+ * processing delay is a delayable work item instead of a sleep. Completion is
+ * reported through the signal and/or callback of @op, after which the data is
+ * fetched with sensirion_i2c_async_get_words() or
+ * sensirion_i2c_async_get_words_as_bytes().
+ *
+ * @op:         Initialized context, must not be busy
+ * @dev_bus:    Sensor i2c bus
+ * @cmd:        Command
+ * @delay_us:   Time in microseconds to delay sending the read request
+ * @num_words:  Data words to read (without CRC bytes)
+ *
+ * @return      NO_ERROR if the command was started, -EBUSY if @op still has a
+ *              command in flight, an error code otherwise
+ */
+int16_t sensirion_i2c_delayed_read_cmd_async(struct sensirion_i2c_async* op,
+                                             const struct i2c_dt_spec* dev_bus,
+                                             uint16_t cmd, uint32_t delay_us,
+                                             uint16_t num_words);
+
+/**
+ * sensirion_i2c_async_get_words_as_bytes() - check and fetch the data of a
+ *                                            completed asynchronous command
+ * @op:         Context of the completed command
+ * @data:       Allocated buffer to store the read bytes
+ * @num_words:  Data words to fetch (without CRC bytes)
+ *
+ * @return      NO_ERROR on success, the transfer or CRC error otherwise
+ */
+int16_t sensirion_i2c_async_get_words_as_bytes(const struct sensirion_i2c_async* op,
+                                               uint8_t* data, uint16_t num_words);
+
+/**
+ * sensirion_i2c_async_get_words() - check and fetch the data of a completed
+ *                                   asynchronous command in host word order
+ * @op:         Context of the completed command
+ * @data_words: Allocated buffer to store the read words
+ * @num_words:  Data words to fetch (without CRC bytes)
+ *
+ * @return      NO_ERROR on success, the transfer or CRC error otherwise
+ */
+int16_t sensirion_i2c_async_get_words(const struct sensirion_i2c_async* op,
+                                      uint16_t* data_words, uint16_t num_words);
+#endif /* CONFIG_SENSIRION_I2C_ASYNC */
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,6 +1,57 @@
 #include <zephyr/drivers/i2c.h>
+#include <zephyr/devicetree.h>
+#include "aqm_trace.h"
+#include "sensirion_common.h"
 #include "sensirion_i2c.h"
 
+#define SENSIRION_BUS_OF(node) DEVICE_DT_GET(DT_BUS(node)),
+
+/* Controllers with Sensirion sensors, one entry per sensor (may repeat) */
+static const struct device *const sensirion_sensor_buses[] = {
+    DT_FOREACH_STATUS_OKAY(sensirion_scd40, SENSIRION_BUS_OF)
+    DT_FOREACH_STATUS_OKAY(sensirion_scd41, SENSIRION_BUS_OF)
+    DT_FOREACH_STATUS_OKAY(sensirion_sps30, SENSIRION_BUS_OF)
+};
+
+static const struct device *sensirion_selected_bus;
+
+int16_t sensirion_i2c_select_bus(uint8_t bus_idx)
+{
+    uint8_t idx = 0;
+
+    /* Bus indices count distinct controllers in devicetree order */
+    for (size_t i = 0; i < ARRAY_SIZE(sensirion_sensor_buses); i++) {
+        bool seen = false;
+
+        for (size_t j = 0; j < i; j++) {
+            if (sensirion_sensor_buses[j] == sensirion_sensor_buses[i]) {
+                seen = true;
+                break;
+            }
+        }
+
+        if (seen) {
+            continue;
+        }
+
+        if (idx++ == bus_idx) {
+            sensirion_selected_bus = sensirion_sensor_buses[i];
+            return NO_ERROR;
+        }
+    }
+
+    return STATUS_FAIL;
+}
+
+const struct device *sensirion_i2c_selected_bus(void)
+{
+    if (!sensirion_selected_bus && ARRAY_SIZE(sensirion_sensor_buses) > 0) {
+        sensirion_selected_bus = sensirion_sensor_buses[0];
+    }
+
+    return sensirion_selected_bus;
+}
+
 
 void sensirion_sleep_usec(uint32_t useconds)
 {
@@ -10,12 +61,68 @@ void sensirion_sleep_usec(uint32_t useconds)
     }
 }
 
+/* Trace arguments: target address and byte count, then address and result */
 int8_t sensirion_i2c_read(const struct i2c_dt_spec *dev_bus, uint8_t *data, uint16_t count)
 {
-    return i2c_read_dt(dev_bus, data, count);
+    int ret;
+
+    AQM_TRACE("sens_i2c_rd_start", dev_bus->addr, count);
+    ret = i2c_read_dt(dev_bus, data, count);
+    AQM_TRACE("sens_i2c_rd_end", dev_bus->addr, ret);
+    return ret;
 }
 
 int8_t sensirion_i2c_write(const struct i2c_dt_spec *dev_bus, uint8_t *data, uint16_t count)
 {
-    return i2c_write_dt(dev_bus, data, count);
+    int ret;
+
+    AQM_TRACE("sens_i2c_wr_start", dev_bus->addr, count);
+    ret = i2c_write_dt(dev_bus, data, count);
+    AQM_TRACE("sens_i2c_wr_end", dev_bus->addr, ret);
+    return ret;
+}
+
+int8_t sensirion_i2c_write_read(const struct i2c_dt_spec *dev_bus, const uint8_t *tx,
+                                uint16_t tx_count, uint8_t *rx, uint16_t rx_count)
+{
+    int ret;
+
+    AQM_TRACE("sens_i2c_wrd_start", dev_bus->addr, tx_count + rx_count);
+    ret = i2c_write_read_dt(dev_bus, tx, tx_count, rx, rx_count);
+    AQM_TRACE("sens_i2c_wrd_end", dev_bus->addr, ret);
+    return ret;
+}
+
+#if defined(CONFIG_SENSIRION_I2C_ASYNC) && defined(CONFIG_I2C_CALLBACK)
+int sensirion_i2c_transfer_cb(const struct i2c_dt_spec *dev_bus, struct sensirion_i2c_xfer *xfer,
+                              const uint8_t *tx, uint16_t tx_count, uint8_t *rx,
+                              uint16_t rx_count, i2c_callback_t cb, void *userdata)
+{
+    uint8_t num_msgs = 0;
+
+    if (tx_count) {
+        xfer->msgs[num_msgs].buf = (uint8_t *)tx;
+        xfer->msgs[num_msgs].len = tx_count;
+        xfer->msgs[num_msgs].flags = I2C_MSG_WRITE;
+        num_msgs++;
+    }
+
+    if (rx_count) {
+        xfer->msgs[num_msgs].buf = rx;
+        xfer->msgs[num_msgs].len = rx_count;
+        xfer->msgs[num_msgs].flags = I2C_MSG_READ;
+        if (num_msgs) {
+            xfer->msgs[num_msgs].flags |= I2C_MSG_RESTART;
+        }
+        num_msgs++;
+    }
+
+    if (num_msgs == 0) {
+        return -EINVAL;
+    }
+
+    xfer->msgs[num_msgs - 1].flags |= I2C_MSG_STOP;
+
+    return i2c_transfer_cb_dt(dev_bus, xfer->msgs, num_msgs, cb, userdata);
 }
+#endif /* CONFIG_SENSIRION_I2C_ASYNC && CONFIG_I2C_CALLBACK */
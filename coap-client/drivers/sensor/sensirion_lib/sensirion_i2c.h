@@ -33,6 +33,7 @@
 #define SENSIRION_I2C_H
 
 #include "sensirion_arch_config.h"
+#include <zephyr/drivers/i2c.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,16 +41,25 @@ extern "C" {
 
 /**
  * Select the current i2c bus by index.
- * All following i2c operations will be directed at that bus.
+ * All following operations that are not bound to a sensor (e.g. the general
+ * call reset) will be directed at that bus. Sensor operations always use the
+ * bus of their i2c_dt_spec.
  *
- * THE IMPLEMENTATION IS OPTIONAL ON SINGLE-BUS SETUPS (all sensors on the same
- * bus)
+ * Indices count the distinct I2C controllers with Sensirion sensors in
+ * devicetree order. Without a selection, bus 0 is used.
  *
  * @param bus_idx   Bus index to select
  * @returns         0 on success, an error code otherwise
  */
 int16_t sensirion_i2c_select_bus(uint8_t bus_idx);
 
+/**
+ * Return the controller chosen with sensirion_i2c_select_bus().
+ *
+ * @returns the selected I2C controller, NULL if there are no Sensirion sensors
+ */
+const struct device *sensirion_i2c_selected_bus(void);
+
 /**
  * Initialize all hard- and software components that are needed for the I2C
  * communication.
@@ -86,6 +96,54 @@ int8_t sensirion_i2c_read(const struct i2c_dt_spec *dev_bus, uint8_t *data, uint
  */
 int8_t sensirion_i2c_write(const struct i2c_dt_spec *dev_bus, uint8_t *data, uint16_t count);
 
+/**
+ * Execute one combined write-then-read transaction on the I2C bus. The write
+ * phase is followed by a repeated start and the read phase, so the command and
+ * the response share a single address/stop sequence. Only use this for
+ * commands the sensor answers without an execution delay.
+ *
+ * @param dev_bus  I2C bus specification of the sensor
+ * @param tx       pointer to the buffer containing the bytes to write
+ * @param tx_count number of bytes to write
+ * @param rx       pointer to the buffer where the read data is to be stored
+ * @param rx_count number of bytes to read
+ * @returns 0 on success, error code otherwise
+ */
+int8_t sensirion_i2c_write_read(const struct i2c_dt_spec *dev_bus, const uint8_t *tx,
+                                uint16_t tx_count, uint8_t *rx, uint16_t rx_count);
+
+#if defined(CONFIG_SENSIRION_I2C_ASYNC) && defined(CONFIG_I2C_CALLBACK)
+/**
+ * Message storage of an asynchronous transfer. It must stay valid until the
+ * completion callback has run.
+ */
+struct sensirion_i2c_xfer {
+    struct i2c_msg msgs[2];
+};
+
+/**
+ * Start an asynchronous transfer on the I2C bus. Either phase may be omitted
+ * by passing a zero count; if both are given they are issued as one combined
+ * write-then-read transaction. The callback runs in the context the bus
+ * controller completes the transfer in, which is usually an ISR. This is the
+ * transport of sensirion_i2c_delayed_read_cmd_async().
+ *
+ * @param dev_bus  I2C bus specification of the sensor
+ * @param xfer     message storage, owned by the transfer until completion
+ * @param tx       pointer to the buffer containing the bytes to write
+ * @param tx_count number of bytes to write, 0 for a read-only transfer
+ * @param rx       pointer to the buffer where the read data is to be stored
+ * @param rx_count number of bytes to read, 0 for a write-only transfer
+ * @param cb       completion callback
+ * @param userdata argument handed to the completion callback
+ * @returns 0 if the transfer was started, -ENOSYS if the controller has no
+ *          callback support, another negative errno code otherwise
+ */
+int sensirion_i2c_transfer_cb(const struct i2c_dt_spec *dev_bus, struct sensirion_i2c_xfer *xfer,
+                              const uint8_t *tx, uint16_t tx_count, uint8_t *rx,
+                              uint16_t rx_count, i2c_callback_t cb, void *userdata);
+#endif /* CONFIG_SENSIRION_I2C_ASYNC && CONFIG_I2C_CALLBACK */
+
 /**
  * Sleep for a given number of microseconds. The function should delay the
  * execution approximately, but no less than, the given time.
@@ -36,24 +36,8 @@
 #include "sensirion_common.h"
 #include "sensirion_i2c.h"
 
-#define SPS_CMD_START_MEASUREMENT 0x0010
-#define SPS_CMD_START_MEASUREMENT_ARG 0x0300
-#define SPS_CMD_STOP_MEASUREMENT 0x0104
-#define SPS_CMD_READ_MEASUREMENT 0x0300
-#define SPS_CMD_START_STOP_DELAY_USEC 20000
-#define SPS_CMD_GET_DATA_READY 0x0202
-#define SPS_CMD_AUTOCLEAN_INTERVAL 0x8004
-#define SPS_CMD_GET_FIRMWARE_VERSION 0xd100
-#define SPS_CMD_GET_SERIAL 0xd033
-#define SPS_CMD_RESET 0xd304
-#define SPS_CMD_SLEEP 0x1001
-#define SPS_CMD_READ_DEVICE_STATUS_REG 0xd206
-#define SPS_CMD_START_MANUAL_FAN_CLEANING 0x5607
-#define SPS_CMD_WAKE_UP 0x1103
-#define SPS_CMD_DELAY_USEC 5000
-#define SPS_CMD_DELAY_WRITE_FLASH_USEC 20000
-
 #define SPS30_SERIAL_NUM_WORDS ((SPS30_MAX_SERIAL_LEN) / 2)
+#define SPS30_MEASUREMENT_NUM_WORDS (10 * 4 / SENSIRION_WORD_SIZE)
 
 int16_t sps30_probe(const struct i2c_dt_spec *dev_bus)
 {
@@ -81,15 +65,8 @@ int16_t sps30_get_serial(const struct i2c_dt_spec *dev_bus, char *serial)
 {
     int16_t error;
 
-    error = sensirion_i2c_write_cmd(dev_bus, SPS_CMD_GET_SERIAL);
-
-    if (error != NO_ERROR)
-    {
-        return error;
-    }
-
-    error = sensirion_i2c_read_words_as_bytes(
-        dev_bus, (uint8_t *)serial, SPS30_SERIAL_NUM_WORDS);
+    error = sensirion_i2c_read_cmd_as_bytes(
+        dev_bus, SPS_CMD_GET_SERIAL, (uint8_t *)serial, SPS30_SERIAL_NUM_WORDS);
 
     /* ensure a final '\0'. The firmware should always set this so this is just
      * in case something goes wrong.
@@ -126,26 +103,8 @@ int16_t sps30_read_data_ready(const struct i2c_dt_spec *dev_bus, uint16_t *data_
                                   data_ready, SENSIRION_NUM_WORDS(*data_ready));
 }
 
-int16_t sps30_read_measurement(const struct i2c_dt_spec *dev_bus, struct sps30_measurement *measurement)
+static void sps30_decode_measurement(const uint8_t data[10][4], struct sps30_measurement *measurement)
 {
-    int16_t error;
-    uint8_t data[10][4];
-
-    error =
-        sensirion_i2c_write_cmd(dev_bus, SPS_CMD_READ_MEASUREMENT);
-    if (error != NO_ERROR)
-    {
-        return error;
-    }
-
-    error = sensirion_i2c_read_words_as_bytes(dev_bus, &data[0][0],
-                                              SENSIRION_NUM_WORDS(data));
-
-    if (error != NO_ERROR)
-    {
-        return error;
-    }
-
     measurement->mc_1p0 = sensirion_bytes_to_float(data[0]);
     measurement->mc_2p5 = sensirion_bytes_to_float(data[1]);
     measurement->mc_4p0 = sensirion_bytes_to_float(data[2]);
@@ -156,7 +115,22 @@ int16_t sps30_read_measurement(const struct i2c_dt_spec *dev_bus, struct sps30_m
     measurement->nc_4p0 = sensirion_bytes_to_float(data[7]);
     measurement->nc_10p0 = sensirion_bytes_to_float(data[8]);
     measurement->typical_particle_size = sensirion_bytes_to_float(data[9]);
+}
+
+int16_t sps30_read_measurement(const struct i2c_dt_spec *dev_bus, struct sps30_measurement *measurement)
+{
+    int16_t error;
+    uint8_t data[10][4];
 
+    error = sensirion_i2c_read_cmd_as_bytes(dev_bus, SPS_CMD_READ_MEASUREMENT,
+                                            &data[0][0], SENSIRION_NUM_WORDS(data));
+
+    if (error != NO_ERROR)
+    {
+        return error;
+    }
+
+    sps30_decode_measurement(data, measurement);
     return 0;
 }
 
@@ -277,91 +251,160 @@ int16_t sps30_read_device_status_register(const struct i2c_dt_spec *dev_bus, uin
     return 0;
 }
 
-static int sps30_sample_fetch(const struct device *dev, enum sensor_channel chan)
+#ifdef CONFIG_SENSIRION_I2C_ASYNC
+int16_t sps30_read_measurement_async(const struct i2c_dt_spec *dev_bus,
+                                     struct sensirion_i2c_async *op)
 {
-    struct sps30_data *data = dev->data;
-    const struct sps30_config *cfg = dev->config;
-    struct sps30_measurement m;
+    return sensirion_i2c_delayed_read_cmd_async(op, dev_bus, SPS_CMD_READ_MEASUREMENT, 0,
+                                                SPS30_MEASUREMENT_NUM_WORDS);
+}
 
-    int16_t ret = sps30_read_measurement(&cfg->bus, &m);
+int16_t sps30_read_measurement_finish(const struct sensirion_i2c_async *op,
+                                      struct sps30_measurement *measurement)
+{
+    int16_t error;
+    uint8_t data[10][4];
 
-    if (ret < 0)
+    error = sensirion_i2c_async_get_words_as_bytes(op, &data[0][0],
+                                                   SENSIRION_NUM_WORDS(data));
+    if (error != NO_ERROR)
     {
-        return ret;
+        return error;
     }
 
-    data->mc_1p0 = m.mc_1p0;
-    data->mc_2p5 = m.mc_2p5;
-    data->mc_4p0 = m.mc_4p0;
-    data->mc_10p0 = m.mc_10p0;
-    data->nc_0p5 = m.nc_0p5;
-    data->nc_1p0 = m.nc_1p0;
-    data->nc_2p5 = m.nc_2p5;
-    data->nc_4p0 = m.nc_4p0;
-    data->nc_10p0 = m.nc_10p0;
-    data->typical_particle_size = m.typical_particle_size;
+    sps30_decode_measurement(data, measurement);
     return 0;
 }
 
-static int sps30_channel_get(const struct device *dev, enum sensor_channel chan, struct sensor_value *val)
+int16_t sps30_read_data_ready_async(const struct i2c_dt_spec *dev_bus,
+                                    struct sensirion_i2c_async *op)
 {
-    const struct sps30_data *data = dev->data;
+    return sensirion_i2c_delayed_read_cmd_async(op, dev_bus, SPS_CMD_GET_DATA_READY, 0, 1);
+}
 
-    if (chan == SENSOR_CHAN_PM_1_0)
-    {
-        sensor_value_from_float(val, data->mc_1p0);
-        return 0;
-    }
-    if (chan == SENSOR_CHAN_PM_2_5)
-    {
-        sensor_value_from_float(val, data->mc_2p5);
-        return 0;
-    }
-    if (chan == SENSOR_CHAN_PM_10)
-    {
-        sensor_value_from_float(val, data->mc_10p0);
-        return 0;
-    }
-    if (chan == SENSOR_CHAN_PM_4_0)
-    {
-        sensor_value_from_float(val, data->mc_4p0);
-        return 0;
-    }
+int16_t sps30_read_data_ready_finish(const struct sensirion_i2c_async *op,
+                                     uint16_t *data_ready)
+{
+    return sensirion_i2c_async_get_words(op, data_ready, SENSIRION_NUM_WORDS(*data_ready));
+}
 
-    if (chan == SENSOR_CHAN_PM_0_5)
-    {
-        sensor_value_from_float(val, data->nc_0p5);
-        return 0;
-    }
-    if (chan == SENSOR_CHAN_PM_1_0_NC)
-    {
-        sensor_value_from_float(val, data->nc_1p0);
-        return 0;
-    }
-    if (chan == SENSOR_CHAN_PM_2_5_NC)
+int16_t sps30_read_device_status_register_async(const struct i2c_dt_spec *dev_bus,
+                                                struct sensirion_i2c_async *op)
+{
+    return sensirion_i2c_delayed_read_cmd_async(op, dev_bus, SPS_CMD_READ_DEVICE_STATUS_REG,
+                                                SPS_CMD_DELAY_USEC, 2);
+}
+
+int16_t sps30_read_device_status_register_finish(const struct sensirion_i2c_async *op,
+                                                 uint32_t *device_status_flags)
+{
+    int16_t ret;
+    uint16_t word_buf[2];
+
+    ret = sensirion_i2c_async_get_words(op, word_buf, SENSIRION_NUM_WORDS(word_buf));
+    if (ret)
+        return ret;
+
+    *device_status_flags = (((uint32_t)word_buf[0]) << 16) | word_buf[1];
+    return 0;
+}
+#endif /* CONFIG_SENSIRION_I2C_ASYNC */
+
+static void sps30_store_values(const struct device *dev, const uint8_t raw[SPS30_NUM_VALUES][4])
+{
+    struct sps30_data *data = dev->data;
+
+    /* Straight from the float words to sensor_value, no FPU needed */
+    for (int i = 0; i < SPS30_NUM_VALUES; i++)
     {
-        sensor_value_from_float(val, data->nc_2p5);
-        return 0;
+        sensirion_bytes_to_fixed(raw[i], &data->values[i].val1, &data->values[i].val2);
     }
-    if (chan == SENSOR_CHAN_PM_4_0_NC)
+}
+
+static int sps30_sample_fetch(const struct device *dev, enum sensor_channel chan)
+{
+    const struct sps30_config *cfg = dev->config;
+    uint8_t raw[SPS30_NUM_VALUES][4];
+
+    int16_t ret = sensirion_i2c_read_cmd_as_bytes(&cfg->bus, SPS_CMD_READ_MEASUREMENT,
+                                                  &raw[0][0], SENSIRION_NUM_WORDS(raw));
+
+    if (ret < 0)
     {
-        sensor_value_from_float(val, data->nc_4p0);
-        return 0;
+        return ret;
     }
-    if (chan == SENSOR_CHAN_PM_10_NC)
+
+    sps30_store_values(dev, raw);
+    return 0;
+}
+
+#ifdef CONFIG_SENSIRION_I2C_ASYNC
+int sps30_sample_fetch_async(const struct device *dev, struct sensirion_i2c_async *op)
+{
+    const struct sps30_config *cfg = dev->config;
+
+    return sps30_read_measurement_async(&cfg->bus, op);
+}
+
+int sps30_sample_fetch_finish(const struct device *dev, const struct sensirion_i2c_async *op)
+{
+    uint8_t raw[SPS30_NUM_VALUES][4];
+    int16_t ret;
+
+    ret = sensirion_i2c_async_get_words_as_bytes(op, &raw[0][0], SENSIRION_NUM_WORDS(raw));
+    if (ret < 0)
     {
-        sensor_value_from_float(val, data->nc_10p0);
-        return 0;
+        return ret;
     }
-    if (chan == SENSOR_CHAN_PM_TYPICAL_PARTICLE_SIZE)
+
+    sps30_store_values(dev, raw);
+    return 0;
+}
+#endif /* CONFIG_SENSIRION_I2C_ASYNC */
+
+static int sps30_channel_get(const struct device *dev, enum sensor_channel chan, struct sensor_value *val)
+{
+    const struct sps30_data *data = dev->data;
+    enum sps30_value idx;
+
+    switch ((int)chan)
     {
-        sensor_value_from_float(val, data->typical_particle_size);
-        return 0;
+    case SENSOR_CHAN_PM_1_0:
+        idx = SPS30_MC_1P0;
+        break;
+    case SENSOR_CHAN_PM_2_5:
+        idx = SPS30_MC_2P5;
+        break;
+    case SENSOR_CHAN_PM_4_0:
+        idx = SPS30_MC_4P0;
+        break;
+    case SENSOR_CHAN_PM_10:
+        idx = SPS30_MC_10P0;
+        break;
+    case SENSOR_CHAN_PM_0_5:
+        idx = SPS30_NC_0P5;
+        break;
+    case SENSOR_CHAN_PM_1_0_NC:
+        idx = SPS30_NC_1P0;
+        break;
+    case SENSOR_CHAN_PM_2_5_NC:
+        idx = SPS30_NC_2P5;
+        break;
+    case SENSOR_CHAN_PM_4_0_NC:
+        idx = SPS30_NC_4P0;
+        break;
+    case SENSOR_CHAN_PM_10_NC:
+        idx = SPS30_NC_10P0;
+        break;
+    case SENSOR_CHAN_PM_TYPICAL_PARTICLE_SIZE:
+        idx = SPS30_TYPICAL_PARTICLE_SIZE;
+        break;
+    default:
+        return -EINVAL;
     }
 
-
-    
-    return -EINVAL;
+    *val = data->values[idx];
+    return 0;
 }
 
 #if defined(CONFIG_PM_DEVICE)
@@ -375,6 +418,11 @@ static int sps30_init(const struct device *dev)
 {
     const struct sps30_config *cfg = dev->config;
 
+    if (!i2c_is_ready_dt(&cfg->bus))
+    {
+        return -ENODEV;
+    }
+
     k_sleep(K_MSEC(10));
     int result = sps30_stop_measurement(&cfg->bus);
     result = sps30_start_measurement(&cfg->bus);
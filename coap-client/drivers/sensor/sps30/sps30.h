@@ -41,6 +41,7 @@ extern "C" {
 #include "sensirion_arch_config.h"
 #include "sensirion_common.h"
 #include "sensirion_i2c.h"
+#include <sensirion/sps30.h>
 #include <zephyr/pm/device.h>
 #include <zephyr/drivers/sensor.h>
 #include <zephyr/drivers/i2c.h> // Include the header defining struct i2c_dt_spec
@@ -59,6 +60,23 @@ extern "C" {
 /** The fan speed is out of range */
 #define SPS30_DEVICE_STATUS_FAN_SPEED_WARNING (1 << 21)
 
+#define SPS_CMD_START_MEASUREMENT 0x0010
+#define SPS_CMD_START_MEASUREMENT_ARG 0x0300
+#define SPS_CMD_STOP_MEASUREMENT 0x0104
+#define SPS_CMD_READ_MEASUREMENT 0x0300
+#define SPS_CMD_START_STOP_DELAY_USEC 20000
+#define SPS_CMD_GET_DATA_READY 0x0202
+#define SPS_CMD_AUTOCLEAN_INTERVAL 0x8004
+#define SPS_CMD_GET_FIRMWARE_VERSION 0xd100
+#define SPS_CMD_GET_SERIAL 0xd033
+#define SPS_CMD_RESET 0xd304
+#define SPS_CMD_SLEEP 0x1001
+#define SPS_CMD_READ_DEVICE_STATUS_REG 0xd206
+#define SPS_CMD_START_MANUAL_FAN_CLEANING 0x5607
+#define SPS_CMD_WAKE_UP 0x1103
+#define SPS_CMD_DELAY_USEC 5000
+#define SPS_CMD_DELAY_WRITE_FLASH_USEC 20000
+
 struct sps30_measurement {
     float mc_1p0;
     float mc_2p5;
@@ -275,6 +293,73 @@ int16_t sps30_wake_up(const struct i2c_dt_spec *dev_bus);
  */
 int16_t sps30_read_device_status_register(const struct i2c_dt_spec *dev_bus, uint32_t* device_status_flags);
 
+#ifdef CONFIG_SENSIRION_I2C_ASYNC
+/**
+ * sps30_read_measurement_async() - start reading a measurement without
+ * blocking
+ *
+ * Completion is reported through the signal and/or callback @op was
+ * initialized with (see sensirion_i2c_async_init()), after which the result is
+ * collected with sps30_read_measurement_finish().
+ *
+ * @op:     Idle asynchronous command context
+ * Return:  0 if the read was started, an error code otherwise
+ */
+int16_t sps30_read_measurement_async(const struct i2c_dt_spec *dev_bus,
+                                     struct sensirion_i2c_async *op);
+
+/**
+ * sps30_read_measurement_finish() - collect a measurement started with
+ * sps30_read_measurement_async()
+ *
+ * Return:  0 on success, the transfer or CRC error otherwise
+ */
+int16_t sps30_read_measurement_finish(const struct sensirion_i2c_async *op,
+                                      struct sps30_measurement *measurement);
+
+/**
+ * sps30_read_data_ready_async() - start reading the data-ready flag without
+ * blocking
+ *
+ * Return:  0 if the read was started, an error code otherwise
+ */
+int16_t sps30_read_data_ready_async(const struct i2c_dt_spec *dev_bus,
+                                    struct sensirion_i2c_async *op);
+
+/**
+ * sps30_read_data_ready_finish() - collect the data-ready flag started with
+ * sps30_read_data_ready_async()
+ *
+ * @data_ready: Memory where the data-ready flag (0|1) is stored.
+ * Return:      0 on success, the transfer or CRC error otherwise
+ */
+int16_t sps30_read_data_ready_finish(const struct sensirion_i2c_async *op,
+                                     uint16_t *data_ready);
+
+/**
+ * sps30_read_device_status_register_async() - start reading the Device Status
+ * Register without blocking
+ *
+ * The command processing delay is waited out on the work queue instead of the
+ * calling thread.
+ *
+ * Return:  0 if the read was started, an error code otherwise
+ */
+int16_t sps30_read_device_status_register_async(const struct i2c_dt_spec *dev_bus,
+                                                struct sensirion_i2c_async *op);
+
+/**
+ * sps30_read_device_status_register_finish() - collect the Device Status
+ * Register started with sps30_read_device_status_register_async()
+ *
+ * @device_status_flags:    Memory where the device status flags are written
+ *                          into
+ * Return:  0 on success, the transfer or CRC error otherwise
+ */
+int16_t sps30_read_device_status_register_finish(const struct sensirion_i2c_async *op,
+                                                 uint32_t *device_status_flags);
+#endif /* CONFIG_SENSIRION_I2C_ASYNC */
+
 enum sps30_model
 {
     SPS30_MODEL_SPS30,
@@ -286,26 +371,26 @@ struct sps30_config
     enum sps30_model model;
 };
 
+/* Values in the order of the read measurement response */
+enum sps30_value
+{
+    SPS30_MC_1P0,
+    SPS30_MC_2P5,
+    SPS30_MC_4P0,
+    SPS30_MC_10P0,
+    SPS30_NC_0P5,
+    SPS30_NC_1P0,
+    SPS30_NC_2P5,
+    SPS30_NC_4P0,
+    SPS30_NC_10P0,
+    SPS30_TYPICAL_PARTICLE_SIZE,
+    SPS30_NUM_VALUES,
+};
+
 struct sps30_data
 {
-    float mc_1p0;
-    float mc_2p5;
-    float mc_4p0;
-    float mc_10p0;
-    float nc_0p5;
-    float nc_1p0;
-    float nc_2p5;
-    float nc_4p0;
-    float nc_10p0;
-    float typical_particle_size;
+    struct sensor_value values[SPS30_NUM_VALUES];
 };
-#define SENSOR_CHAN_PM_4_0 (0x1000)
-#define SENSOR_CHAN_PM_0_5 (0x1001)
-#define SENSOR_CHAN_PM_1_0_NC (0x1002)
-#define SENSOR_CHAN_PM_2_5_NC (0x1003)
-#define SENSOR_CHAN_PM_4_0_NC (0x1004)
-#define SENSOR_CHAN_PM_10_NC (0x1005)
-#define SENSOR_CHAN_PM_TYPICAL_PARTICLE_SIZE (0x1006)
 
 
 #ifdef __cplusplus
@@ -0,0 +1,423 @@
+/*
+ * Emulator of the Sensirion SPS30 on an emulated I2C bus.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define DT_DRV_COMPAT sensirion_sps30
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <sensirion/emul.h>
+
+#include "sps30.h"
+
+#define SPS30_EMUL_MAX_WORDS 20
+#define SPS30_EMUL_WORD_LEN (SENSIRION_WORD_SIZE + CRC8_LEN)
+#define SPS30_EMUL_FIRMWARE_VERSION 0x0203
+#define SPS30_EMUL_DEFAULT_AUTOCLEAN_S (168 * 3600)
+#define SPS30_EMUL_FORMAT_FLOAT 0x03
+#define SPS30_EMUL_FORMAT_UINT16 0x05
+
+enum sps30_emul_state
+{
+    SPS30_EMUL_IDLE,
+    SPS30_EMUL_MEASURING,
+    SPS30_EMUL_SLEEP,
+    /* Woken by the first transfer, waiting for the wake-up command */
+    SPS30_EMUL_WAKING,
+};
+
+struct sps30_emul_data
+{
+    enum sps30_emul_state state;
+    /* Commands and reads before this uptime are not acknowledged */
+    int64_t busy_until;
+    int64_t next_sample;
+    bool data_ready;
+    uint8_t format;
+
+    /* Command the next read answers, 0 if there is nothing to read */
+    uint16_t cmd;
+
+    /* Mass concentrations in ug/m3, number concentrations in #/cm3, size in um */
+    float values[10];
+
+    uint32_t autoclean_s;
+    uint32_t status;
+
+    struct sensirion_emul_signal pm2_5_signal;
+
+    enum sensirion_emul_fault fault;
+    uint32_t fault_count;
+};
+
+struct sps30_emul_cfg
+{
+    /* Devicetree ordinal of the I2C controller */
+    uint32_t bus_ord;
+};
+
+/* Ratios to PM2.5 of a typical indoor size distribution, in sps30_measurement order */
+static const float sps30_emul_ratios[10] = {
+    0.78f, 1.0f, 1.12f, 1.18f, 3.9f, 4.6f, 4.7f, 4.72f, 4.73f, 0.0f,
+};
+
+#define SPS30_EMUL_TYPICAL_PARTICLE_SIZE 0.55f
+
+static void sps30_emul_sample(struct sps30_emul_data *data, int64_t t_ms)
+{
+    float pm2_5 = MAX(sensirion_emul_signal_at(&data->pm2_5_signal, t_ms), 0) / 1000.0f;
+
+    for (int i = 0; i < ARRAY_SIZE(data->values); i++)
+    {
+        data->values[i] = sps30_emul_ratios[i] * pm2_5;
+    }
+    data->values[9] = SPS30_EMUL_TYPICAL_PARTICLE_SIZE;
+    data->data_ready = true;
+}
+
+/* Catch up with the measurements that completed since the last transfer */
+static void sps30_emul_update(struct sps30_emul_data *data, int64_t now)
+{
+    if (data->state != SPS30_EMUL_MEASURING)
+    {
+        return;
+    }
+
+    while (now >= data->next_sample)
+    {
+        sps30_emul_sample(data, data->next_sample);
+        data->next_sample += SPS30_MEASUREMENT_DURATION_USEC / USEC_PER_MSEC;
+    }
+}
+
+static bool sps30_emul_allowed(const struct sps30_emul_data *data, uint16_t cmd)
+{
+    switch (cmd)
+    {
+    case SPS_CMD_READ_MEASUREMENT:
+    case SPS_CMD_START_MANUAL_FAN_CLEANING:
+    case SPS_CMD_STOP_MEASUREMENT:
+        return data->state == SPS30_EMUL_MEASURING;
+    case SPS_CMD_START_MEASUREMENT:
+    case SPS_CMD_SLEEP:
+        return data->state == SPS30_EMUL_IDLE;
+    case SPS_CMD_WAKE_UP:
+        return true;
+    default:
+        return data->state == SPS30_EMUL_IDLE || data->state == SPS30_EMUL_MEASURING;
+    }
+}
+
+static int sps30_emul_write(struct sps30_emul_data *data, const uint8_t *buf, uint32_t len,
+                            int64_t now)
+{
+    uint16_t args[2] = {0};
+    uint16_t num_args = (len - SENSIRION_COMMAND_SIZE) / SPS30_EMUL_WORD_LEN;
+    uint16_t cmd;
+
+    if (len < SENSIRION_COMMAND_SIZE ||
+        (len - SENSIRION_COMMAND_SIZE) % SPS30_EMUL_WORD_LEN != 0 ||
+        num_args > ARRAY_SIZE(args))
+    {
+        return -EIO;
+    }
+
+    for (uint16_t i = 0; i < num_args; i++)
+    {
+        const uint8_t *word = &buf[SENSIRION_COMMAND_SIZE + i * SPS30_EMUL_WORD_LEN];
+
+        if (sensirion_common_generate_crc(word, SENSIRION_WORD_SIZE) != word[SENSIRION_WORD_SIZE])
+        {
+            return -EIO;
+        }
+        args[i] = sys_get_be16(word);
+    }
+
+    cmd = sys_get_be16(buf);
+    if (data->state == SPS30_EMUL_WAKING && cmd != SPS_CMD_WAKE_UP)
+    {
+        data->state = SPS30_EMUL_SLEEP;
+    }
+    if (!sps30_emul_allowed(data, cmd))
+    {
+        return -EIO;
+    }
+
+    data->cmd = 0;
+
+    switch (cmd)
+    {
+    case SPS_CMD_START_MEASUREMENT:
+        data->format = args[0] >> 8;
+        if (data->format != SPS30_EMUL_FORMAT_FLOAT && data->format != SPS30_EMUL_FORMAT_UINT16)
+        {
+            return -EIO;
+        }
+        data->state = SPS30_EMUL_MEASURING;
+        data->next_sample = now + SPS30_MEASUREMENT_DURATION_USEC / USEC_PER_MSEC;
+        data->busy_until = now + SPS_CMD_START_STOP_DELAY_USEC / USEC_PER_MSEC;
+        break;
+    case SPS_CMD_STOP_MEASUREMENT:
+        data->state = SPS30_EMUL_IDLE;
+        data->busy_until = now + SPS_CMD_START_STOP_DELAY_USEC / USEC_PER_MSEC;
+        break;
+    case SPS_CMD_AUTOCLEAN_INTERVAL:
+        if (num_args == 2)
+        {
+            data->autoclean_s = ((uint32_t)args[0] << 16) | args[1];
+            data->busy_until = now + SPS_CMD_DELAY_WRITE_FLASH_USEC / USEC_PER_MSEC;
+        }
+        else
+        {
+            data->cmd = cmd;
+        }
+        break;
+    case SPS_CMD_RESET:
+        memset(data->values, 0, sizeof(data->values));
+        data->state = SPS30_EMUL_IDLE;
+        data->data_ready = false;
+        data->busy_until = now + SPS30_RESET_DELAY_USEC / USEC_PER_MSEC;
+        break;
+    case SPS_CMD_SLEEP:
+        data->state = SPS30_EMUL_SLEEP;
+        data->busy_until = now + SPS_CMD_DELAY_USEC / USEC_PER_MSEC;
+        break;
+    case SPS_CMD_WAKE_UP:
+        if (data->state == SPS30_EMUL_WAKING)
+        {
+            data->state = SPS30_EMUL_IDLE;
+            data->busy_until = now + SPS_CMD_DELAY_USEC / USEC_PER_MSEC;
+        }
+        break;
+    case SPS_CMD_START_MANUAL_FAN_CLEANING:
+        data->busy_until = now + SPS_CMD_DELAY_USEC / USEC_PER_MSEC;
+        break;
+    case SPS_CMD_READ_DEVICE_STATUS_REG:
+        data->cmd = cmd;
+        data->busy_until = now + SPS_CMD_DELAY_USEC / USEC_PER_MSEC;
+        break;
+    case SPS_CMD_READ_MEASUREMENT:
+    case SPS_CMD_GET_DATA_READY:
+    case SPS_CMD_GET_FIRMWARE_VERSION:
+    case SPS_CMD_GET_SERIAL:
+        data->cmd = cmd;
+        break;
+    default:
+        return -EIO;
+    }
+
+    return 0;
+}
+
+static int sps30_emul_read(const struct emul *target, uint8_t *buf, uint32_t len, bool corrupt)
+{
+    struct sps30_emul_data *data = target->data;
+    uint16_t words[SPS30_EMUL_MAX_WORDS] = {0};
+    uint32_t num_words = 1;
+    char serial[SPS30_MAX_SERIAL_LEN] = {0};
+
+    switch (data->cmd)
+    {
+    case SPS_CMD_READ_MEASUREMENT:
+        /* Without a new measurement the previous values are returned again */
+        for (int i = 0; i < ARRAY_SIZE(data->values); i++)
+        {
+            if (data->format == SPS30_EMUL_FORMAT_FLOAT)
+            {
+                uint32_t bits;
+
+                memcpy(&bits, &data->values[i], sizeof(bits));
+                words[2 * i] = bits >> 16;
+                words[2 * i + 1] = bits & 0xFFFF;
+            }
+            else
+            {
+                words[i] = CLAMP(data->values[i] * (i == 9 ? 1000 : 1), 0, UINT16_MAX);
+            }
+        }
+        num_words = data->format == SPS30_EMUL_FORMAT_FLOAT ? 20 : 10;
+        data->data_ready = false;
+        break;
+    case SPS_CMD_GET_DATA_READY:
+        words[0] = data->data_ready;
+        break;
+    case SPS_CMD_AUTOCLEAN_INTERVAL:
+        words[0] = data->autoclean_s >> 16;
+        words[1] = data->autoclean_s & 0xFFFF;
+        num_words = 2;
+        break;
+    case SPS_CMD_GET_FIRMWARE_VERSION:
+        words[0] = SPS30_EMUL_FIRMWARE_VERSION;
+        break;
+    case SPS_CMD_GET_SERIAL:
+        snprintf(serial, sizeof(serial), "EMUL%04X", target->bus.i2c->addr);
+        for (int i = 0; i < SPS30_MAX_SERIAL_LEN / 2; i++)
+        {
+            words[i] = sys_get_be16((const uint8_t *)&serial[2 * i]);
+        }
+        num_words = SPS30_MAX_SERIAL_LEN / 2;
+        break;
+    case SPS_CMD_READ_DEVICE_STATUS_REG:
+        words[0] = data->status >> 16;
+        words[1] = data->status & 0xFFFF;
+        num_words = 2;
+        break;
+    default:
+        return -EIO;
+    }
+
+    if (len > num_words * SPS30_EMUL_WORD_LEN)
+    {
+        return -EIO;
+    }
+
+    for (uint32_t i = 0; i < len; i += SPS30_EMUL_WORD_LEN)
+    {
+        uint8_t word[SPS30_EMUL_WORD_LEN];
+
+        sys_put_be16(words[i / SPS30_EMUL_WORD_LEN], word);
+        word[SENSIRION_WORD_SIZE] = sensirion_common_generate_crc(word, SENSIRION_WORD_SIZE);
+        memcpy(&buf[i], word, MIN(len - i, sizeof(word)));
+    }
+
+    if (corrupt && len >= SPS30_EMUL_WORD_LEN)
+    {
+        buf[SENSIRION_WORD_SIZE] ^= 0xFF;
+    }
+
+    return 0;
+}
+
+/* Returns true if the fault applies to this transfer, counting it down */
+static bool sps30_emul_take_fault(struct sps30_emul_data *data, enum sensirion_emul_fault fault)
+{
+    if (data->fault != fault)
+    {
+        return false;
+    }
+
+    if (data->fault_count > 0 && --data->fault_count == 0)
+    {
+        data->fault = SENSIRION_EMUL_FAULT_NONE;
+    }
+
+    return true;
+}
+
+static int sps30_emul_transfer(const struct emul *target, struct i2c_msg *msgs, int num_msgs,
+                               int addr)
+{
+    struct sps30_emul_data *data = target->data;
+    int64_t now = k_uptime_get();
+    int ret;
+
+    ARG_UNUSED(addr);
+
+    if (data->fault == SENSIRION_EMUL_FAULT_STUCK_BUS ||
+        sps30_emul_take_fault(data, SENSIRION_EMUL_FAULT_NACK))
+    {
+        return -EIO;
+    }
+
+    if (data->state == SPS30_EMUL_SLEEP)
+    {
+        /* The interface wakes up on the first transfer, which is not acknowledged */
+        data->state = SPS30_EMUL_WAKING;
+        return -EIO;
+    }
+
+    sps30_emul_update(data, now);
+
+    if (now < data->busy_until)
+    {
+        return -EIO;
+    }
+
+    for (int i = 0; i < num_msgs; i++)
+    {
+        if (msgs[i].flags & I2C_MSG_READ)
+        {
+            ret = sps30_emul_read(target, msgs[i].buf, msgs[i].len,
+                                  sps30_emul_take_fault(data, SENSIRION_EMUL_FAULT_CRC));
+        }
+        else
+        {
+            ret = sps30_emul_write(data, msgs[i].buf, msgs[i].len, now);
+        }
+
+        if (ret < 0)
+        {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+void sps30_emul_set_fault(const struct emul *target, enum sensirion_emul_fault fault,
+                          uint32_t count)
+{
+    struct sps30_emul_data *data = target->data;
+
+    data->fault = fault;
+    data->fault_count = count;
+}
+
+void sps30_emul_set_signal(const struct emul *target, const struct sensirion_emul_signal *sig)
+{
+    struct sps30_emul_data *data = target->data;
+
+    data->pm2_5_signal = *sig;
+}
+
+void sps30_emul_set_status(const struct emul *target, uint32_t flags)
+{
+    struct sps30_emul_data *data = target->data;
+
+    data->status = flags;
+}
+
+static const struct i2c_emul_api sps30_emul_api_i2c = {
+    .transfer = sps30_emul_transfer,
+};
+
+static int sps30_emul_init(const struct emul *target, const struct device *parent)
+{
+    struct sps30_emul_data *data = target->data;
+    const struct sps30_emul_cfg *cfg = target->cfg;
+
+    ARG_UNUSED(parent);
+
+    data->state = SPS30_EMUL_IDLE;
+    data->format = SPS30_EMUL_FORMAT_FLOAT;
+    data->autoclean_s = SPS30_EMUL_DEFAULT_AUTOCLEAN_S;
+
+    /* Indoor background with slow swings, e.g. from cooking or ventilation */
+    data->pm2_5_signal = (struct sensirion_emul_signal){
+        .base = 8000,
+        .amplitude = 4000,
+        .period_ms = 300000,
+        .noise = 500,
+        .seed = sensirion_emul_seed(target->bus.i2c->addr, cfg->bus_ord, 0),
+    };
+
+    return 0;
+}
+
+#define SPS30_EMUL(n)                                                           \
+    static struct sps30_emul_data sps30_emul_data_##n;                          \
+    static const struct sps30_emul_cfg sps30_emul_cfg_##n = {                   \
+        .bus_ord = DT_DEP_ORD(DT_INST_BUS(n)),                                  \
+    };                                                                          \
+    EMUL_DT_INST_DEFINE(n, sps30_emul_init, &sps30_emul_data_##n,               \
+                        &sps30_emul_cfg_##n, &sps30_emul_api_i2c, NULL)
+
+DT_INST_FOREACH_STATUS_OKAY(SPS30_EMUL)
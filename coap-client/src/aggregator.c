@@ -0,0 +1,399 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/openthread.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/printk.h>
+#include <openthread/coap.h>
+#include <openthread/link.h>
+#include <openthread/message.h>
+#include <openthread/server.h>
+
+#include "aggregator.h"
+#include "coap_block.h"
+#include "control.h"
+#include "frame_budget.h"
+#include "metrics.h"
+#include "ot_monitor.h"
+#include "sink.h"
+#include "sink_service.h"
+
+/* "<NODE " + 16 hex digits + ">" */
+#define AGG_TAG_LEN 23
+
+/* Header, token, Uri-Path "storedata", Content-Format, Block1 and payload marker */
+#define AGG_BLOCK_OVERHEAD 24
+
+METRICS_COUNTER_DEFINE(agg_accepted, "agg_accepted");
+METRICS_COUNTER_DEFINE(agg_rejected, "agg_rejected");
+METRICS_COUNTER_DEFINE(agg_uploads, "agg_uploads");
+METRICS_COUNTER_DEFINE(agg_upload_lost, "agg_upload_lost");
+METRICS_COUNTER_DEFINE(agg_upload_refused, "agg_upload_refused");
+METRICS_COUNTER_DEFINE(agg_upload_blocks, "agg_upload_blocks");
+METRICS_HISTOGRAM_DEFINE(agg_batch, "agg_batch", 1, 2, 4, 8, 16);
+
+/*
+ * Tagged payloads waiting for upload. Touched by the /storedata handler and
+ * the flush work, both under the OpenThread API mutex.
+ */
+static char agg_buf[CONFIG_AQM_AGGREGATOR_MAX_PAYLOAD];
+static size_t agg_len;
+static uint8_t agg_count;
+
+#ifdef CONFIG_AQM_BLOCKWISE
+/*
+ * Batch being uploaded in Block1 blocks of one frame each, one block per
+ * round trip. The next batch collects in agg_buf meanwhile. Same locking as
+ * agg_buf.
+ */
+static char agg_upload_buf[CONFIG_AQM_AGGREGATOR_MAX_PAYLOAD];
+static size_t agg_upload_len;
+static uint8_t agg_upload_count;
+static otMessageInfo agg_upload_info;
+static struct coap_block agg_upload_block;
+
+static void agg_flush(otInstance *inst);
+#endif
+
+/* Only set while a block-wise upload is in progress */
+static bool agg_upload_busy;
+
+static void agg_upload_handler(void *context, otMessage *msg, const otMessageInfo *msg_info,
+                               otError result);
+
+/* block is NULL for a batch sent whole */
+static otError agg_send(otInstance *inst, const otMessageInfo *msg_info, const char *data,
+                        size_t len, const struct coap_block *block, uint8_t count)
+{
+    otMessage *msg;
+    otError error;
+
+    msg = otCoapNewMessage(inst, NULL);
+    if (!msg)
+    {
+        ot_monitor_alloc_failed();
+        return OT_ERROR_NO_BUFS;
+    }
+
+    otCoapMessageInit(msg, OT_COAP_TYPE_CONFIRMABLE, OT_COAP_CODE_PUT);
+    error = otCoapMessageAppendUriPathOptions(msg, "storedata");
+    if (error == OT_ERROR_NONE)
+    {
+        error = otCoapMessageAppendContentFormatOption(msg, OT_COAP_OPTION_CONTENT_FORMAT_JSON);
+    }
+    if (error == OT_ERROR_NONE && block)
+    {
+        error = otCoapMessageAppendBlock1Option(msg, block->num, block->more, block->szx);
+    }
+    if (error == OT_ERROR_NONE)
+    {
+        error = otCoapMessageSetPayloadMarker(msg);
+    }
+    if (error == OT_ERROR_NONE)
+    {
+        error = otMessageAppend(msg, data, len);
+    }
+    if (error == OT_ERROR_NONE)
+    {
+        error = otCoapSendRequest(inst, msg, msg_info, agg_upload_handler,
+                                  (void *)(uintptr_t)count);
+    }
+
+    if (error != OT_ERROR_NONE)
+    {
+        otMessageFree(msg);
+    }
+
+    return error;
+}
+
+#ifdef CONFIG_AQM_BLOCKWISE
+/* Send block agg_upload_block.num of the batch being uploaded */
+static otError agg_upload_send_block(otInstance *inst)
+{
+    uint32_t size = COAP_BLOCK_SIZE(agg_upload_block.szx);
+    uint32_t offset = agg_upload_block.num * size;
+
+    agg_upload_block.more = agg_upload_len > offset + size;
+    metrics_counter_inc(&agg_upload_blocks);
+
+    /* A batch that fits one block goes without the option */
+    return agg_send(inst, &agg_upload_info, &agg_upload_buf[offset],
+                    MIN(size, agg_upload_len - offset),
+                    agg_upload_block.num == 0 && !agg_upload_block.more ? NULL : &agg_upload_block,
+                    agg_upload_count);
+}
+#endif
+
+static void agg_upload_handler(void *context, otMessage *msg, const otMessageInfo *msg_info,
+                               otError result)
+{
+    bool more = false;
+
+    ARG_UNUSED(msg_info);
+
+#ifdef CONFIG_AQM_BLOCKWISE
+    if (result == OT_ERROR_NONE && otCoapMessageGetCode(msg) == OT_COAP_CODE_CONTINUE)
+    {
+        agg_upload_block.num++;
+        more = agg_upload_send_block(openthread_get_default_instance()) == OT_ERROR_NONE;
+    }
+#endif
+
+    /* The senders were acknowledged already, a lost upload loses their records */
+    if (result != OT_ERROR_NONE)
+    {
+        metrics_counter_add(&agg_upload_lost, (uint32_t)(uintptr_t)context);
+    }
+    else if (otCoapMessageGetCode(msg) == OT_COAP_CODE_SERVICE_UNAVAILABLE)
+    {
+        metrics_counter_add(&agg_upload_lost, (uint32_t)(uintptr_t)context);
+        sink_report_unavailable(msg);
+    }
+    else if (!more && otCoapMessageGetCode(msg) != OT_COAP_CODE_CHANGED)
+    {
+        /* 4.08 or 4.13 from the sink, or the next block could not be sent */
+        metrics_counter_add(&agg_upload_lost, (uint32_t)(uintptr_t)context);
+    }
+    if (result == OT_ERROR_NONE)
+    {
+        if (!sink_response_ok(msg))
+        {
+            metrics_counter_inc(&agg_upload_refused);
+        }
+        control_apply(msg);
+    }
+    /* An error response from the sink counts against it like a timeout */
+    sink_report_result(result == OT_ERROR_NONE && sink_response_ok(msg));
+
+#ifdef CONFIG_AQM_BLOCKWISE
+    if (!more)
+    {
+        /* Records that came in during the upload leave right away */
+        agg_upload_busy = false;
+        agg_flush(openthread_get_default_instance());
+    }
+#else
+    ARG_UNUSED(more);
+#endif
+}
+
+static otError agg_upload(otInstance *inst)
+{
+    otMessageInfo msg_info;
+    otError error;
+
+    memset(&msg_info, 0, sizeof(msg_info));
+    if (!sink_get(inst, &msg_info.mPeerAddr, &msg_info.mPeerPort))
+    {
+        return OT_ERROR_INVALID_STATE;
+    }
+
+#ifdef CONFIG_AQM_BLOCKWISE
+    /* Blocks as large as one frame to the sink allows, all to the same sink */
+    agg_upload_info = msg_info;
+    memcpy(agg_upload_buf, agg_buf, agg_len);
+    agg_upload_len = agg_len;
+    agg_upload_count = agg_count;
+    agg_upload_block.num = 0;
+    agg_upload_block.szx = coap_block_szx_fit(
+        frame_budget_coap(inst, &msg_info.mPeerAddr, msg_info.mPeerPort), AGG_BLOCK_OVERHEAD);
+
+    error = agg_upload_send_block(inst);
+    agg_upload_busy = error == OT_ERROR_NONE;
+#else
+    error = agg_send(inst, &msg_info, agg_buf, agg_len, NULL, agg_count);
+#endif
+
+    return error;
+}
+
+/*
+ * Send the batch to the sink. A batch that cannot be sent is dropped rather
+ * than kept, the senders got their ACK and newer records follow. While a
+ * block-wise upload is in progress the batch waits for it to finish.
+ */
+static void agg_flush(otInstance *inst)
+{
+    otError error;
+
+    if (agg_len == 0 || agg_upload_busy)
+    {
+        return;
+    }
+
+    error = agg_upload(inst);
+    if (error == OT_ERROR_NONE)
+    {
+        metrics_counter_inc(&agg_uploads);
+        metrics_histogram_record(&agg_batch, agg_count);
+    }
+    else
+    {
+        metrics_counter_add(&agg_upload_lost, agg_count);
+        printk("Aggregate upload failed: %d\n", error);
+    }
+
+    agg_len = 0;
+    agg_count = 0;
+}
+
+static void agg_flush_work_handler(struct k_work *work)
+{
+    struct openthread_context *ctx = openthread_get_default_context();
+
+    ARG_UNUSED(work);
+
+    openthread_api_mutex_lock(ctx);
+    agg_flush(ctx->instance);
+    openthread_api_mutex_unlock(ctx);
+}
+
+static K_WORK_DELAYABLE_DEFINE(agg_flush_work, agg_flush_work_handler);
+
+/* max_age is only sent with a non-zero value, as the Max-Age option in seconds */
+static void agg_reply(otInstance *inst, const otMessage *req, const otMessageInfo *req_info,
+                      otCoapCode code, uint32_t max_age)
+{
+    otMessage *rsp;
+
+    if (otCoapMessageGetType(req) != OT_COAP_TYPE_CONFIRMABLE)
+    {
+        return;
+    }
+
+    rsp = otCoapNewMessage(inst, NULL);
+    if (!rsp)
+    {
+        ot_monitor_alloc_failed();
+        return;
+    }
+
+    if (otCoapMessageInitResponse(rsp, req, OT_COAP_TYPE_ACKNOWLEDGMENT, code) != OT_ERROR_NONE ||
+        (max_age > 0 && otCoapMessageAppendMaxAgeOption(rsp, max_age) != OT_ERROR_NONE) ||
+        control_append(rsp) != OT_ERROR_NONE ||
+        otCoapSendResponse(inst, rsp, req_info) != OT_ERROR_NONE)
+    {
+        otMessageFree(rsp);
+    }
+}
+
+static size_t agg_format_tag(char *buf, const otIp6Address *src)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t len = 0;
+
+    memcpy(buf, "<NODE ", 6);
+    len = 6;
+    for (size_t i = 8; i < 16; i++)
+    {
+        buf[len++] = hex[src->mFields.m8[i] >> 4];
+        buf[len++] = hex[src->mFields.m8[i] & 0xf];
+    }
+    buf[len++] = '>';
+
+    return len;
+}
+
+/* Runs in the OpenThread thread, which holds the API mutex */
+static void agg_storedata_cb(void *context, otMessage *msg, const otMessageInfo *msg_info)
+{
+    otInstance *inst = context;
+    uint16_t offset = otMessageGetOffset(msg);
+    uint16_t payload_len = otMessageGetLength(msg) - offset;
+    uint32_t backoff_s;
+
+    if (otCoapMessageGetCode(msg) != OT_COAP_CODE_PUT)
+    {
+        return;
+    }
+
+    if (AGG_TAG_LEN + payload_len > sizeof(agg_buf))
+    {
+        metrics_counter_inc(&agg_rejected);
+        agg_reply(inst, msg, msg_info, OT_COAP_CODE_REQUEST_TOO_LARGE, 0);
+        return;
+    }
+
+    /* Pass the sink's refusal on rather than collect records that cannot leave */
+    backoff_s = sink_backoff_remaining_s();
+    if (backoff_s > 0)
+    {
+        metrics_counter_inc(&agg_rejected);
+        agg_reply(inst, msg, msg_info, OT_COAP_CODE_SERVICE_UNAVAILABLE, backoff_s);
+        return;
+    }
+
+    if (agg_len + AGG_TAG_LEN + payload_len > sizeof(agg_buf))
+    {
+        agg_flush(inst);
+    }
+
+    /* Still full while the previous batch is uploaded, come back after a flush period */
+    if (agg_len + AGG_TAG_LEN + payload_len > sizeof(agg_buf))
+    {
+        metrics_counter_inc(&agg_rejected);
+        agg_reply(inst, msg, msg_info, OT_COAP_CODE_SERVICE_UNAVAILABLE,
+                  DIV_ROUND_UP(CONFIG_AQM_AGGREGATOR_FLUSH_MS, MSEC_PER_SEC));
+        return;
+    }
+
+    agg_len += agg_format_tag(&agg_buf[agg_len], &msg_info->mPeerAddr);
+    agg_len += otMessageRead(msg, offset, &agg_buf[agg_len], payload_len);
+    agg_count++;
+    metrics_counter_inc(&agg_accepted);
+
+    /* The batch leaves at the latest one flush period after its first record */
+    if (agg_count == 1)
+    {
+        k_work_schedule(&agg_flush_work, K_MSEC(CONFIG_AQM_AGGREGATOR_FLUSH_MS));
+    }
+
+    agg_reply(inst, msg, msg_info, OT_COAP_CODE_CHANGED, 0);
+}
+
+static void agg_service_register(otInstance *inst)
+{
+    otServiceConfig config = {0};
+    otExtAddress eui64;
+    otError err;
+
+    config.mEnterpriseNumber = CONFIG_AQM_SINK_ENTERPRISE_NUMBER;
+    config.mServiceDataLength = SINK_AGGREGATOR_SERVICE_DATA_LEN;
+    memcpy(config.mServiceData, SINK_AGGREGATOR_SERVICE_DATA, SINK_AGGREGATOR_SERVICE_DATA_LEN);
+    config.mServerConfig.mStable = true;
+    config.mServerConfig.mServerDataLength = SINK_SERVER_DATA_LEN;
+    sys_put_be16(OT_DEFAULT_COAP_PORT, &config.mServerConfig.mServerData[SINK_SERVER_DATA_PORT]);
+    otLinkGetFactoryAssignedIeeeEui64(inst, &eui64);
+    memcpy(&config.mServerConfig.mServerData[SINK_SERVER_DATA_EUI64], eui64.m8, 8);
+
+    err = otServerAddService(inst, &config);
+    if (err == OT_ERROR_NONE)
+    {
+        err = otServerRegister(inst);
+    }
+
+    if (err != OT_ERROR_NONE)
+    {
+        printk("Aggregator service registration failed: %d\n", err);
+    }
+}
+
+void aggregator_init(otInstance *inst)
+{
+    static otCoapResource res = {
+        .mUriPath = "storedata",
+        .mHandler = agg_storedata_cb,
+    };
+
+    metrics_counter_register(&agg_accepted);
+    metrics_counter_register(&agg_rejected);
+    metrics_counter_register(&agg_uploads);
+    metrics_counter_register(&agg_upload_lost);
+    metrics_counter_register(&agg_upload_refused);
+    metrics_counter_register(&agg_upload_blocks);
+    metrics_histogram_register(&agg_batch);
+
+    res.mContext = inst;
+    otCoapAddResource(inst, &res);
+    agg_service_register(inst);
+}
@@ -0,0 +1,20 @@
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+#include <openthread/instance.h>
+
+/**
+ * Take the aggregation role: serve /storedata locally and announce it as an
+ * aggregator service in the Network Data. Neighbouring clients within
+ * CONFIG_AQM_AGGREGATOR_MAX_COST then report here. Their PUTs are acknowledged
+ * at once and their records uploaded to this node's sink in batches of up to
+ * CONFIG_AQM_AGGREGATOR_MAX_PAYLOAD bytes, at the latest after
+ * CONFIG_AQM_AGGREGATOR_FLUSH_MS.
+ *
+ * Each forwarded payload is preceded by "<NODE xxxxxxxxxxxxxxxx>", the
+ * interface identifier of the sender's ML-EID, so the sink's log still tells
+ * the nodes apart. CoAP must be started.
+ */
+void aggregator_init(otInstance *inst);
+
+#endif /* AGGREGATOR_H */
@@ -0,0 +1,156 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/printk.h>
+
+#include "alert.h"
+#include "metrics.h"
+#include "sensor_acq.h"
+
+/* Watched fields, one per CO2 and PM2.5 channel of the board */
+#define ALERT_MAX_WATCHES 4
+
+struct alert_watch
+{
+    size_t field;
+    int32_t threshold;
+};
+
+METRICS_COUNTER_DEFINE(alert_events, "alert_events");
+METRICS_COUNTER_DEFINE(alert_sent, "alert_sent");
+METRICS_COUNTER_DEFINE(alert_acked, "alert_acked");
+
+static struct alert_watch watches[ALERT_MAX_WATCHES];
+static size_t num_watches;
+
+/*
+ * Bit n is watch n. alert_raised is the state of each watch, alert_pending
+ * the changes the sink has not acknowledged, alert_in_flight the ones sent
+ * and awaiting the response. Only one alert message is in flight at a time.
+ */
+static atomic_t alert_raised;
+static atomic_t alert_pending;
+static atomic_t alert_in_flight;
+
+static void alert_watch(const char *name, int32_t threshold)
+{
+    if (threshold <= 0)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < acq_field_count(); i++)
+    {
+        if (strcmp(acq_field_name(i), name) != 0)
+        {
+            continue;
+        }
+        if (num_watches == ARRAY_SIZE(watches))
+        {
+            printk("Too many alarm fields, %s not watched\n", name);
+            return;
+        }
+        watches[num_watches].field = i;
+        watches[num_watches].threshold = threshold;
+        num_watches++;
+    }
+}
+
+void alert_init(void)
+{
+    metrics_counter_register(&alert_events);
+    metrics_counter_register(&alert_sent);
+    metrics_counter_register(&alert_acked);
+
+    alert_watch("co2", CONFIG_AQM_ALERT_CO2_PPM);
+    alert_watch("pm2_5", CONFIG_AQM_ALERT_PM2_5);
+}
+
+uint32_t alert_check(void)
+{
+    struct acq_field_sample sample;
+
+    for (size_t i = 0; i < num_watches; i++)
+    {
+        const struct alert_watch *watch = &watches[i];
+        bool raised = atomic_get(&alert_raised) & BIT(i);
+
+        acq_get_field(watch->field, &sample);
+        if (sample.state != ACQ_FIELD_FRESH)
+        {
+            continue;
+        }
+
+        if (!raised && sample.value.val1 >= watch->threshold)
+        {
+            atomic_or(&alert_raised, BIT(i));
+        }
+        else if (raised && (int64_t)sample.value.val1 * 100 <
+                               (int64_t)watch->threshold * (100 - CONFIG_AQM_ALERT_HYSTERESIS_PCT))
+        {
+            atomic_and(&alert_raised, ~BIT(i));
+        }
+        else
+        {
+            continue;
+        }
+
+        atomic_or(&alert_pending, BIT(i));
+        metrics_counter_inc(&alert_events);
+        printk("Alarm %s %s: %d\n", acq_field_name(watch->field), raised ? "cleared" : "raised",
+               sample.value.val1);
+    }
+
+    if (atomic_get(&alert_in_flight))
+    {
+        return 0;
+    }
+
+    return atomic_get(&alert_pending);
+}
+
+int alert_encode(struct record_writer *writer, uint32_t mask)
+{
+    size_t len = 0;
+    int ret = 0;
+
+    for (size_t i = 0; i < num_watches && ret == 0; i++)
+    {
+        if (mask & BIT(i))
+        {
+            ret = record_encode_alert(writer, watches[i].field,
+                                      atomic_get(&alert_raised) & BIT(i));
+            len += writer->len;
+        }
+    }
+    writer->len = len;
+
+    return ret;
+}
+
+/* The context carries the mask and, above it, the states that were sent */
+void *alert_send_begin(uint32_t mask)
+{
+    uint32_t state = atomic_get(&alert_raised) & mask;
+
+    atomic_set(&alert_in_flight, mask);
+    metrics_counter_inc(&alert_sent);
+
+    return (void *)(uintptr_t)(mask | state << ALERT_MAX_WATCHES);
+}
+
+void alert_send_end(void *context, bool acked)
+{
+    uint32_t mask = (uintptr_t)context & BIT_MASK(ALERT_MAX_WATCHES);
+    uint32_t state = (uintptr_t)context >> ALERT_MAX_WATCHES;
+
+    if (acked)
+    {
+        /* A watch that flipped while the alert was under way stays pending */
+        mask &= ~((uint32_t)atomic_get(&alert_raised) ^ state);
+        atomic_and(&alert_pending, ~mask);
+        metrics_counter_inc(&alert_acked);
+    }
+
+    atomic_clear(&alert_in_flight);
+}
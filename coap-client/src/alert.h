@@ -0,0 +1,48 @@
+#ifndef ALERT_H
+#define ALERT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "record.h"
+
+/**
+ * Find the fields with a threshold: every "co2" field against
+ * CONFIG_AQM_ALERT_CO2_PPM and every "pm2_5" field against
+ * CONFIG_AQM_ALERT_PM2_5. Call once, after acq_init().
+ */
+void alert_init(void);
+
+/**
+ * Compare the fresh values of the last cycle with their thresholds. A field
+ * raises its alarm when it reaches the threshold and clears it when it falls
+ * CONFIG_AQM_ALERT_HYSTERESIS_PCT below. Either change stays pending until
+ * the sink acknowledges it.
+ *
+ * @return the alarms to send now as a bit mask, 0 while an alert is in
+ *         flight or nothing is pending
+ */
+uint32_t alert_check(void);
+
+/**
+ * Encode the pending alarms in mask, one record_encode_alert() each.
+ *
+ * @return 0, or the first error of the writer
+ */
+int alert_encode(struct record_writer *writer, uint32_t mask);
+
+/**
+ * Mark the alarms in mask as in flight.
+ *
+ * @return the context to pass to alert_send_end()
+ */
+void *alert_send_begin(uint32_t mask);
+
+/**
+ * End the alert send of alert_send_begin(). Acknowledged alarms are no longer
+ * pending unless they changed again in the meantime. Safe to call from the
+ * OpenThread thread.
+ */
+void alert_send_end(void *context, bool acked);
+
+#endif /* ALERT_H */
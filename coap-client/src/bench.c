@@ -0,0 +1,250 @@
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/sys_heap.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef CONFIG_ARCH_POSIX
+#include <posix_board_if.h>
+#endif
+
+#include "bench.h"
+#include "fmt.h"
+#include "sensor_acq.h"
+
+#define BENCH_FMT_ROUNDS 1000
+
+#ifdef CONFIG_BOARD_NATIVE_SIM
+/* src/bench_host.c */
+uint64_t bench_host_time_ns(void);
+
+#define BENCH_FMT_UNIT "ns"
+#define bench_fmt_now() ((uint32_t)bench_host_time_ns())
+#else
+#define BENCH_FMT_UNIT "cycles"
+#define bench_fmt_now() k_cycle_get_32()
+#endif
+
+/* Typical readings plus the sign and rounding corner cases */
+static const struct {
+    struct sensor_value value;
+    uint8_t precision;
+} bench_fmt_values[] = {
+    {{612, 0}, 0},        {{24, 312500}, 2},   {{45, 120000}, 2},    {{7, 990000}, 2},
+    {{9, 425000}, 2},     {{0, -500000}, 2},   {{-3, -250000}, 2},   {{1, 999999}, 2},
+    {{-1, -999999}, 2},   {{0, -4}, 2},        {{12, 345678}, 4},    {{-40, 0}, 2},
+    {{65535, 0}, 0},      {{100, 0}, 2},       {{0, 5000}, 2},       {{1000, 999999}, 6},
+};
+
+static const char *const stage_names[BENCH_NUM_STAGES] = {
+    [BENCH_STAGE_ACQ] = "acq",
+    [BENCH_STAGE_FETCH] = "fetch",
+    [BENCH_STAGE_CONVERT] = "convert",
+    [BENCH_STAGE_FORMAT] = "format",
+    [BENCH_STAGE_SEND] = "send",
+};
+
+struct bench_i2c_totals
+{
+    uint32_t tx;
+    uint32_t rx;
+    uint32_t msgs;
+};
+
+static atomic_t stage_cycles[BENCH_NUM_STAGES];
+static struct bench_i2c_totals i2c_last;
+static uint32_t iteration;
+
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS) && CONFIG_HEAP_MEM_POOL_SIZE > 0
+extern struct k_heap _system_heap;
+#endif
+
+/* Counters of all controllers with sensors, kept by the I2C core with CONFIG_I2C_STATS */
+static void bench_i2c_get(struct bench_i2c_totals *totals)
+{
+    *totals = (struct bench_i2c_totals){0};
+
+    for (size_t i = 0; i < acq_bus_count(); i++)
+    {
+        const struct device *bus = acq_bus(i);
+        struct i2c_device_state *state =
+            CONTAINER_OF(bus->state, struct i2c_device_state, devstate);
+
+        totals->tx += state->stats.bytes_written;
+        totals->rx += state->stats.bytes_read;
+        totals->msgs += state->stats.message_count;
+    }
+}
+
+/*
+ * The same output through snprintf(): the rounding is shared with
+ * fmt_sensor_value(), so the difference is the printf machinery alone.
+ */
+static size_t bench_fmt_snprintf(char *buf, size_t len, const struct sensor_value *value,
+                                 uint8_t precision)
+{
+    static const uint32_t scale[] = {1000000, 100000, 10000, 1000, 100, 10, 1};
+    bool negative = value->val1 < 0 || value->val2 < 0;
+    uint32_t int_part = value->val1 < 0 ? 0U - (uint32_t)value->val1 : (uint32_t)value->val1;
+    uint32_t micro = value->val2 < 0 ? 0U - (uint32_t)value->val2 : (uint32_t)value->val2;
+    uint32_t frac = (micro + scale[precision] / 2) / scale[precision];
+
+    if (frac >= 1000000 / scale[precision])
+    {
+        frac -= 1000000 / scale[precision];
+        int_part++;
+    }
+
+    negative = negative && (int_part || frac);
+    if (precision == 0)
+    {
+        return snprintf(buf, len, "%s%u", negative ? "-" : "", int_part);
+    }
+
+    return snprintf(buf, len, "%s%u.%0*u", negative ? "-" : "", int_part, precision, frac);
+}
+
+/* Compare fmt_sensor_value() with snprintf() on the same values, once before the cycles */
+static void bench_formatter(void)
+{
+    char expected[32];
+    char actual[FMT_SENSOR_VALUE_LEN + 1];
+    uint32_t mismatches = 0;
+    uint32_t start;
+    uint32_t t_snprintf;
+    uint32_t t_fmt;
+
+    for (size_t i = 0; i < ARRAY_SIZE(bench_fmt_values); i++)
+    {
+        size_t len = fmt_sensor_value(actual, &bench_fmt_values[i].value,
+                                      bench_fmt_values[i].precision);
+
+        actual[len] = '\0';
+        bench_fmt_snprintf(expected, sizeof(expected), &bench_fmt_values[i].value,
+                           bench_fmt_values[i].precision);
+        if (strcmp(expected, actual) != 0)
+        {
+            printk("BENCH_FMT_MISMATCH expected=%s actual=%s\n", expected, actual);
+            mismatches++;
+        }
+    }
+
+    start = bench_fmt_now();
+    for (int round = 0; round < BENCH_FMT_ROUNDS; round++)
+    {
+        for (size_t i = 0; i < ARRAY_SIZE(bench_fmt_values); i++)
+        {
+            bench_fmt_snprintf(expected, sizeof(expected), &bench_fmt_values[i].value,
+                               bench_fmt_values[i].precision);
+        }
+    }
+    t_snprintf = bench_fmt_now() - start;
+
+    start = bench_fmt_now();
+    for (int round = 0; round < BENCH_FMT_ROUNDS; round++)
+    {
+        for (size_t i = 0; i < ARRAY_SIZE(bench_fmt_values); i++)
+        {
+            fmt_sensor_value(actual, &bench_fmt_values[i].value, bench_fmt_values[i].precision);
+        }
+    }
+    t_fmt = bench_fmt_now() - start;
+
+    printk("BENCH_FMT unit=%s values=%u rounds=%u snprintf=%u fmt=%u mismatches=%u\n",
+           BENCH_FMT_UNIT, (unsigned int)ARRAY_SIZE(bench_fmt_values), BENCH_FMT_ROUNDS,
+           t_snprintf, t_fmt, mismatches);
+}
+
+void bench_init(void)
+{
+    printk("BENCH_BEGIN hz=%u iterations=%u buses=%u\n", sys_clock_hw_cycles_per_sec(),
+           CONFIG_AQM_BENCH_ITERATIONS, (unsigned int)acq_bus_count());
+    bench_formatter();
+    bench_i2c_get(&i2c_last);
+}
+
+void bench_stop(enum bench_stage stage, uint32_t start)
+{
+    atomic_add(&stage_cycles[stage], k_cycle_get_32() - start);
+}
+
+static void bench_print_stack(const char *name, const struct k_thread *thread)
+{
+    size_t unused;
+
+    if (k_thread_stack_space_get(thread, &unused) == 0)
+    {
+        printk(" %s=%u", name, (unsigned int)(thread->stack_info.size - unused));
+    }
+    else
+    {
+        printk(" %s=na", name);
+    }
+}
+
+/* The calling thread, every bus worker and, for the asynchronous reads, the system work queue */
+static void bench_print_memory(void)
+{
+    char name[sizeof("stack_acq255")];
+
+    bench_print_stack("stack", k_current_get());
+    for (size_t i = 0; i < acq_thread_count(); i++)
+    {
+        snprintf(name, sizeof(name), "stack_acq%u", (unsigned int)i);
+        bench_print_stack(name, acq_thread(i));
+    }
+#ifdef CONFIG_SENSIRION_I2C_ASYNC
+    bench_print_stack("stack_workq", &k_sys_work_q.thread);
+#endif
+
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS) && CONFIG_HEAP_MEM_POOL_SIZE > 0
+    struct sys_memory_stats heap;
+
+    sys_heap_runtime_stats_get(&_system_heap.heap, &heap);
+    printk(" heap=%u", (unsigned int)heap.max_allocated_bytes);
+#else
+    printk(" heap=na");
+#endif
+}
+
+void bench_end_iteration(size_t payload_len)
+{
+    struct bench_i2c_totals i2c;
+
+    if (iteration >= CONFIG_AQM_BENCH_ITERATIONS)
+    {
+        return;
+    }
+
+    bench_i2c_get(&i2c);
+
+    /* One line of key=value pairs per iteration, stage times in hardware cycles */
+    printk("BENCH iter=%u", iteration);
+    for (int i = 0; i < BENCH_NUM_STAGES; i++)
+    {
+        /* Without OpenThread nothing is sent, which is not a send that took no time */
+        if (i == BENCH_STAGE_SEND && !IS_ENABLED(CONFIG_OPENTHREAD_COAP))
+        {
+            printk(" %s=na", stage_names[i]);
+            continue;
+        }
+        printk(" %s=%u", stage_names[i], (unsigned int)atomic_clear(&stage_cycles[i]));
+    }
+    printk(" i2c_tx=%u i2c_rx=%u i2c_msgs=%u payload=%u", i2c.tx - i2c_last.tx,
+           i2c.rx - i2c_last.rx, i2c.msgs - i2c_last.msgs, (unsigned int)payload_len);
+    bench_print_memory();
+    printk("\n");
+
+    i2c_last = i2c;
+
+    if (++iteration == CONFIG_AQM_BENCH_ITERATIONS)
+    {
+        printk("BENCH_END\n");
+#if defined(CONFIG_ARCH_POSIX) && !defined(CONFIG_ZTEST)
+        posix_exit(0);
+#endif
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+enum bench_stage
+{
+    /* Whole acquisition cycle, wall time */
+    BENCH_STAGE_ACQ,
+    /* sensor_sample_fetch() calls, summed over all sensors and bus workers */
+    BENCH_STAGE_FETCH,
+    /* sensor_channel_get() calls, summed like the fetches */
+    BENCH_STAGE_CONVERT,
+    /* Record encoding into the CoAP message, into the console without CoAP */
+    BENCH_STAGE_FORMAT,
+    /* otCoapSendRequest() */
+    BENCH_STAGE_SEND,
+    BENCH_NUM_STAGES,
+};
+
+#ifdef CONFIG_AQM_BENCH
+
+/**
+ * Print the header line and take the starting I2C counters.
+ */
+void bench_init(void);
+
+static inline uint32_t bench_start(void)
+{
+    return k_cycle_get_32();
+}
+
+/**
+ * Add the cycles since start to a stage of the current iteration. Safe to
+ * call from the acquisition workers.
+ */
+void bench_stop(enum bench_stage stage, uint32_t start);
+
+/**
+ * Print the line of the current iteration and start the next one. payload_len
+ * is the CoAP payload encoded in the cycle, the console record without CoAP.
+ * After CONFIG_AQM_BENCH_ITERATIONS iterations a native_sim build exits
+ * unless it is a test, other boards stop reporting.
+ */
+void bench_end_iteration(size_t payload_len);
+
+#else
+
+static inline void bench_init(void)
+{
+}
+
+static inline uint32_t bench_start(void)
+{
+    return 0;
+}
+
+static inline void bench_stop(enum bench_stage stage, uint32_t start)
+{
+    ARG_UNUSED(stage);
+    ARG_UNUSED(start);
+}
+
+static inline void bench_end_iteration(size_t payload_len)
+{
+    ARG_UNUSED(payload_len);
+}
+
+#endif /* CONFIG_AQM_BENCH */
+
+#endif /* BENCH_H */
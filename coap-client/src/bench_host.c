@@ -0,0 +1,16 @@
+/*
+ * Host side of the native_sim benchmark, linked into the native simulator
+ * runner with the host C library. Simulated time stands still while code
+ * runs, so CPU-bound work is timed with the host's monotonic clock.
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+uint64_t bench_host_time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
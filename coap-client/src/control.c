@@ -0,0 +1,102 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/printk.h>
+#include <openthread/coap.h>
+
+#include "control.h"
+#include "control_option.h"
+#include "metrics.h"
+#include "sink.h"
+
+/* Upper end of the CONFIG_AQM_PACK_MAX_RECORDS range */
+#define CONTROL_BATCH_MAX 16
+
+METRICS_COUNTER_DEFINE(control_updates, "control_updates");
+
+/* Set from the OpenThread thread, read by the reporting thread */
+static atomic_t control_interval = ATOMIC_INIT(CONFIG_AQM_REPORT_INTERVAL_MS);
+static atomic_t control_records = ATOMIC_INIT(CONFIG_AQM_PACK_MAX_RECORDS);
+static atomic_t control_con = ATOMIC_INIT(CONFIG_AQM_TELEMETRY_CON_EVERY);
+
+/* Option value last received, only touched from the OpenThread thread */
+static uint8_t control[CONTROL_SINK_LEN];
+static uint8_t control_len;
+
+void control_init(void)
+{
+    metrics_counter_register(&control_updates);
+}
+
+void control_apply(const otMessage *rsp)
+{
+    otCoapOptionIterator iter;
+    const otCoapOption *option;
+    uint8_t value[CONTROL_SINK_LEN];
+    uint16_t interval_s;
+
+    if (otCoapOptionIteratorInit(&iter, rsp) != OT_ERROR_NONE)
+    {
+        return;
+    }
+
+    option = otCoapOptionIteratorGetFirstOptionMatching(&iter, CONTROL_OPTION);
+    if (!option || (option->mLength != CONTROL_LEN && option->mLength != CONTROL_SINK_LEN) ||
+        otCoapOptionIteratorGetOptionValue(&iter, value) != OT_ERROR_NONE)
+    {
+        return;
+    }
+
+    /* Every ACK repeats it, only a change is applied */
+    if (option->mLength == control_len && memcmp(value, control, control_len) == 0)
+    {
+        return;
+    }
+    memcpy(control, value, option->mLength);
+    control_len = option->mLength;
+
+    interval_s = sys_get_be16(&value[CONTROL_INTERVAL_S]);
+    atomic_set(&control_interval,
+               interval_s ? interval_s * MSEC_PER_SEC : CONFIG_AQM_REPORT_INTERVAL_MS);
+    atomic_set(&control_records, value[CONTROL_BATCH]
+                                     ? MIN(value[CONTROL_BATCH], CONTROL_BATCH_MAX)
+                                     : CONFIG_AQM_PACK_MAX_RECORDS);
+    atomic_set(&control_con, value[CONTROL_CON_EVERY] ? value[CONTROL_CON_EVERY]
+                                                      : CONFIG_AQM_TELEMETRY_CON_EVERY);
+
+    if (control_len == CONTROL_SINK_LEN)
+    {
+        sink_set_hint(&value[CONTROL_SINK]);
+    }
+
+    metrics_counter_inc(&control_updates);
+    printk("Reporting control: every %u ms, %u records per message, 1 in %u confirmable\n",
+           (uint32_t)atomic_get(&control_interval), (uint32_t)atomic_get(&control_records),
+           (uint32_t)atomic_get(&control_con));
+}
+
+uint32_t control_interval_ms(void)
+{
+    return atomic_get(&control_interval);
+}
+
+uint8_t control_batch(void)
+{
+    return atomic_get(&control_records);
+}
+
+uint8_t control_con_every(void)
+{
+    return atomic_get(&control_con);
+}
+
+otError control_append(otMessage *rsp)
+{
+    if (control_len == 0)
+    {
+        return OT_ERROR_NONE;
+    }
+
+    return otCoapMessageAppendOption(rsp, CONTROL_OPTION, control_len, control);
+}
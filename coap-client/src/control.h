@@ -0,0 +1,81 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <openthread/message.h>
+
+#ifdef CONFIG_AQM_CONTROL
+
+/**
+ * Register the control metrics. Call once.
+ */
+void control_init(void);
+
+/**
+ * Apply the reporting control attached to a /storedata response, see
+ * control_option.h. Responses without it change nothing. Call from the
+ * OpenThread thread.
+ */
+void control_apply(const otMessage *rsp);
+
+/**
+ * Reporting period: the sink's if it set one, else
+ * CONFIG_AQM_REPORT_INTERVAL_MS.
+ */
+uint32_t control_interval_ms(void);
+
+/**
+ * Records merged into one report message: the sink's if it set one, else
+ * CONFIG_AQM_PACK_MAX_RECORDS.
+ */
+uint8_t control_batch(void);
+
+/**
+ * One report message in this many is confirmable: the sink's if it set one,
+ * else CONFIG_AQM_TELEMETRY_CON_EVERY.
+ */
+uint8_t control_con_every(void);
+
+/**
+ * Pass the control last received on to a response of our own, so the
+ * clients of an aggregator follow the sink too. Call from the OpenThread
+ * thread, after the options with a lower number.
+ */
+otError control_append(otMessage *rsp);
+
+#else
+
+static inline void control_init(void)
+{
+}
+
+static inline void control_apply(const otMessage *rsp)
+{
+    ARG_UNUSED(rsp);
+}
+
+static inline uint32_t control_interval_ms(void)
+{
+    return CONFIG_AQM_REPORT_INTERVAL_MS;
+}
+
+static inline uint8_t control_batch(void)
+{
+    return CONFIG_AQM_PACK_MAX_RECORDS;
+}
+
+static inline uint8_t control_con_every(void)
+{
+    return CONFIG_AQM_TELEMETRY_CON_EVERY;
+}
+
+static inline otError control_append(otMessage *rsp)
+{
+    ARG_UNUSED(rsp);
+    return OT_ERROR_NONE;
+}
+
+#endif /* CONFIG_AQM_CONTROL */
+
+#endif /* CONTROL_H */
@@ -0,0 +1,98 @@
+#include <zephyr/kernel.h>
+
+#include "fmt.h"
+
+static const uint32_t fmt_pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+size_t fmt_u32(char *buf, uint32_t value)
+{
+    char digits[FMT_U32_LEN];
+    size_t n = 0;
+    size_t len;
+
+    /* Division by a constant, the compiler turns it into a multiply */
+    do
+    {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    for (len = 0; n > 0; len++)
+    {
+        buf[len] = digits[--n];
+    }
+
+    return len;
+}
+
+/* Magnitude of value rounded to precision decimals, as integer and fraction */
+static bool fmt_round(const struct sensor_value *value, uint8_t precision, uint32_t *int_part,
+                      uint32_t *frac)
+{
+    /* Negated in unsigned arithmetic, INT32_MIN has no positive int32_t */
+    uint32_t micro = value->val2 < 0 ? 0U - (uint32_t)value->val2 : (uint32_t)value->val2;
+
+    *int_part = value->val1 < 0 ? 0U - (uint32_t)value->val1 : (uint32_t)value->val1;
+    *frac = (micro + fmt_pow10[6 - precision] / 2) / fmt_pow10[6 - precision];
+    if (*frac >= fmt_pow10[precision])
+    {
+        /* Rounded up into the integer part, e.g. 1.999999 with 2 decimals */
+        *frac -= fmt_pow10[precision];
+        (*int_part)++;
+    }
+
+    return value->val1 < 0 || value->val2 < 0;
+}
+
+size_t fmt_sensor_value(char *buf, const struct sensor_value *value, uint8_t precision)
+{
+    uint32_t int_part;
+    uint32_t frac;
+    bool negative;
+    size_t len = 0;
+
+    precision = MIN(precision, 6);
+    negative = fmt_round(value, precision, &int_part, &frac);
+
+    if (negative && (int_part || frac))
+    {
+        buf[len++] = '-';
+    }
+    len += fmt_u32(&buf[len], int_part);
+
+    if (precision)
+    {
+        buf[len++] = '.';
+        for (uint8_t i = precision; i > 0; i--)
+        {
+            buf[len + i - 1] = '0' + frac % 10;
+            frac /= 10;
+        }
+        len += precision;
+    }
+
+    return len;
+}
+
+bool fmt_sensor_scaled(const struct sensor_value *value, uint8_t precision, int32_t *scaled)
+{
+    uint32_t int_part;
+    uint32_t frac;
+    bool negative;
+
+    precision = MIN(precision, 6);
+    negative = fmt_round(value, precision, &int_part, &frac);
+
+    if (int_part > (INT32_MAX - frac) / fmt_pow10[precision])
+    {
+        return false;
+    }
+
+    *scaled = (int32_t)(int_part * fmt_pow10[precision] + frac);
+    if (negative)
+    {
+        *scaled = -*scaled;
+    }
+
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef FMT_H
+#define FMT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/drivers/sensor.h>
+
+/* Longest fmt_sensor_value() output without the NUL: "-2147483648.999999" */
+#define FMT_SENSOR_VALUE_LEN 18
+
+/* Longest fmt_u32() output without the NUL */
+#define FMT_U32_LEN 10
+
+/**
+ * Format a sensor_value with a fixed number of decimals, rounded half away
+ * from zero. The sign is taken from val1 or val2, so values between -1 and 0
+ * (val1 == 0, val2 < 0) keep it. Neither printf nor 64-bit division is used.
+ *
+ * @param buf at least FMT_SENSOR_VALUE_LEN bytes, not NUL-terminated
+ * @param precision decimals, 0 to 6
+ *
+ * @return number of characters written
+ */
+size_t fmt_sensor_value(char *buf, const struct sensor_value *value, uint8_t precision);
+
+/**
+ * The value fmt_sensor_value() formats, times 10^precision: the digits
+ * without the decimal point.
+ *
+ * @return false if that does not fit an int32_t
+ */
+bool fmt_sensor_scaled(const struct sensor_value *value, uint8_t precision, int32_t *scaled);
+
+/**
+ * Format an unsigned decimal.
+ *
+ * @param buf at least FMT_U32_LEN bytes, not NUL-terminated
+ *
+ * @return number of characters written
+ */
+size_t fmt_u32(char *buf, uint32_t value);
+
+#endif /* FMT_H */
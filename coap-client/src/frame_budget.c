@@ -0,0 +1,132 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <openthread/thread.h>
+#ifdef CONFIG_OPENTHREAD_FTD
+#include <openthread/thread_ftd.h>
+#endif
+
+#include "frame_budget.h"
+
+/* aMaxPhyPacketSize */
+#define FB_PHY_MTU 127
+/* Frame control, sequence number, destination PAN ID (the source PAN ID is compressed) */
+#define FB_MAC_HEADER 5
+/* Short destination and source addresses, Thread uses them between attached nodes */
+#define FB_MAC_ADDRS 4
+/* Auxiliary security header with key ID mode 1: security control, frame counter, key index */
+#define FB_MAC_AUX_SECURITY 6
+/* MIC-32 and FCS */
+#define FB_MAC_FOOTER (4 + 2)
+/* Mesh header with 16-bit originator and final destination. The extra hops-left
+ * byte for more than 14 hops is counted too, so the budget holds either way. */
+#define FB_MESH_HEADER 6
+/* IPHC dispatch and encoding, traffic class, flow label and hop limit 64 elided */
+#define FB_IPHC_BASE 2
+/* UDP next header compression: NHC byte and checksum, Thread keeps the checksum */
+#define FB_UDP_NHC 3
+
+#define FB_RLOC16_INVALID 0xfffe
+
+static bool fb_iid_is_rloc(const otIp6Address *addr)
+{
+    static const uint8_t rloc_iid[] = {0x00, 0x00, 0x00, 0xff, 0xfe, 0x00};
+
+    return memcmp(&addr->mFields.m8[8], rloc_iid, sizeof(rloc_iid)) == 0;
+}
+
+/*
+ * Inline bytes of an address after IPHC. The mesh-local prefix is context 0
+ * and link-local is stateless, both are elided; other prefixes are counted in
+ * full. An interface identifier of the 0000:00ff:fe00:xxxx form takes two
+ * bytes or none if the link or mesh header already carries the 16-bit
+ * address; any other identifier, like the random one of the ML-EID, takes
+ * eight.
+ */
+static uint8_t fb_iphc_addr_len(otInstance *inst, const otIp6Address *addr, uint16_t rloc16)
+{
+    static const uint8_t link_local[] = {0xfe, 0x80, 0, 0, 0, 0, 0, 0};
+    bool mesh_local = memcmp(addr->mFields.m8, otThreadGetMeshLocalPrefix(inst), 8) == 0;
+
+    if (!mesh_local && memcmp(addr->mFields.m8, link_local, sizeof(link_local)) != 0)
+    {
+        return 16;
+    }
+
+    if (fb_iid_is_rloc(addr))
+    {
+        return sys_get_be16(&addr->mFields.m8[14]) == rloc16 ? 0 : 2;
+    }
+
+    return 8;
+}
+
+/* Ports in 0xf0b0..0xf0bf compress to 4 bits each, ports in 0xf000..0xf0ff to 8 bits */
+static uint8_t fb_udp_ports_len(uint16_t src, uint16_t dst)
+{
+    if ((src & 0xfff0) == 0xf0b0 && (dst & 0xfff0) == 0xf0b0)
+    {
+        return 1;
+    }
+    if ((src & 0xff00) == 0xf000 || (dst & 0xff00) == 0xf000)
+    {
+        return 3;
+    }
+    return 4;
+}
+
+/*
+ * RLOC16 of the node that owns dst, from the address itself or from the
+ * address resolution cache; FB_RLOC16_INVALID before the first resolution.
+ */
+static uint16_t fb_dst_rloc16(otInstance *inst, const otIp6Address *dst)
+{
+    if (fb_iid_is_rloc(dst))
+    {
+        return sys_get_be16(&dst->mFields.m8[14]);
+    }
+
+#ifdef CONFIG_OPENTHREAD_FTD
+    otCacheEntryIterator iter;
+    otCacheEntryInfo entry;
+
+    memset(&iter, 0, sizeof(iter));
+    while (otThreadGetNextCacheEntry(inst, &entry, &iter) == OT_ERROR_NONE)
+    {
+        if (entry.mState == OT_CACHE_ENTRY_STATE_CACHED &&
+            memcmp(&entry.mTarget, dst, sizeof(*dst)) == 0)
+        {
+            return entry.mRloc16;
+        }
+    }
+#endif
+
+    return FB_RLOC16_INVALID;
+}
+
+uint16_t frame_budget_coap(otInstance *inst, const otIp6Address *dst, uint16_t port)
+{
+    uint16_t src_rloc16 = otThreadGetRloc16(inst);
+    uint16_t dst_rloc16 = fb_dst_rloc16(inst, dst);
+    uint16_t next_hop = FB_RLOC16_INVALID;
+    uint8_t path_cost;
+    int budget = FB_PHY_MTU - FB_MAC_HEADER - FB_MAC_ADDRS - FB_MAC_AUX_SECURITY - FB_MAC_FOOTER;
+
+    if (dst_rloc16 != FB_RLOC16_INVALID)
+    {
+        (void)otThreadGetNextHopAndPathCost(inst, dst_rloc16, &next_hop, &path_cost);
+    }
+
+    /* Only a direct neighbour is reached without a mesh header on some hop */
+    if (next_hop == FB_RLOC16_INVALID || next_hop != dst_rloc16)
+    {
+        budget -= FB_MESH_HEADER;
+    }
+
+    budget -= FB_IPHC_BASE;
+    budget -= fb_iphc_addr_len(inst, otThreadGetMeshLocalEid(inst), src_rloc16);
+    budget -= fb_iphc_addr_len(inst, dst, dst_rloc16);
+    budget -= FB_UDP_NHC + fb_udp_ports_len(port, port);
+
+    return MAX(budget, 0);
+}
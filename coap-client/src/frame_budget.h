@@ -0,0 +1,23 @@
+#ifndef FRAME_BUDGET_H
+#define FRAME_BUDGET_H
+
+#include <stdint.h>
+#include <openthread/instance.h>
+#include <openthread/ip6.h>
+
+/**
+ * Number of bytes of a CoAP message (header, options and payload) that fit
+ * into a single 802.15.4 frame towards dst, so that no hop of the route has
+ * to fragment it.
+ *
+ * The 127-byte frame loses the secured MAC header and footer. It also loses
+ * the 6LoWPAN headers with the compression OpenThread applies to the
+ * addresses actually in use:
+ * - the mesh-local source EID;
+ * - dst;
+ * - the UDP ports.
+ * A mesh header is counted unless dst is known to be one hop away.
+ */
+uint16_t frame_budget_coap(otInstance *inst, const otIp6Address *dst, uint16_t port);
+
+#endif /* FRAME_BUDGET_H */
@@ -0,0 +1,101 @@
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+
+#include "history.h"
+#include "metrics.h"
+
+struct history_entry
+{
+    uint32_t time_s;
+    uint16_t len;
+    char text[CONFIG_AQM_HISTORY_RECORD_LEN];
+};
+
+METRICS_COUNTER_DEFINE(history_too_long, "history_too_long");
+
+/*
+ * Ring of records, written by the reporting thread and read by the CoAP
+ * handlers in the OpenThread thread. Records are encoded into the spare
+ * entry outside the lock and copied in on commit.
+ */
+static K_MUTEX_DEFINE(history_lock);
+static struct history_entry entries[CONFIG_AQM_HISTORY_RECORDS];
+static size_t head;
+static size_t count;
+static struct history_entry spare;
+
+static int history_write(struct record_writer *writer, const char *data, size_t len)
+{
+    ARG_UNUSED(writer);
+
+    if (spare.len + len > sizeof(spare.text))
+    {
+        return -ENOMEM;
+    }
+
+    memcpy(&spare.text[spare.len], data, len);
+    spare.len += len;
+    return 0;
+}
+
+void history_init(void)
+{
+    metrics_counter_register(&history_too_long);
+}
+
+struct record_writer *history_writer(void)
+{
+    static struct record_writer writer = {
+        .write = history_write,
+    };
+
+    spare.len = 0;
+    return &writer;
+}
+
+void history_commit(int ret)
+{
+    if (ret != 0)
+    {
+        metrics_counter_inc(&history_too_long);
+        return;
+    }
+
+    spare.time_s = k_uptime_get() / MSEC_PER_SEC;
+
+    k_mutex_lock(&history_lock, K_FOREVER);
+    entries[head] = spare;
+    head = (head + 1) % ARRAY_SIZE(entries);
+    count = MIN(count + 1, ARRAY_SIZE(entries));
+    k_mutex_unlock(&history_lock);
+}
+
+void history_foreach(uint32_t since_s, history_cb_t cb, void *user_data)
+{
+    k_mutex_lock(&history_lock, K_FOREVER);
+    for (size_t i = 0; i < count; i++)
+    {
+        const struct history_entry *entry =
+            &entries[(head + ARRAY_SIZE(entries) - count + i) % ARRAY_SIZE(entries)];
+
+        if (entry->time_s >= since_s && !cb(entry->time_s, entry->text, entry->len, user_data))
+        {
+            break;
+        }
+    }
+    k_mutex_unlock(&history_lock);
+}
+
+void history_latest(history_cb_t cb, void *user_data)
+{
+    k_mutex_lock(&history_lock, K_FOREVER);
+    if (count > 0)
+    {
+        const struct history_entry *entry =
+            &entries[(head + ARRAY_SIZE(entries) - 1) % ARRAY_SIZE(entries)];
+
+        (void)cb(entry->time_s, entry->text, entry->len, user_data);
+    }
+    k_mutex_unlock(&history_lock);
+}
@@ -0,0 +1,50 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "record.h"
+
+/**
+ * Called for one stored record, oldest first.
+ *
+ * @param time_s uptime in seconds at which the record was taken
+ * @param text the record, not NUL-terminated
+ * @return false to stop
+ */
+typedef bool (*history_cb_t)(uint32_t time_s, const char *text, size_t len, void *user_data);
+
+/**
+ * Register the history metrics. Call once.
+ */
+void history_init(void);
+
+/**
+ * Writer for the record of the current cycle. Encode the record into it,
+ * then call history_commit(). Reporting thread only.
+ */
+struct record_writer *history_writer(void);
+
+/**
+ * Store the record written since history_writer(), replacing the oldest
+ * once CONFIG_AQM_HISTORY_RECORDS are kept. Records longer than
+ * CONFIG_AQM_HISTORY_RECORD_LEN are not stored.
+ *
+ * @param ret result of the encoder
+ */
+void history_commit(int ret);
+
+/**
+ * Call cb for every stored record taken at or after since_s, oldest first.
+ * Records are not added while this runs.
+ */
+void history_foreach(uint32_t since_s, history_cb_t cb, void *user_data);
+
+/**
+ * Call cb for the newest record, if there is one.
+ */
+void history_latest(history_cb_t cb, void *user_data);
+
+#endif /* HISTORY_H */
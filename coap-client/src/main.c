@@ -1,17 +1,49 @@
 #include <zephyr/kernel.h>
 #include <zephyr/device.h>
 #include <zephyr/drivers/sensor.h>
-#include "sensor/sps30/sps30.h"
 #include <zephyr/sys/printk.h>
 #include <zephyr/logging/log.h>
-#include <zephyr/drivers/sensor/ccs811.h>
-#include "sensor/scd4x/scd4x.h"
+#include <string.h>
+#include "aqm_trace.h"
+#include "bench.h"
+#include "metrics.h"
+#include "record.h"
+#include "sensor_acq.h"
+
+METRICS_HISTOGRAM_DEFINE(encode_us, "encode_us", METRICS_BOUNDS_US);
 
 // COAP BEGIN
+#ifdef CONFIG_OPENTHREAD_COAP
 #include <zephyr/net/openthread.h>
 #include <openthread/thread.h>
 #include <openthread/coap.h>
-#include <string.h>
+#include "aggregator.h"
+#include "alert.h"
+#include "control.h"
+#include "frame_budget.h"
+#include "ot_monitor.h"
+#include "pull.h"
+#include "schema.h"
+#include "sink.h"
+
+/* RFC 7252 defaults, which OpenThread uses for requests without tx parameters */
+#define COAP_ACK_TIMEOUT_MS 2000
+#define COAP_MAX_RETRANSMIT 4
+
+METRICS_COUNTER_DEFINE(coap_send_ok, "coap_send_ok");
+METRICS_COUNTER_DEFINE(coap_send_err, "coap_send_err");
+METRICS_COUNTER_DEFINE(coap_ack, "coap_ack");
+METRICS_COUNTER_DEFINE(coap_timeout, "coap_timeout");
+METRICS_COUNTER_DEFINE(coap_refused, "coap_refused");
+METRICS_COUNTER_DEFINE(coap_retx_min, "coap_retx_min");
+METRICS_COUNTER_DEFINE(coap_deferred, "coap_deferred");
+METRICS_COUNTER_DEFINE(coap_unavailable, "coap_unavailable");
+METRICS_COUNTER_DEFINE(coap_backoff, "coap_backoff");
+METRICS_COUNTER_DEFINE(coap_frame_budget, "coap_frame_budget");
+METRICS_COUNTER_DEFINE(coap_split, "coap_split");
+METRICS_COUNTER_DEFINE(coap_oversize, "coap_oversize");
+METRICS_HISTOGRAM_DEFINE(coap_rtt_ms, "coap_rtt_ms", 10, 25, 50, 100, 250, 500, 1000, 2500, 5000,
+                         10000, 30000);
 
 static void coap_init(void)
 {
@@ -20,131 +52,583 @@ static void coap_init(void)
     if (err != OT_ERROR_NONE)
     {
         printk("Failed to start CoAP: %d\n", err);
+        return;
     }
+
+    metrics_counter_register(&coap_send_ok);
+    metrics_counter_register(&coap_send_err);
+    metrics_counter_register(&coap_ack);
+    metrics_counter_register(&coap_timeout);
+    metrics_counter_register(&coap_refused);
+    metrics_counter_register(&coap_retx_min);
+    metrics_counter_register(&coap_deferred);
+    metrics_counter_register(&coap_unavailable);
+    metrics_counter_register(&coap_backoff);
+    metrics_counter_register(&coap_frame_budget);
+    metrics_counter_register(&coap_split);
+    metrics_counter_register(&coap_oversize);
+    metrics_histogram_register(&coap_rtt_ms);
+#ifdef CONFIG_AQM_METRICS_COAP
+    metrics_coap_init(inst);
+#endif
+    ot_monitor_init();
+    sink_init();
+    control_init();
+#ifdef CONFIG_AQM_AGGREGATOR
+    aggregator_init(inst);
+#endif
+    pull_init(inst);
 }
 
-static void coap_send_data_request(const char *payload)
+/*
+ * OpenThread does not report retransmissions, so they are estimated from the
+ * round trip: with the timeout starting at no less than ACK_TIMEOUT and
+ * doubling, a response after 2 s needs at least one retransmission, after 6 s
+ * two, and so on. A request that timed out was sent MAX_RETRANSMIT more times.
+ *
+ * Only 2.xx responses count as ACKs. Error responses are counted apart and
+ * kept out of the round trip times, and sink failover treats them like a
+ * timeout.
+ */
+static void coap_response_handler(void *context, otMessage *msg, const otMessageInfo *msg_info,
+                                  otError result)
+{
+    uint32_t rtt_ms = k_uptime_get_32() - (uint32_t)(uintptr_t)context;
+    uint32_t retx = 0;
+    bool acked;
+
+    ARG_UNUSED(msg_info);
+
+    AQM_TRACE("coap_ack", rtt_ms, result);
+
+    if (result != OT_ERROR_NONE)
+    {
+        sink_report_result(false);
+        metrics_counter_inc(&coap_timeout);
+        metrics_counter_add(&coap_retx_min, COAP_MAX_RETRANSMIT);
+        return;
+    }
+
+    acked = sink_response_ok(msg);
+    sink_report_result(acked);
+
+    while (retx < COAP_MAX_RETRANSMIT && rtt_ms >= COAP_ACK_TIMEOUT_MS * (BIT(retx + 1) - 1))
+    {
+        retx++;
+    }
+    metrics_counter_add(&coap_retx_min, retx);
+
+    /* An overloaded sink refused the report, hold off instead of sending more */
+    if (otCoapMessageGetCode(msg) == OT_COAP_CODE_SERVICE_UNAVAILABLE)
+    {
+        metrics_counter_inc(&coap_unavailable);
+        sink_report_unavailable(msg);
+    }
+    /* The sink logged the compact records as hex, it needs the schema again */
+    if (otCoapMessageGetCode(msg) == OT_COAP_CODE_PRECONDITION_FAILED)
+    {
+        schema_unknown();
+    }
+    control_apply(msg);
+
+    if (!acked)
+    {
+        metrics_counter_inc(&coap_refused);
+        return;
+    }
+
+    metrics_counter_inc(&coap_ack);
+    metrics_histogram_record(&coap_rtt_ms, rtt_ms);
+}
+
+struct coap_record_writer
+{
+    struct record_writer base;
+    otMessage *msg;
+};
+
+static int coap_record_write(struct record_writer *writer, const char *data, size_t len)
+{
+    struct coap_record_writer *coap = CONTAINER_OF(writer, struct coap_record_writer, base);
+    otError error = otMessageAppend(coap->msg, data, len);
+
+    if (error == OT_ERROR_NO_BUFS)
+    {
+        ot_monitor_alloc_failed();
+    }
+
+    return error == OT_ERROR_NONE ? 0 : -ENOMEM;
+}
+
+/* Report message being filled, kept across cycles while records are merged */
+static otMessage *report_msg;
+static uint8_t report_records;
+/* Whether report_msg holds compact records */
+static bool report_compact;
+
+/*
+ * OpenThread takes no pre-serialized header, so the fixed options are
+ * appended per message; they are a few bytes.
+ *
+ * Reports are bulk traffic: low priority in the OpenThread queues, and NON
+ * except for one confirmable probe in every control_con_every() messages,
+ * which keeps the ACK-based failover and the reporting control going.
+ */
+static otError coap_report_new(otInstance *inst, bool compact)
+{
+    static const otMessageSettings bulk = {
+        .mLinkSecurityEnabled = true,
+        .mPriority = OT_MESSAGE_PRIORITY_LOW,
+    };
+    static uint32_t reports;
+    otError error;
+
+    report_msg = otCoapNewMessage(inst, &bulk);
+    if (!report_msg)
+    {
+        ot_monitor_alloc_failed();
+        return OT_ERROR_NO_BUFS;
+    }
+
+    otCoapMessageInit(report_msg,
+                      reports++ % control_con_every() == 0 ? OT_COAP_TYPE_CONFIRMABLE
+                                                           : OT_COAP_TYPE_NON_CONFIRMABLE,
+                      OT_COAP_CODE_PUT);
+    error = otCoapMessageAppendUriPathOptions(report_msg, "storedata");
+    if (error == OT_ERROR_NONE)
+    {
+        error = otCoapMessageAppendContentFormatOption(
+            report_msg, compact ? OT_COAP_OPTION_CONTENT_FORMAT_OCTET_STREAM
+                                : OT_COAP_OPTION_CONTENT_FORMAT_JSON);
+    }
+    if (error == OT_ERROR_NONE)
+    {
+        error = otCoapMessageSetPayloadMarker(report_msg);
+    }
+
+    if (error != OT_ERROR_NONE)
+    {
+        otMessageFree(report_msg);
+        report_msg = NULL;
+    }
+    report_records = 0;
+    report_compact = compact;
+
+    return error;
+}
+
+static void coap_report_flush(otInstance *inst, const otMessageInfo *msg_info, uint16_t budget)
+{
+    uint16_t len = otMessageGetLength(report_msg);
+    bool confirmable = otCoapMessageGetType(report_msg) == OT_COAP_TYPE_CONFIRMABLE;
+    uint32_t stage_start;
+    otError error;
+
+    if (len > budget)
+    {
+        metrics_counter_inc(&coap_oversize);
+    }
+
+    AQM_TRACE("coap_send_start", len, report_records);
+    stage_start = bench_start();
+    /* A NON report gets no response, a handler would only see it time out */
+    error = otCoapSendRequest(inst, report_msg, msg_info,
+                              confirmable ? coap_response_handler : NULL,
+                              (void *)(uintptr_t)k_uptime_get_32());
+    bench_stop(BENCH_STAGE_SEND, stage_start);
+    AQM_TRACE("coap_send_end", error, 0);
+
+    if (error != OT_ERROR_NONE)
+    {
+        metrics_counter_inc(&coap_send_err);
+        printk("CoAP send failed: %d\n", error);
+        otMessageFree(report_msg);
+    }
+    else
+    {
+        metrics_counter_inc(&coap_send_ok);
+        printk("CoAP payload sent (%u bytes, %u records).\n", len, report_records);
+    }
+
+    report_msg = NULL;
+    report_records = 0;
+}
+
+/*
+ * Pack the current record into messages that each fit one 802.15.4 frame on
+ * the current route, so no hop fragments them; a lost fragment loses the
+ * whole datagram and multiplies the loss over several hops.
+ *
+ * Records are encoded field by field straight into the message payload. Up to
+ * control_batch() records of consecutive cycles share a message
+ * while they fit. A record that does not fit next to earlier ones is cut back
+ * with otMessageSetLength() and starts the next message. A record that does
+ * not fit a frame on its own is split at field boundaries into parts, see
+ * record_encode_part().
+ *
+ * Once the sink has the schema, records are compact instead, see
+ * schema_wire.h. They are never split; a message holds either kind only.
+ *
+ * Returns the payload bytes of the records packed in this call.
+ */
+static size_t coap_report_send(otInstance *inst)
 {
-    otInstance *inst = openthread_get_default_instance();
-    otError error = OT_ERROR_NONE;
-    otMessage *msg = NULL;
     otMessageInfo msg_info;
-    const otMeshLocalPrefix *prefix = otThreadGetMeshLocalPrefix(inst);
-    uint8_t dst_suffix[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    struct coap_record_writer writer = {
+        .base.write = coap_record_write,
+    };
+    size_t count = acq_field_count();
+    size_t first = 0;
+    size_t payload_len = 0;
+    bool compact;
+    uint16_t budget;
+    uint16_t start_len;
+    uint32_t stage_start;
+    int next;
+
+    memset(&msg_info, 0, sizeof(msg_info));
+    if (!sink_get(inst, &msg_info.mPeerAddr, &msg_info.mPeerPort))
+    {
+        metrics_counter_inc(&coap_send_err);
+        printk("No sink to report to\n");
+        return 0;
+    }
+
+    budget = frame_budget_coap(inst, &msg_info.mPeerAddr, msg_info.mPeerPort);
+    metrics_counter_set(&coap_frame_budget, budget);
+
+    compact = schema_compact(inst, &msg_info.mPeerAddr, msg_info.mPeerPort);
+    if (report_msg && report_compact != compact)
+    {
+        coap_report_flush(inst, &msg_info, budget);
+    }
 
     do
     {
-        msg = otCoapNewMessage(inst, NULL);
-        if (!msg)
+        if (!report_msg && coap_report_new(inst, compact) != OT_ERROR_NONE)
         {
+            metrics_counter_inc(&coap_send_err);
             printk("Failed to allocate CoAP message\n");
-            return;
+            return payload_len;
         }
 
-        otCoapMessageInit(msg, OT_COAP_TYPE_CONFIRMABLE, OT_COAP_CODE_PUT);
-        error = otCoapMessageAppendUriPathOptions(msg, "storedata");
-        if (error != OT_ERROR_NONE)
-            break;
+        writer.msg = report_msg;
+        start_len = otMessageGetLength(report_msg);
+        stage_start = k_cycle_get_32();
+        if (compact)
+        {
+            next = record_encode_compact(&writer.base, schema_id());
+            /* Report that it does not fit, so it moves on whole like a text record */
+            if (next == 0)
+            {
+                next = otMessageGetLength(report_msg) > budget && report_records > 0 ? 0 : count;
+            }
+        }
+        else
+        {
+            next = record_encode_part(&writer.base, first,
+                                      budget > start_len ? budget - start_len : 0);
+        }
+        bench_stop(BENCH_STAGE_FORMAT, stage_start);
+        metrics_histogram_record_since(&encode_us, stage_start);
 
-        error = otCoapMessageAppendContentFormatOption(msg, OT_COAP_OPTION_CONTENT_FORMAT_JSON);
-        if (error != OT_ERROR_NONE)
-            break;
+        if (next < 0)
+        {
+            (void)otMessageSetLength(report_msg, start_len);
+            if (report_records == 0)
+            {
+                metrics_counter_inc(&coap_send_err);
+                printk("CoAP send failed: %d\n", next);
+                otMessageFree(report_msg);
+                report_msg = NULL;
+                return payload_len;
+            }
+            /* Out of buffers: send what is packed, retry into a new message */
+            coap_report_flush(inst, &msg_info, budget);
+            continue;
+        }
 
-        error = otCoapMessageSetPayloadMarker(msg);
-        if (error != OT_ERROR_NONE)
-            break;
+        /* Whole records only next to earlier ones */
+        if ((size_t)next < count && first == 0 && report_records > 0)
+        {
+            (void)otMessageSetLength(report_msg, start_len);
+            coap_report_flush(inst, &msg_info, budget);
+            continue;
+        }
 
-        error = otMessageAppend(msg, (const void *)payload, strlen(payload));
-        if (error != OT_ERROR_NONE)
-            break;
+        if ((size_t)next < count && first == 0)
+        {
+            metrics_counter_inc(&coap_split);
+        }
 
-        memset(&msg_info, 0, sizeof(msg_info));
-        memcpy(&msg_info.mPeerAddr.mFields.m8[0], prefix, 8);
-        memcpy(&msg_info.mPeerAddr.mFields.m8[8], dst_suffix, 8);
-        msg_info.mPeerPort = OT_DEFAULT_COAP_PORT;
+        payload_len += otMessageGetLength(report_msg) - start_len;
+        report_records++;
+        first = next;
 
-        error = otCoapSendRequest(inst, msg, &msg_info, NULL, NULL);
-    } while (false);
+        if (first < count || report_records >= control_batch())
+        {
+            coap_report_flush(inst, &msg_info, budget);
+        }
+    } while (first < count);
 
-    if (error != OT_ERROR_NONE)
+    return payload_len;
+}
+
+/* The main thread shares the OpenThread instance with the OpenThread thread */
+static size_t coap_send_report(void)
+{
+    struct openthread_context *ctx = openthread_get_default_context();
+    size_t payload_len;
+
+    openthread_api_mutex_lock(ctx);
+    payload_len = coap_report_send(ctx->instance);
+    openthread_api_mutex_unlock(ctx);
+
+    return payload_len;
+}
+
+#ifdef CONFIG_AQM_ALERT
+/*
+ * Whether the alarm in flight went to the sink of the reports. Only then does
+ * its response count for the failover of that sink; an alarm sent past an
+ * aggregator tells nothing about the aggregator. Under the OpenThread API
+ * mutex.
+ */
+static bool alert_to_report_sink;
+
+/* OpenThread rejects tx parameters whose longest exchange overflows 32 bits */
+BUILD_ASSERT((uint64_t)CONFIG_AQM_ALERT_ACK_TIMEOUT_MS *
+                     (BIT64(CONFIG_AQM_ALERT_MAX_RETRANSMIT + 1) - 1) * 3 / 2 <=
+                 UINT32_MAX,
+             "CONFIG_AQM_ALERT_ACK_TIMEOUT_MS too long for CONFIG_AQM_ALERT_MAX_RETRANSMIT");
+
+static void coap_alert_handler(void *context, otMessage *msg, const otMessageInfo *msg_info,
+                               otError result)
+{
+    bool acked = result == OT_ERROR_NONE && sink_response_ok(msg);
+
+    ARG_UNUSED(msg_info);
+
+    AQM_TRACE("coap_alert_ack", acked, result);
+    if (alert_to_report_sink)
     {
-        printk("CoAP send failed: %d\n", error);
-        if (msg)
-            otMessageFree(msg);
+        sink_report_result(acked);
     }
-    else
+
+    if (result == OT_ERROR_NONE)
     {
-        printk("CoAP payload sent.\n");
+        if (otCoapMessageGetCode(msg) == OT_COAP_CODE_SERVICE_UNAVAILABLE)
+        {
+            metrics_counter_inc(&coap_unavailable);
+            sink_report_unavailable(msg);
+        }
+        if (!acked)
+        {
+            metrics_counter_inc(&coap_refused);
+        }
+        control_apply(msg);
     }
+
+    alert_send_end(context, acked);
 }
-// COAP END
 
-#if !DT_HAS_COMPAT_STATUS_OKAY(sensirion_scd41)
-#error "No sensirion,scd4x compatible node found in the device tree"
-#endif
-#if !DT_HAS_COMPAT_STATUS_OKAY(sensirion_sps30)
-#error "No sensirion,sps30 compatible node found in the device tree"
+/*
+ * Alarms are the urgent class. They go out in their own message before the
+ * cycle's report, whatever the backoff or backpressure: confirmable, with
+ * high priority in the OpenThread queues, which also lets the routers
+ * forward it first, and with a shorter ACK timeout and more retransmissions
+ * than the reports. An alarm that is still not acknowledged is sent again
+ * in the next cycle.
+ *
+ * Alarms go to a sink even while the reports go to an aggregator, which
+ * would acknowledge them itself and hold them until its next upload.
+ */
+static void coap_alert_send(otInstance *inst)
+{
+    static const otMessageSettings urgent = {
+        .mLinkSecurityEnabled = true,
+        .mPriority = OT_MESSAGE_PRIORITY_HIGH,
+    };
+    static const otCoapTxParameters urgent_tx = {
+        .mAckTimeout = CONFIG_AQM_ALERT_ACK_TIMEOUT_MS,
+        .mAckRandomFactorNumerator = 3,
+        .mAckRandomFactorDenominator = 2,
+        .mMaxRetransmit = CONFIG_AQM_ALERT_MAX_RETRANSMIT,
+    };
+    otMessageInfo msg_info;
+    struct coap_record_writer writer = {
+        .base.write = coap_record_write,
+    };
+    uint32_t mask = alert_check();
+    otIp6Address report_addr;
+    uint16_t report_port;
+    void *context;
+    otError error;
+
+    memset(&msg_info, 0, sizeof(msg_info));
+    if (mask == 0 || !sink_get_direct(inst, &msg_info.mPeerAddr, &msg_info.mPeerPort))
+    {
+        return;
+    }
+    alert_to_report_sink = sink_get(inst, &report_addr, &report_port) &&
+                           otIp6IsAddressEqual(&report_addr, &msg_info.mPeerAddr);
+
+    writer.msg = otCoapNewMessage(inst, &urgent);
+    if (!writer.msg)
+    {
+        ot_monitor_alloc_failed();
+        metrics_counter_inc(&coap_send_err);
+        return;
+    }
+
+    otCoapMessageInit(writer.msg, OT_COAP_TYPE_CONFIRMABLE, OT_COAP_CODE_PUT);
+    error = otCoapMessageAppendUriPathOptions(writer.msg, "storedata");
+    if (error == OT_ERROR_NONE)
+    {
+        error = otCoapMessageAppendContentFormatOption(writer.msg,
+                                                       OT_COAP_OPTION_CONTENT_FORMAT_JSON);
+    }
+    if (error == OT_ERROR_NONE)
+    {
+        error = otCoapMessageSetPayloadMarker(writer.msg);
+    }
+    if (error == OT_ERROR_NONE && alert_encode(&writer.base, mask) != 0)
+    {
+        error = OT_ERROR_NO_BUFS;
+    }
+    if (error == OT_ERROR_NONE)
+    {
+        context = alert_send_begin(mask);
+        error = otCoapSendRequestWithParameters(inst, writer.msg, &msg_info, coap_alert_handler,
+                                                context, &urgent_tx);
+        if (error != OT_ERROR_NONE)
+        {
+            alert_send_end(context, false);
+        }
+    }
+
+    if (error != OT_ERROR_NONE)
+    {
+        metrics_counter_inc(&coap_send_err);
+        printk("Alert send failed: %d\n", error);
+        otMessageFree(writer.msg);
+        return;
+    }
+
+    metrics_counter_inc(&coap_send_ok);
+}
+
+static void coap_send_alerts(void)
+{
+    struct openthread_context *ctx = openthread_get_default_context();
+
+    openthread_api_mutex_lock(ctx);
+    coap_alert_send(ctx->instance);
+    openthread_api_mutex_unlock(ctx);
+}
 #endif
 
-const struct device *scd41 = DEVICE_DT_GET_ANY(sensirion_scd41);
-const struct device *ccs811 = DEVICE_DT_GET_ANY(ams_ccs811);
-const struct device *sps30 = DEVICE_DT_GET_ANY(sensirion_sps30);
+/*
+ * After a 5.03 from the sink every report is skipped until its Max-Age is over.
+ * Under local backpressure a report is skipped too, but after
+ * CONFIG_AQM_BACKPRESSURE_MAX_DEFER skipped cycles one goes out regardless.
+ * Skipped reports are not queued, the next one carries the newest values.
+ */
+static bool coap_defer_report(void)
+{
+    if (sink_backoff_remaining_s() > 0)
+    {
+        metrics_counter_inc(&coap_backoff);
+        return true;
+    }
+
+#ifdef CONFIG_AQM_OT_MONITOR
+    static uint8_t deferred;
+
+    if (ot_monitor_backpressure() && deferred < CONFIG_AQM_BACKPRESSURE_MAX_DEFER)
+    {
+        deferred++;
+        metrics_counter_inc(&coap_deferred);
+        return true;
+    }
+    deferred = 0;
+#endif
+    return false;
+}
+#endif /* CONFIG_OPENTHREAD_COAP */
+// COAP END
 
 int main(void)
 {
+    metrics_histogram_register(&encode_us);
+
+#ifdef CONFIG_OPENTHREAD_COAP
     coap_init(); // COAP INIT CALL
+#endif
 
-    if (!device_is_ready(scd41) || !device_is_ready(ccs811) || !device_is_ready(sps30))
+    if (acq_init() == 0)
     {
         printk("Sensor(s) not ready\n");
         return 1;
     }
 
-    struct sensor_value pm_1p0, pm_2p5, pm_10p0, pm_4p0, pm_0p5, pm_1p0_nc, pm_2p5_nc, pm_4p0_nc, pm_10p0_nc, typical_particle_size;
-    struct sensor_value co2, temo, humi, eco2, tvoc;
-    char json_buf[1024];
+#ifdef CONFIG_AQM_ALERT
+    alert_init();
+#endif
+#ifdef CONFIG_OPENTHREAD_COAP
+    schema_init();
+#endif
+
+    int64_t next_cycle = k_uptime_get();
+    uint32_t stage_start;
+    size_t payload_len;
+
+    bench_init();
 
     while (true)
     {
-        sensor_sample_fetch(scd41);
-        sensor_channel_get(scd41, SENSOR_CHAN_CO2_SCD, &co2);
-        sensor_channel_get(scd41, SENSOR_CHAN_AMBIENT_TEMP, &temo);
-        sensor_channel_get(scd41, SENSOR_CHAN_HUMIDITY, &humi);
+        stage_start = bench_start();
+        acq_run_cycle();
+        bench_stop(BENCH_STAGE_ACQ, stage_start);
 
-        if (sensor_sample_fetch(ccs811) == 0)
-        {
-            sensor_channel_get(ccs811, SENSOR_CHAN_CO2, &eco2);
-            sensor_channel_get(ccs811, SENSOR_CHAN_VOC, &tvoc);
-        }
+#ifdef CONFIG_AQM_ALERT
+        /* Alarms go out before anything else of the cycle */
+        coap_send_alerts();
+#endif
 
-        sensor_sample_fetch(sps30);
-        sensor_channel_get(sps30, SENSOR_CHAN_PM_1_0, &pm_1p0);
-        sensor_channel_get(sps30, SENSOR_CHAN_PM_2_5, &pm_2p5);
-        sensor_channel_get(sps30, SENSOR_CHAN_PM_10, &pm_10p0);
-        sensor_channel_get(sps30, SENSOR_CHAN_PM_4_0, &pm_4p0);
-        sensor_channel_get(sps30, SENSOR_CHAN_PM_0_5, &pm_0p5);
-        sensor_channel_get(sps30, SENSOR_CHAN_PM_1_0_NC, &pm_1p0_nc);
-        sensor_channel_get(sps30, SENSOR_CHAN_PM_2_5_NC, &pm_2p5_nc);
-        sensor_channel_get(sps30, SENSOR_CHAN_PM_4_0_NC, &pm_4p0_nc);
-        sensor_channel_get(sps30, SENSOR_CHAN_PM_10_NC, &pm_10p0_nc);
-        sensor_channel_get(sps30, SENSOR_CHAN_PM_TYPICAL_PARTICLE_SIZE, &typical_particle_size);
-
-        snprintf(json_buf, sizeof(json_buf),
-                 "<DATA>%d.%06d,%d.%06d,%d.%06d,%d.%06d,%d.%06d,%d.%06d</DATA>",
-                 co2.val1, co2.val2,
-                 temo.val1, temo.val2,
-                 humi.val1, humi.val2,
-                 tvoc.val1, tvoc.val2,
-                 pm_2p5.val1, pm_2p5.val2,
-                 pm_10p0.val1, pm_10p0.val2);
-
-        printk("%s\n", json_buf);
+        payload_len = 0;
+#ifdef CONFIG_AQM_CONSOLE_RECORDS
+        /* Without CoAP the console copy is the only encoding and takes the format stage */
+        stage_start = k_cycle_get_32();
+        record_console_writer()->len = 0;
+        (void)record_encode(record_console_writer());
+        printk("\n");
+#ifndef CONFIG_OPENTHREAD_COAP
+        bench_stop(BENCH_STAGE_FORMAT, stage_start);
+        metrics_histogram_record_since(&encode_us, stage_start);
+        payload_len = record_console_writer()->len;
+#endif
+#endif
 
         // COAP BEGIN
-        coap_send_data_request(json_buf);
+#ifdef CONFIG_OPENTHREAD_COAP
+        pull_cycle();
+        if (pull_push_enabled() && !coap_defer_report())
+        {
+            payload_len = coap_send_report();
+        }
+#endif
         // COAP END
 
-        k_sleep(K_SECONDS(5));
+        bench_end_iteration(payload_len);
+
+        /* Fixed period: a slow cycle shortens the following sleep instead of shifting the schedule */
+#ifdef CONFIG_AQM_CONTROL
+        next_cycle += control_interval_ms();
+#else
+        next_cycle += CONFIG_AQM_REPORT_INTERVAL_MS;
+#endif
+        k_sleep(K_MSEC(MAX(next_cycle - k_uptime_get(), 0)));
     }
 
     return 0;
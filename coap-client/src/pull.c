@@ -0,0 +1,498 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/openthread.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/printk.h>
+#include <openthread/coap.h>
+#include <openthread/message.h>
+
+#include "coap_block.h"
+#include "control.h"
+#include "fmt.h"
+#include "history.h"
+#include "metrics.h"
+#include "ot_monitor.h"
+#include "pull.h"
+#include "record.h"
+
+/* Longest URI query and PUT /config payload accepted */
+#define PULL_TEXT_LEN 32
+/* Observe sequence numbers are 24 bits */
+#define PULL_OBSERVE_SEQ_MASK 0xffffff
+
+struct pull_observer
+{
+    otIp6Address addr;
+    uint16_t port;
+    uint8_t token[OT_COAP_MAX_TOKEN_LENGTH];
+    uint8_t token_len;
+    /* Uptime the registration runs out, 0 for a free slot */
+    int64_t expires;
+};
+
+struct pull_rsp
+{
+    otMessage *msg;
+    size_t len;
+};
+
+METRICS_COUNTER_DEFINE(pull_requests, "pull_requests");
+METRICS_COUNTER_DEFINE(pull_notify, "pull_notify");
+METRICS_COUNTER_DEFINE(pull_observers, "pull_observers");
+
+/* Registered from the OpenThread thread, notified from the reporting thread */
+static K_MUTEX_DEFINE(pull_lock);
+static struct pull_observer observers[CONFIG_AQM_PULL_MAX_OBSERVERS];
+static uint32_t observe_seq;
+
+static atomic_t push_enabled = ATOMIC_INIT(IS_ENABLED(CONFIG_AQM_PULL_PUSH));
+
+bool pull_push_enabled(void)
+{
+    return atomic_get(&push_enabled);
+}
+
+/* Append one "<uptime_s> <record>" line, whole lines only */
+static bool pull_append(uint32_t time_s, const char *text, size_t len, void *user_data)
+{
+    struct pull_rsp *rsp = user_data;
+    char time[FMT_U32_LEN + 1];
+    size_t time_len = fmt_u32(time, time_s);
+
+    time[time_len++] = ' ';
+    if (rsp->len + time_len + len + 1 > CONFIG_AQM_PULL_MAX_PAYLOAD)
+    {
+        return false;
+    }
+
+    /* The payload marker only goes in with a payload */
+    if ((rsp->len == 0 && otCoapMessageSetPayloadMarker(rsp->msg) != OT_ERROR_NONE) ||
+        otMessageAppend(rsp->msg, time, time_len) != OT_ERROR_NONE ||
+        otMessageAppend(rsp->msg, text, len) != OT_ERROR_NONE ||
+        otMessageAppend(rsp->msg, "\n", 1) != OT_ERROR_NONE)
+    {
+        return false;
+    }
+
+    rsp->len += time_len + len + 1;
+    return true;
+}
+
+#ifdef CONFIG_AQM_BLOCKWISE
+/* Feed one "<uptime_s> <record>" line to the requested block */
+static bool pull_append_block(uint32_t time_s, const char *text, size_t len, void *user_data)
+{
+    struct coap_block_window *win = user_data;
+    char time[FMT_U32_LEN + 1];
+    size_t time_len = fmt_u32(time, time_s);
+
+    time[time_len++] = ' ';
+    return coap_block_window_put(win, time, time_len) && coap_block_window_put(win, text, len) &&
+           coap_block_window_put(win, "\n", 1);
+}
+
+/*
+ * Fill a /history response with the block asked for in the Block2 option, or
+ * with the first block if there is none. Records taken meanwhile are added at
+ * the end, so the blocks of a transfer stay consistent unless the oldest
+ * record at or after since_s is replaced during it.
+ */
+static otError pull_history_block(otMessage *rsp, const otMessage *req, uint32_t since_s)
+{
+    static char block_buf[COAP_BLOCK_MAX_SIZE];
+    struct coap_block block = {.szx = CONFIG_AQM_BLOCK_SZX_MAX};
+    struct coap_block_window win;
+    bool requested = coap_block_get(req, OT_COAP_OPTION_BLOCK2, &block);
+    otError err = OT_ERROR_NONE;
+
+    /* Answer a larger block size with ours, at the same byte offset */
+    if (block.szx > CONFIG_AQM_BLOCK_SZX_MAX)
+    {
+        block.num <<= block.szx - CONFIG_AQM_BLOCK_SZX_MAX;
+        block.szx = CONFIG_AQM_BLOCK_SZX_MAX;
+    }
+
+    coap_block_window_init(&win, block_buf, block.num, block.szx);
+    history_foreach(since_s, pull_append_block, &win);
+    block.more = coap_block_window_more(&win);
+
+    if (requested || block.more)
+    {
+        err = otCoapMessageAppendBlock2Option(rsp, block.num, block.more, block.szx);
+    }
+    if (err == OT_ERROR_NONE && win.len > 0)
+    {
+        err = otCoapMessageSetPayloadMarker(rsp);
+    }
+    if (err == OT_ERROR_NONE)
+    {
+        err = otMessageAppend(rsp, block_buf, win.len);
+    }
+
+    return err;
+}
+#endif
+
+static otMessage *pull_response_new(otInstance *inst, const otMessage *req, otCoapCode code)
+{
+    otMessage *rsp = otCoapNewMessage(inst, NULL);
+
+    if (!rsp)
+    {
+        ot_monitor_alloc_failed();
+        return NULL;
+    }
+
+    if (otCoapMessageInitResponse(rsp, req,
+                                  otCoapMessageGetType(req) == OT_COAP_TYPE_CONFIRMABLE
+                                      ? OT_COAP_TYPE_ACKNOWLEDGMENT
+                                      : OT_COAP_TYPE_NON_CONFIRMABLE,
+                                  code) != OT_ERROR_NONE)
+    {
+        otMessageFree(rsp);
+        return NULL;
+    }
+
+    return rsp;
+}
+
+static void pull_send(otInstance *inst, otMessage *rsp, const otMessageInfo *info, otError err)
+{
+    if (err == OT_ERROR_NONE)
+    {
+        err = otCoapSendResponse(inst, rsp, info);
+    }
+
+    if (err != OT_ERROR_NONE)
+    {
+        otMessageFree(rsp);
+    }
+}
+
+/* Find the first URI query option "<key>=" and copy its value */
+static bool pull_query(const otMessage *msg, const char *key, char *value, size_t size)
+{
+    otCoapOptionIterator iter;
+    const otCoapOption *option;
+    char query[PULL_TEXT_LEN];
+    size_t key_len = strlen(key);
+
+    if (otCoapOptionIteratorInit(&iter, msg) != OT_ERROR_NONE)
+    {
+        return false;
+    }
+
+    for (option = otCoapOptionIteratorGetFirstOptionMatching(&iter, OT_COAP_OPTION_URI_QUERY);
+         option;
+         option = otCoapOptionIteratorGetNextOptionMatching(&iter, OT_COAP_OPTION_URI_QUERY))
+    {
+        if (option->mLength >= sizeof(query) ||
+            otCoapOptionIteratorGetOptionValue(&iter, query) != OT_ERROR_NONE)
+        {
+            continue;
+        }
+        query[option->mLength] = '\0';
+
+        if (strncmp(query, key, key_len) == 0 && query[key_len] == '=' &&
+            option->mLength - key_len - 1 < size)
+        {
+            strcpy(value, &query[key_len + 1]);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Register or deregister the sender of a GET /latest, keyed by its address
+ * and port. A full table turns away new observers, they get a plain response.
+ *
+ * @return true if the sender is registered afterwards
+ */
+static bool pull_observe(const otMessage *msg, const otMessageInfo *msg_info, bool enable)
+{
+    int64_t now = k_uptime_get();
+    struct pull_observer *slot = NULL;
+    uint32_t active = 0;
+
+    k_mutex_lock(&pull_lock, K_FOREVER);
+
+    for (size_t i = 0; i < ARRAY_SIZE(observers); i++)
+    {
+        struct pull_observer *obs = &observers[i];
+
+        if (obs->expires > now && obs->port == msg_info->mPeerPort &&
+            memcmp(&obs->addr, &msg_info->mPeerAddr, sizeof(obs->addr)) == 0)
+        {
+            obs->expires = 0;
+        }
+        if (!slot && obs->expires <= now)
+        {
+            slot = obs;
+        }
+    }
+
+    if (enable && slot)
+    {
+        slot->addr = msg_info->mPeerAddr;
+        slot->port = msg_info->mPeerPort;
+        slot->token_len = otCoapMessageGetTokenLength(msg);
+        memcpy(slot->token, otCoapMessageGetToken(msg), slot->token_len);
+        slot->expires = now + CONFIG_AQM_PULL_OBSERVE_LEASE_S * MSEC_PER_SEC;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(observers); i++)
+    {
+        active += observers[i].expires > now;
+    }
+    metrics_counter_set(&pull_observers, active);
+
+    k_mutex_unlock(&pull_lock);
+
+    return enable && slot;
+}
+
+static void pull_latest_cb(void *context, otMessage *msg, const otMessageInfo *msg_info)
+{
+    otInstance *inst = context;
+    otCoapOptionIterator iter;
+    struct pull_rsp rsp = {0};
+    uint64_t observe;
+    bool observing = false;
+    otError err = OT_ERROR_NONE;
+
+    if (otCoapMessageGetCode(msg) != OT_COAP_CODE_GET)
+    {
+        return;
+    }
+    metrics_counter_inc(&pull_requests);
+
+    if (otCoapOptionIteratorInit(&iter, msg) == OT_ERROR_NONE &&
+        otCoapOptionIteratorGetFirstOptionMatching(&iter, OT_COAP_OPTION_OBSERVE) &&
+        otCoapOptionIteratorGetOptionUintValue(&iter, &observe) == OT_ERROR_NONE)
+    {
+        observing = pull_observe(msg, msg_info, observe == 0);
+    }
+
+    rsp.msg = pull_response_new(inst, msg, OT_COAP_CODE_CONTENT);
+    if (!rsp.msg)
+    {
+        return;
+    }
+
+    if (observing)
+    {
+        err = otCoapMessageAppendObserveOption(rsp.msg, observe_seq);
+    }
+    if (err == OT_ERROR_NONE)
+    {
+        err = otCoapMessageAppendContentFormatOption(rsp.msg,
+                                                     OT_COAP_OPTION_CONTENT_FORMAT_TEXT_PLAIN);
+    }
+    if (err == OT_ERROR_NONE)
+    {
+        history_latest(pull_append, &rsp);
+    }
+    pull_send(inst, rsp.msg, msg_info, err);
+}
+
+static void pull_history_cb(void *context, otMessage *msg, const otMessageInfo *msg_info)
+{
+    otInstance *inst = context;
+    struct pull_rsp rsp = {0};
+    char since[FMT_U32_LEN + 1];
+    unsigned long since_s = 0;
+    char *end;
+    otError err;
+
+    if (otCoapMessageGetCode(msg) != OT_COAP_CODE_GET)
+    {
+        return;
+    }
+    metrics_counter_inc(&pull_requests);
+
+    if (pull_query(msg, "since", since, sizeof(since)))
+    {
+        since_s = strtoul(since, &end, 10);
+        if (end == since || *end != '\0')
+        {
+            rsp.msg = pull_response_new(inst, msg, OT_COAP_CODE_BAD_REQUEST);
+            if (rsp.msg)
+            {
+                pull_send(inst, rsp.msg, msg_info, OT_ERROR_NONE);
+            }
+            return;
+        }
+    }
+
+    rsp.msg = pull_response_new(inst, msg, OT_COAP_CODE_CONTENT);
+    if (!rsp.msg)
+    {
+        return;
+    }
+
+    err = otCoapMessageAppendContentFormatOption(rsp.msg, OT_COAP_OPTION_CONTENT_FORMAT_TEXT_PLAIN);
+    if (err == OT_ERROR_NONE)
+    {
+#ifdef CONFIG_AQM_BLOCKWISE
+        err = pull_history_block(rsp.msg, msg, since_s);
+#else
+        history_foreach(since_s, pull_append, &rsp);
+#endif
+    }
+    pull_send(inst, rsp.msg, msg_info, err);
+}
+
+static void pull_config_cb(void *context, otMessage *msg, const otMessageInfo *msg_info)
+{
+    otInstance *inst = context;
+    otCoapCode code = otCoapMessageGetCode(msg);
+    char text[PULL_TEXT_LEN + 48];
+    otCoapCode rsp_code = OT_COAP_CODE_CONTENT;
+    otMessage *rsp;
+    otError err = OT_ERROR_NONE;
+    int len;
+
+    if (code == OT_COAP_CODE_PUT)
+    {
+        uint16_t offset = otMessageGetOffset(msg);
+        uint16_t text_len = otMessageGetLength(msg) - offset;
+
+        rsp_code = OT_COAP_CODE_BAD_REQUEST;
+        if (text_len < PULL_TEXT_LEN)
+        {
+            otMessageRead(msg, offset, text, text_len);
+            text[text_len] = '\0';
+
+            if (strcmp(text, "push=0") == 0 || strcmp(text, "push=1") == 0)
+            {
+                atomic_set(&push_enabled, text[5] == '1');
+                printk("Periodic reports %s\n", text[5] == '1' ? "on" : "off");
+                rsp_code = OT_COAP_CODE_CHANGED;
+            }
+        }
+    }
+    else if (code != OT_COAP_CODE_GET)
+    {
+        return;
+    }
+    metrics_counter_inc(&pull_requests);
+
+    if (code == OT_COAP_CODE_PUT && otCoapMessageGetType(msg) != OT_COAP_TYPE_CONFIRMABLE)
+    {
+        return;
+    }
+
+    rsp = pull_response_new(inst, msg, rsp_code);
+    if (!rsp)
+    {
+        return;
+    }
+
+    if (rsp_code == OT_COAP_CODE_CONTENT)
+    {
+        len = snprintf(text, sizeof(text), "push=%u interval_ms=%u batch=%u con_every=%u\n",
+                       pull_push_enabled(), control_interval_ms(), control_batch(),
+                       control_con_every());
+
+        err = otCoapMessageAppendContentFormatOption(rsp, OT_COAP_OPTION_CONTENT_FORMAT_TEXT_PLAIN);
+        if (err == OT_ERROR_NONE)
+        {
+            err = otCoapMessageSetPayloadMarker(rsp);
+        }
+        if (err == OT_ERROR_NONE)
+        {
+            err = otMessageAppend(rsp, text, MIN(len, sizeof(text) - 1));
+        }
+    }
+    pull_send(inst, rsp, msg_info, err);
+}
+
+static void pull_notify_one(otInstance *inst, const struct pull_observer *obs)
+{
+    struct pull_rsp rsp = {0};
+    otMessageInfo info;
+    otError err;
+
+    rsp.msg = otCoapNewMessage(inst, NULL);
+    if (!rsp.msg)
+    {
+        ot_monitor_alloc_failed();
+        return;
+    }
+
+    memset(&info, 0, sizeof(info));
+    info.mPeerAddr = obs->addr;
+    info.mPeerPort = obs->port;
+
+    otCoapMessageInit(rsp.msg, OT_COAP_TYPE_NON_CONFIRMABLE, OT_COAP_CODE_CONTENT);
+    err = otCoapMessageSetToken(rsp.msg, obs->token, obs->token_len);
+    if (err == OT_ERROR_NONE)
+    {
+        err = otCoapMessageAppendObserveOption(rsp.msg, observe_seq);
+    }
+    if (err == OT_ERROR_NONE)
+    {
+        err = otCoapMessageAppendContentFormatOption(rsp.msg,
+                                                     OT_COAP_OPTION_CONTENT_FORMAT_TEXT_PLAIN);
+    }
+    if (err == OT_ERROR_NONE)
+    {
+        history_latest(pull_append, &rsp);
+        metrics_counter_inc(&pull_notify);
+    }
+    pull_send(inst, rsp.msg, &info, err);
+}
+
+void pull_cycle(void)
+{
+    struct openthread_context *ctx = openthread_get_default_context();
+    int64_t now = k_uptime_get();
+
+    history_commit(record_encode(history_writer()));
+
+    /* The CoAP handlers take pull_lock with the OpenThread API lock held, so take it first */
+    openthread_api_mutex_lock(ctx);
+    k_mutex_lock(&pull_lock, K_FOREVER);
+    observe_seq = (observe_seq + 1) & PULL_OBSERVE_SEQ_MASK;
+    for (size_t i = 0; i < ARRAY_SIZE(observers); i++)
+    {
+        if (observers[i].expires > now)
+        {
+            pull_notify_one(ctx->instance, &observers[i]);
+        }
+    }
+    k_mutex_unlock(&pull_lock);
+    openthread_api_mutex_unlock(ctx);
+}
+
+void pull_init(otInstance *inst)
+{
+    static otCoapResource latest = {
+        .mUriPath = "latest",
+        .mHandler = pull_latest_cb,
+    };
+    static otCoapResource history = {
+        .mUriPath = "history",
+        .mHandler = pull_history_cb,
+    };
+    static otCoapResource config = {
+        .mUriPath = "config",
+        .mHandler = pull_config_cb,
+    };
+
+    history_init();
+    metrics_counter_register(&pull_requests);
+    metrics_counter_register(&pull_notify);
+    metrics_counter_register(&pull_observers);
+
+    latest.mContext = inst;
+    history.mContext = inst;
+    config.mContext = inst;
+    otCoapAddResource(inst, &latest);
+    otCoapAddResource(inst, &history);
+    otCoapAddResource(inst, &config);
+}
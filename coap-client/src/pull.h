@@ -0,0 +1,55 @@
+#ifndef PULL_H
+#define PULL_H
+
+#include <stdbool.h>
+#include <openthread/instance.h>
+
+#ifdef CONFIG_AQM_PULL
+
+/**
+ * Serve the node's readings for consumers that pull them, as text/plain
+ * lines "<uptime_s> <DATA>...</DATA>":
+ * - GET /latest, the record of the last cycle. Observable: a GET with
+ *   Observe 0 registers for a NON notification after every cycle, for
+ *   CONFIG_AQM_PULL_OBSERVE_LEASE_S seconds; register again to extend.
+ * - GET /history?since=<uptime_s>, the stored records taken at or after
+ *   that time, oldest first. With CONFIG_AQM_BLOCKWISE all of them, in
+ *   Block2 blocks; otherwise as many as fit CONFIG_AQM_PULL_MAX_PAYLOAD,
+ *   continue with the last time plus one.
+ * - GET /config, the effective reporting settings, and PUT /config with
+ *   "push=0" or "push=1" to stop or resume the periodic reports.
+ *
+ * CoAP must be started.
+ */
+void pull_init(otInstance *inst);
+
+/**
+ * Store the record of this cycle and notify the observers of /latest.
+ * Reporting thread only, once per cycle after the acquisition.
+ */
+void pull_cycle(void);
+
+/**
+ * Whether the periodic reports are sent, see PUT /config.
+ */
+bool pull_push_enabled(void);
+
+#else
+
+static inline void pull_init(otInstance *inst)
+{
+    ARG_UNUSED(inst);
+}
+
+static inline void pull_cycle(void)
+{
+}
+
+static inline bool pull_push_enabled(void)
+{
+    return true;
+}
+
+#endif /* CONFIG_AQM_PULL */
+
+#endif /* PULL_H */
@@ -0,0 +1,239 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+
+#include "fmt.h"
+#include "record.h"
+#include "schema_wire.h"
+#include "sensor_acq.h"
+
+/* Longest field with its separator: ",-2147483648.999999@4294967295" */
+#define RECORD_FIELD_MAX (1 + FMT_SENSOR_VALUE_LEN + 1 + FMT_U32_LEN)
+
+static int record_write(struct record_writer *writer, const char *data, size_t len)
+{
+    int ret;
+
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    ret = writer->write(writer, data, len);
+    if (ret == 0)
+    {
+        writer->len += len;
+    }
+
+    return ret;
+}
+
+static size_t record_format_field(char *buf, size_t idx)
+{
+    struct acq_field_sample sample;
+    size_t len;
+
+    acq_get_field(idx, &sample);
+    if (sample.state == ACQ_FIELD_INVALID)
+    {
+        return 0;
+    }
+
+    len = fmt_sensor_value(buf, &sample.value, acq_field_precision(idx));
+    if (sample.state == ACQ_FIELD_STALE)
+    {
+        buf[len++] = '@';
+        len += fmt_u32(&buf[len], sample.age_s);
+    }
+
+    return len;
+}
+
+int record_encode_part(struct record_writer *writer, size_t first, size_t max_len)
+{
+    /* Separator and field are written in one piece */
+    char field[RECORD_FIELD_MAX + 1];
+    const size_t end_len = sizeof("</DATA>") - 1;
+    size_t i;
+    int ret;
+
+    writer->len = 0;
+
+    if (first == 0)
+    {
+        ret = record_write(writer, "<DATA>", sizeof("<DATA>") - 1);
+    }
+    else
+    {
+        /* "<DATA first>", the index of the part's first field */
+        size_t len = sizeof("<DATA ") - 1;
+
+        memcpy(field, "<DATA ", len);
+        len += fmt_u32(&field[len], first);
+        field[len++] = '>';
+        field[len] = '\0';
+        ret = record_write(writer, field, len);
+    }
+
+    for (i = first; i < acq_field_count() && ret == 0; i++)
+    {
+        size_t len = 0;
+
+        if (i > first)
+        {
+            field[len++] = ',';
+        }
+        len += record_format_field(&field[len], i);
+
+        /* The first field of a part goes in regardless, so every part makes progress */
+        if (i > first && writer->len + len + end_len > max_len)
+        {
+            break;
+        }
+
+        field[len] = '\0';
+        ret = record_write(writer, field, len);
+    }
+
+    if (ret == 0)
+    {
+        ret = record_write(writer, "</DATA>", end_len);
+    }
+
+    return ret == 0 ? (int)i : ret;
+}
+
+int record_encode(struct record_writer *writer)
+{
+    int ret = record_encode_part(writer, 0, SIZE_MAX);
+
+    return ret < 0 ? ret : 0;
+}
+
+int record_encode_compact(struct record_writer *writer, uint8_t schema_id)
+{
+    /* NUL-terminated like every piece handed to a writer */
+    uint8_t buf[SCHEMA_RECORD_MAX + 1];
+    size_t count = MIN(acq_field_count(), SCHEMA_MAX_FIELDS);
+    size_t bitmap_len = SCHEMA_BITMAP_LEN(count);
+    uint8_t *present = &buf[SCHEMA_RECORD_HDR];
+    uint8_t *stale = &present[bitmap_len];
+    size_t len = SCHEMA_RECORD_HDR + 2 * bitmap_len;
+    struct acq_field_sample sample;
+    int32_t scaled;
+
+    writer->len = 0;
+    memset(buf, 0, len);
+    buf[0] = schema_id;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        acq_get_field(i, &sample);
+        if (sample.state == ACQ_FIELD_INVALID ||
+            !fmt_sensor_scaled(&sample.value, acq_field_precision(i), &scaled))
+        {
+            continue;
+        }
+
+        if (len + 2 * SCHEMA_VARINT_MAX > SCHEMA_RECORD_MAX)
+        {
+            return -ENOMEM;
+        }
+
+        present[i / 8] |= BIT(i % 8);
+        len += schema_put_varint(&buf[len], schema_zigzag(scaled));
+        if (sample.state == ACQ_FIELD_STALE)
+        {
+            stale[i / 8] |= BIT(i % 8);
+            len += schema_put_varint(&buf[len], sample.age_s);
+        }
+    }
+
+    buf[1] = len - SCHEMA_RECORD_HDR;
+    buf[len] = '\0';
+    return record_write(writer, (const char *)buf, len);
+}
+
+int record_encode_schema(struct record_writer *writer)
+{
+    char prec[] = ":0";
+    int ret = 0;
+
+    writer->len = 0;
+
+    for (size_t i = 0; i < acq_field_count() && ret == 0; i++)
+    {
+        prec[1] = '0' + acq_field_precision(i);
+
+        if (i > 0)
+        {
+            ret = record_write(writer, ",", 1);
+        }
+        if (ret == 0)
+        {
+            ret = record_write(writer, acq_field_name(i), strlen(acq_field_name(i)));
+        }
+        if (ret == 0)
+        {
+            ret = record_write(writer, ":", 1);
+        }
+        if (ret == 0)
+        {
+            ret = record_write(writer, acq_field_unit(i), strlen(acq_field_unit(i)));
+        }
+        if (ret == 0)
+        {
+            ret = record_write(writer, prec, sizeof(prec) - 1);
+        }
+    }
+
+    return ret;
+}
+
+int record_encode_alert(struct record_writer *writer, size_t idx, bool raised)
+{
+    char field[RECORD_FIELD_MAX + 1];
+    size_t len;
+    int ret;
+
+    writer->len = 0;
+
+    ret = record_write(writer, "<ALERT>", sizeof("<ALERT>") - 1);
+    if (ret == 0)
+    {
+        ret = record_write(writer, acq_field_name(idx), strlen(acq_field_name(idx)));
+    }
+    if (ret == 0)
+    {
+        len = 0;
+        field[len++] = ',';
+        len += record_format_field(&field[len], idx);
+        field[len] = '\0';
+        ret = record_write(writer, field, len);
+    }
+    if (ret == 0)
+    {
+        ret = raised ? record_write(writer, ",on</ALERT>", sizeof(",on</ALERT>") - 1)
+                     : record_write(writer, ",off</ALERT>", sizeof(",off</ALERT>") - 1);
+    }
+
+    return ret;
+}
+
+static int record_console_write(struct record_writer *writer, const char *data, size_t len)
+{
+    ARG_UNUSED(writer);
+    ARG_UNUSED(len);
+
+    printk("%s", data);
+    return 0;
+}
+
+struct record_writer *record_console_writer(void)
+{
+    static struct record_writer writer = {
+        .write = record_console_write,
+    };
+
+    return &writer;
+}
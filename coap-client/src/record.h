@@ -0,0 +1,84 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Destination of an encoded record. The encoder hands over the record piece
+ * by piece, so it can go straight into an OpenThread message or to the
+ * console without a buffer for the whole record.
+ */
+struct record_writer
+{
+    /**
+     * Append len bytes. data is NUL-terminated at len.
+     *
+     * @return 0, or a negative errno that aborts the record
+     */
+    int (*write)(struct record_writer *writer, const char *data, size_t len);
+    /* Bytes written so far, maintained by the encoder */
+    size_t len;
+};
+
+/**
+ * Encode the current field values as "<DATA>v1,v2,...</DATA>". Values are
+ * written with the precision of their channel, values kept from an earlier
+ * cycle get their age in seconds appended ("24.30@15"), invalid values are
+ * left empty.
+ *
+ * @return 0, or the first error of the writer
+ */
+int record_encode(struct record_writer *writer);
+
+/**
+ * Encode one part of a record that does not fit a frame as a whole: the
+ * fields from first on, up to the last one that keeps the record within
+ * max_len bytes, and at least one field. A part after the first one starts
+ * with "<DATA first>" and carries no fields before first, trailing fields
+ * are left off. A whole record always carries every field, empty ones
+ * included, so a reader tells a part from a record with invalid fields by
+ * the start index or the missing trailing fields, and merges the parts by
+ * position.
+ *
+ * @return index of the first field that was not encoded, acq_field_count()
+ *         once the record is complete, or the first error of the writer
+ */
+int record_encode_part(struct record_writer *writer, size_t first, size_t max_len);
+
+/**
+ * Encode the current field values as a compact record of the schema with
+ * this ID, see schema_wire.h. Invalid values and values beyond an int32_t
+ * once scaled are left out. The record is written in one piece and is
+ * binary: it may contain NUL bytes before len.
+ *
+ * @return 0, -ENOMEM if the record is longer than SCHEMA_RECORD_MAX, or the
+ *         error of the writer. schema_init() only registers layouts whose
+ *         records always fit, see SCHEMA_RECORD_WORST().
+ */
+int record_encode_compact(struct record_writer *writer, uint8_t schema_id);
+
+/**
+ * Encode the layout of the records, "name:unit:decimals" per field, comma
+ * separated, see schema_wire.h.
+ *
+ * @return 0, or the first error of the writer
+ */
+int record_encode_schema(struct record_writer *writer);
+
+/**
+ * Encode a threshold alarm of one field as "<ALERT>name,value,on</ALERT>",
+ * or with "off" once the value is back below the threshold. The value is the
+ * field's current one, empty if it is invalid.
+ *
+ * @return 0, or the first error of the writer
+ */
+int record_encode_alert(struct record_writer *writer, size_t idx, bool raised);
+
+/**
+ * Writer that prints to the console with printk().
+ */
+struct record_writer *record_console_writer(void);
+
+#endif /* RECORD_H */
@@ -0,0 +1,223 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <openthread/coap.h>
+#include <openthread/message.h>
+
+#include "metrics.h"
+#include "ot_monitor.h"
+#include "record.h"
+#include "schema.h"
+#include "schema_wire.h"
+#include "sensor_acq.h"
+
+enum schema_state
+{
+    SCHEMA_UNREGISTERED,
+    SCHEMA_PENDING,
+    SCHEMA_REGISTERED,
+    /* The sink does not take schemas, or has another one under our ID */
+    SCHEMA_REFUSED,
+};
+
+METRICS_COUNTER_DEFINE(schema_register, "schema_register");
+METRICS_COUNTER_DEFINE(schema_refused, "schema_refused");
+
+/* "<id> <layout>", the payload of the registration, NUL-terminated */
+static char schema_payload[3 + SCHEMA_LAYOUT_MAX + 1];
+static size_t schema_len;
+static uint8_t schema_id_value;
+
+/*
+ * Registration with the current sink. Changed by the reporting thread and by
+ * the response handler in the OpenThread thread. The generation tells a
+ * response for an earlier sink apart.
+ */
+static K_MUTEX_DEFINE(schema_lock);
+static enum schema_state schema_state = SCHEMA_REFUSED;
+static otIp6Address schema_addr;
+static uint16_t schema_port;
+static uint32_t schema_generation;
+
+static int schema_write(struct record_writer *writer, const char *data, size_t len)
+{
+    if (3 + writer->len + len >= sizeof(schema_payload))
+    {
+        return -ENOMEM;
+    }
+
+    memcpy(&schema_payload[3 + writer->len], data, len);
+    return 0;
+}
+
+void schema_init(void)
+{
+    static const char hex[] = "0123456789abcdef";
+    struct record_writer writer = {
+        .write = schema_write,
+    };
+    uint32_t h = 2166136261u;
+
+    metrics_counter_register(&schema_register);
+    metrics_counter_register(&schema_refused);
+
+    /* A layout whose records may not fit the len byte stays on text records for good */
+    if (acq_field_count() > SCHEMA_MAX_FIELDS ||
+        SCHEMA_RECORD_WORST(acq_field_count()) > SCHEMA_RECORD_MAX ||
+        record_encode_schema(&writer) != 0)
+    {
+        printk("Record layout too long for a schema, reporting text\n");
+        return;
+    }
+    schema_len = 3 + writer.len;
+    schema_payload[schema_len] = '\0';
+
+    /* FNV-1a of the layout: nodes with the same sensors share the ID */
+    for (size_t i = 3; i < schema_len; i++)
+    {
+        h ^= (uint8_t)schema_payload[i];
+        h *= 16777619u;
+    }
+    schema_id_value = SCHEMA_ID_MIN | ((h ^ (h >> 7) ^ (h >> 14) ^ (h >> 21)) & 0x7f);
+
+    schema_payload[0] = hex[schema_id_value >> 4];
+    schema_payload[1] = hex[schema_id_value & 0xf];
+    schema_payload[2] = ' ';
+    printk("Schema %02x: %s\n", schema_id_value, &schema_payload[3]);
+
+    schema_state = SCHEMA_UNREGISTERED;
+}
+
+uint8_t schema_id(void)
+{
+    return schema_id_value;
+}
+
+static void schema_response_handler(void *context, otMessage *msg, const otMessageInfo *msg_info,
+                                    otError result)
+{
+    /* Lost or refused for the moment: try again with the next report */
+    enum schema_state state = SCHEMA_UNREGISTERED;
+
+    ARG_UNUSED(msg_info);
+
+    if (result == OT_ERROR_NONE && otCoapMessageGetCode(msg) == OT_COAP_CODE_CHANGED)
+    {
+        state = SCHEMA_REGISTERED;
+    }
+    else if (result == OT_ERROR_NONE &&
+             otCoapMessageGetCode(msg) != OT_COAP_CODE_SERVICE_UNAVAILABLE)
+    {
+        metrics_counter_inc(&schema_refused);
+        printk("Schema %02x refused: %u.%02u\n", schema_id_value,
+               otCoapMessageGetCode(msg) >> 5, otCoapMessageGetCode(msg) & 0x1f);
+        state = SCHEMA_REFUSED;
+    }
+
+    k_mutex_lock(&schema_lock, K_FOREVER);
+    if ((uint32_t)(uintptr_t)context == schema_generation && schema_state == SCHEMA_PENDING)
+    {
+        schema_state = state;
+    }
+    k_mutex_unlock(&schema_lock);
+}
+
+static otError schema_send(otInstance *inst, const otIp6Address *addr, uint16_t port,
+                           uint32_t generation)
+{
+    otMessageInfo msg_info;
+    otMessage *msg;
+    otError error;
+
+    msg = otCoapNewMessage(inst, NULL);
+    if (!msg)
+    {
+        ot_monitor_alloc_failed();
+        return OT_ERROR_NO_BUFS;
+    }
+
+    memset(&msg_info, 0, sizeof(msg_info));
+    msg_info.mPeerAddr = *addr;
+    msg_info.mPeerPort = port;
+
+    otCoapMessageInit(msg, OT_COAP_TYPE_CONFIRMABLE, OT_COAP_CODE_PUT);
+    error = otCoapMessageAppendUriPathOptions(msg, SCHEMA_URI);
+    if (error == OT_ERROR_NONE)
+    {
+        error = otCoapMessageAppendContentFormatOption(msg,
+                                                       OT_COAP_OPTION_CONTENT_FORMAT_TEXT_PLAIN);
+    }
+    if (error == OT_ERROR_NONE)
+    {
+        error = otCoapMessageSetPayloadMarker(msg);
+    }
+    if (error == OT_ERROR_NONE)
+    {
+        error = otMessageAppend(msg, schema_payload, schema_len);
+    }
+    if (error == OT_ERROR_NONE)
+    {
+        error = otCoapSendRequest(inst, msg, &msg_info, schema_response_handler,
+                                  (void *)(uintptr_t)generation);
+    }
+
+    if (error != OT_ERROR_NONE)
+    {
+        otMessageFree(msg);
+    }
+
+    return error;
+}
+
+bool schema_compact(otInstance *inst, const otIp6Address *addr, uint16_t port)
+{
+    enum schema_state state;
+    uint32_t generation;
+
+    if (schema_id_value == 0)
+    {
+        return false;
+    }
+
+    k_mutex_lock(&schema_lock, K_FOREVER);
+    if (port != schema_port || memcmp(addr, &schema_addr, sizeof(*addr)) != 0)
+    {
+        schema_addr = *addr;
+        schema_port = port;
+        schema_state = SCHEMA_UNREGISTERED;
+        schema_generation++;
+    }
+    state = schema_state;
+    generation = schema_generation;
+    if (state == SCHEMA_UNREGISTERED)
+    {
+        schema_state = SCHEMA_PENDING;
+    }
+    k_mutex_unlock(&schema_lock);
+
+    if (state == SCHEMA_UNREGISTERED)
+    {
+        metrics_counter_inc(&schema_register);
+        if (schema_send(inst, addr, port, generation) != OT_ERROR_NONE)
+        {
+            k_mutex_lock(&schema_lock, K_FOREVER);
+            if (generation == schema_generation)
+            {
+                schema_state = SCHEMA_UNREGISTERED;
+            }
+            k_mutex_unlock(&schema_lock);
+        }
+    }
+
+    return state == SCHEMA_REGISTERED;
+}
+
+void schema_unknown(void)
+{
+    k_mutex_lock(&schema_lock, K_FOREVER);
+    if (schema_state == SCHEMA_REGISTERED)
+    {
+        schema_state = SCHEMA_UNREGISTERED;
+    }
+    k_mutex_unlock(&schema_lock);
+}
@@ -0,0 +1,62 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <openthread/instance.h>
+#include <openthread/ip6.h>
+
+#ifdef CONFIG_AQM_SCHEMA
+
+/**
+ * Build the layout of the records and its schema ID, see schema_wire.h.
+ * Call once, after acq_init().
+ */
+void schema_init(void);
+
+/**
+ * Whether reports to this sink may use compact records. The layout is
+ * registered with every new sink first, in the background; reports stay
+ * text until the sink has acknowledged it, and for good if it refused,
+ * as an aggregator does. Reporting thread only.
+ */
+bool schema_compact(otInstance *inst, const otIp6Address *addr, uint16_t port);
+
+/**
+ * ID to tag compact records with.
+ */
+uint8_t schema_id(void);
+
+/**
+ * The sink answered a report with 4.12 Precondition Failed, it lost the
+ * schema: register it again before the next compact record. Safe to call
+ * from the OpenThread thread.
+ */
+void schema_unknown(void);
+
+#else
+
+static inline void schema_init(void)
+{
+}
+
+static inline bool schema_compact(otInstance *inst, const otIp6Address *addr, uint16_t port)
+{
+    ARG_UNUSED(inst);
+    ARG_UNUSED(addr);
+    ARG_UNUSED(port);
+    return false;
+}
+
+static inline uint8_t schema_id(void)
+{
+    return 0;
+}
+
+static inline void schema_unknown(void)
+{
+}
+
+#endif /* CONFIG_AQM_SCHEMA */
+
+#endif /* SCHEMA_H */
@@ -0,0 +1,762 @@
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/sys/printk.h>
+#include <sensirion/scd4x.h>
+#include <sensirion/sps30.h>
+#ifdef CONFIG_AQM_ACQ_ASYNC
+#include "sensirion_common.h"
+#endif
+
+#include "aqm_trace.h"
+#include "bench.h"
+#include "metrics.h"
+#include "sensor_acq.h"
+
+/* Cap for the number of cycles a failing sensor is skipped */
+#define ACQ_MAX_BACKOFF_CYCLES 32
+
+#define ACQ_METRIC_NAME_LEN 40
+
+static const uint32_t acq_fetch_bounds[] = {METRICS_BOUNDS_US};
+#define ACQ_FETCH_BOUNDS ARRAY_SIZE(acq_fetch_bounds)
+
+struct acq_channel
+{
+    enum sensor_channel chan;
+    const char *name;
+    /* SenML unit symbol */
+    const char *unit;
+    /* Reported decimals, no more than the sensor resolves */
+    uint8_t precision;
+};
+
+struct acq_sensor
+{
+    const struct device *dev;
+    const struct device *bus;
+    const char *name;
+    const struct acq_channel *channels;
+    uint8_t num_channels;
+    uint16_t budget_ms;
+#ifdef CONFIG_AQM_ACQ_ASYNC
+    /* Non-blocking read-out, NULL for drivers with sensor_sample_fetch() only */
+    int (*fetch_async)(const struct device *dev, struct sensirion_i2c_async *op);
+    int (*fetch_finish)(const struct device *dev, const struct sensirion_i2c_async *op);
+#endif
+};
+
+struct acq_sensor_state
+{
+    bool ready;
+    /* Consecutive failed or overrun cycles */
+    uint8_t failures;
+    /* Cycles left before the next attempt */
+    uint8_t skip;
+    /* Index of the first field of the sensor */
+    uint8_t first_field;
+    /* Index of the sensor's bus in the distinct buses */
+    uint8_t group;
+    /* "fetch_us.<node>": duration of sensor_sample_fetch() calls, retries included */
+    struct metrics_histogram fetch_us;
+    atomic_t fetch_us_buckets[ACQ_FETCH_BOUNDS + 1];
+    /* "fetch_err.<node>": failed or overrun fetch cycles */
+    struct metrics_counter fetch_err;
+    char fetch_us_name[ACQ_METRIC_NAME_LEN];
+    char fetch_err_name[ACQ_METRIC_NAME_LEN];
+#ifdef CONFIG_AQM_ACQ_ASYNC
+    /* Asynchronous read in flight: attempt and start of the first attempt */
+    uint8_t attempt;
+    int64_t fetch_start;
+    uint32_t fetch_start_cycles;
+#endif
+};
+
+struct acq_field
+{
+    struct sensor_value value;
+    /* Uptime of the last successful read, 0 if never read */
+    int64_t timestamp;
+};
+
+/* Reported channels per sensor type, in payload order */
+static const struct acq_channel scd4x_channels[] = {
+    {SENSOR_CHAN_CO2_SCD, "co2", "ppm", 0},
+    {SENSOR_CHAN_AMBIENT_TEMP, "temp", "Cel", 2},
+    {SENSOR_CHAN_HUMIDITY, "humi", "%RH", 2},
+};
+
+static const struct acq_channel ccs811_channels[] = {
+    {SENSOR_CHAN_VOC, "tvoc", "ppb", 0},
+};
+
+static const struct acq_channel sps30_channels[] = {
+    {SENSOR_CHAN_PM_2_5, "pm2_5", "ug/m3", 2},
+    {SENSOR_CHAN_PM_10, "pm10", "ug/m3", 2},
+};
+
+/* Single shot mode measures inside sample_fetch */
+#define SCD4X_MEASURE_MS(node) (DT_PROP_OR(node, mode, 0) == SCD4X_MODE_SINGLE_SHOT ? 5500 : 0)
+
+#ifdef CONFIG_AQM_ACQ_ASYNC
+#define ACQ_ASYNC_OPS(_start, _finish) .fetch_async = _start, .fetch_finish = _finish,
+#else
+#define ACQ_ASYNC_OPS(_start, _finish)
+#endif
+
+#define ACQ_SENSOR(node, _channels, _extra_ms, _async_ops)                                     \
+    {                                                                                          \
+        .dev = DEVICE_DT_GET(node),                                                            \
+        .bus = DEVICE_DT_GET(DT_BUS(node)),                                                    \
+        .name = DT_NODE_FULL_NAME(node),                                                       \
+        .channels = _channels,                                                                 \
+        .num_channels = ARRAY_SIZE(_channels),                                                 \
+        .budget_ms = CONFIG_AQM_ACQ_SENSOR_BUDGET_MS + (_extra_ms),                            \
+        _async_ops                                                                             \
+    },
+
+#define ACQ_SCD4X(node) ACQ_SENSOR(node, scd4x_channels, SCD4X_MEASURE_MS(node), )
+#define ACQ_CCS811(node) ACQ_SENSOR(node, ccs811_channels, 0, )
+#define ACQ_SPS30(node)                                                                        \
+    ACQ_SENSOR(node, sps30_channels, 0,                                                        \
+               ACQ_ASYNC_OPS(sps30_sample_fetch_async, sps30_sample_fetch_finish))
+
+#define ACQ_NUM_FIELDS_OF(node, _channels) +ARRAY_SIZE(_channels)
+
+static const struct acq_sensor sensors[] = {
+    DT_FOREACH_STATUS_OKAY(sensirion_scd40, ACQ_SCD4X)
+    DT_FOREACH_STATUS_OKAY(sensirion_scd41, ACQ_SCD4X)
+    COND_CODE_1(CONFIG_CCS811, (DT_FOREACH_STATUS_OKAY(ams_ccs811, ACQ_CCS811)), ())
+    DT_FOREACH_STATUS_OKAY(sensirion_sps30, ACQ_SPS30)
+};
+
+#define ACQ_NUM_FIELDS                                                                         \
+    (0 DT_FOREACH_STATUS_OKAY_VARGS(sensirion_scd40, ACQ_NUM_FIELDS_OF, scd4x_channels)        \
+       DT_FOREACH_STATUS_OKAY_VARGS(sensirion_scd41, ACQ_NUM_FIELDS_OF, scd4x_channels)        \
+       COND_CODE_1(CONFIG_CCS811,                                                              \
+                   (DT_FOREACH_STATUS_OKAY_VARGS(ams_ccs811, ACQ_NUM_FIELDS_OF, ccs811_channels)), \
+                   ())                                                                         \
+       DT_FOREACH_STATUS_OKAY_VARGS(sensirion_sps30, ACQ_NUM_FIELDS_OF, sps30_channels))
+
+static struct acq_sensor_state states[ARRAY_SIZE(sensors)];
+static struct acq_field fields[ACQ_NUM_FIELDS];
+
+/* Field index to sensor index */
+static uint8_t field_sensor[ACQ_NUM_FIELDS];
+
+/* Fields are written by the bus workers while the caller reads them */
+static struct k_spinlock fields_lock;
+
+/* Start of the last cycle, values read since then are fresh */
+static int64_t cycle_start;
+
+/*
+ * Number of the current cycle, bumped under fields_lock once the caller stops waiting. A read
+ * that misses the deadline no longer matches it and its values are dropped.
+ */
+static uint32_t cycle_seq;
+
+static uint8_t num_groups;
+
+/* Controller of each group */
+static const struct device *group_bus[ARRAY_SIZE(sensors)];
+
+/* Longest time a cycle waits for its reads, the deadline after cycle_start */
+static uint32_t cycle_budget_ms;
+
+#ifdef CONFIG_AQM_ACQ_WORKERS
+static void acq_run_group(uint8_t group, uint32_t seq);
+
+/* Group n is read by worker n % num_workers */
+struct acq_worker
+{
+    struct k_thread thread;
+    struct k_sem start;
+    struct k_sem done;
+    atomic_t busy;
+    /* Cycle the worker was started for */
+    uint32_t seq;
+    uint8_t index;
+};
+
+static struct acq_worker workers[CONFIG_AQM_ACQ_BUS_WORKERS];
+static K_THREAD_STACK_ARRAY_DEFINE(worker_stacks, CONFIG_AQM_ACQ_BUS_WORKERS,
+                                   CONFIG_AQM_ACQ_WORKER_STACK_SIZE);
+static uint8_t num_workers;
+
+static void acq_worker_main(void *p1, void *p2, void *p3)
+{
+    struct acq_worker *worker = p1;
+
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    while (1)
+    {
+        k_sem_take(&worker->start, K_FOREVER);
+        for (uint8_t group = worker->index; group < num_groups; group += num_workers)
+        {
+            acq_run_group(group, worker->seq);
+        }
+        atomic_clear(&worker->busy);
+        k_sem_give(&worker->done);
+    }
+}
+
+static void acq_start_workers(const uint32_t *group_budget_ms)
+{
+    uint32_t worker_budget_ms[CONFIG_AQM_ACQ_BUS_WORKERS] = {0};
+
+    num_workers = MIN(num_groups, CONFIG_AQM_ACQ_BUS_WORKERS);
+
+    /* The busiest worker sets the deadline */
+    for (uint8_t group = 0; group < num_groups; group++)
+    {
+        worker_budget_ms[group % num_workers] += group_budget_ms[group];
+        cycle_budget_ms = MAX(cycle_budget_ms, worker_budget_ms[group % num_workers]);
+    }
+
+    for (uint8_t i = 0; i < num_workers; i++)
+    {
+        struct acq_worker *worker = &workers[i];
+
+        worker->index = i;
+        k_sem_init(&worker->start, 0, 1);
+        k_sem_init(&worker->done, 0, 1);
+        k_thread_create(&worker->thread, worker_stacks[i], K_THREAD_STACK_SIZEOF(worker_stacks[i]),
+                        acq_worker_main, worker, NULL, NULL,
+                        K_PRIO_PREEMPT(CONFIG_MAIN_THREAD_PRIORITY), 0, K_NO_WAIT);
+        k_thread_name_set(&worker->thread, "acq_bus");
+    }
+}
+
+static void acq_run_workers(int64_t deadline)
+{
+    bool started[CONFIG_AQM_ACQ_BUS_WORKERS] = {false};
+
+    for (uint8_t i = 0; i < num_workers; i++)
+    {
+        /* A worker still stuck in the previous cycle keeps its buses out of this one */
+        if (atomic_cas(&workers[i].busy, 0, 1))
+        {
+            workers[i].seq = cycle_seq;
+            k_sem_reset(&workers[i].done);
+            k_sem_give(&workers[i].start);
+            started[i] = true;
+        }
+    }
+
+    for (uint8_t i = 0; i < num_workers; i++)
+    {
+        if (started[i] &&
+            k_sem_take(&workers[i].done, K_MSEC(MAX(deadline - k_uptime_get(), 0))) != 0)
+        {
+            printk("Bus worker %u missed the cycle deadline\n", i);
+        }
+    }
+}
+#endif /* CONFIG_AQM_ACQ_WORKERS */
+
+#ifdef CONFIG_AQM_ACQ_ASYNC
+/* Read-out of a group: groups are read in parallel, the sensors of a group in turn */
+struct acq_async_group
+{
+    struct sensirion_i2c_async op;
+    struct k_poll_signal signal;
+    /* Sensor whose read is in flight on op, -1 if none */
+    int8_t pending;
+    /* Cycle the read in flight belongs to */
+    uint32_t seq;
+    /* Next sensor to look at */
+    uint8_t next;
+};
+
+static struct acq_async_group async_groups[ARRAY_SIZE(sensors)];
+#endif /* CONFIG_AQM_ACQ_ASYNC */
+
+static void acq_metrics_init(const struct acq_sensor *sensor, struct acq_sensor_state *state)
+{
+    snprintk(state->fetch_us_name, sizeof(state->fetch_us_name), "fetch_us.%s", sensor->name);
+    state->fetch_us.name = state->fetch_us_name;
+    state->fetch_us.bounds = acq_fetch_bounds;
+    state->fetch_us.num_bounds = ACQ_FETCH_BOUNDS;
+    state->fetch_us.buckets = state->fetch_us_buckets;
+    metrics_histogram_register(&state->fetch_us);
+
+    snprintk(state->fetch_err_name, sizeof(state->fetch_err_name), "fetch_err.%s", sensor->name);
+    state->fetch_err.name = state->fetch_err_name;
+    metrics_counter_register(&state->fetch_err);
+}
+
+int acq_init(void)
+{
+    uint32_t group_budget_ms[ARRAY_SIZE(sensors)] = {0};
+    uint32_t sync_budget_ms = 0;
+    int ready = 0;
+    uint8_t field = 0;
+
+    for (size_t i = 0; i < ARRAY_SIZE(sensors); i++)
+    {
+        states[i].first_field = field;
+        for (uint8_t ch = 0; ch < sensors[i].num_channels; ch++)
+        {
+            field_sensor[field++] = i;
+        }
+
+        /* Sensors sharing a controller go into the group of the first one */
+        states[i].group = num_groups;
+        for (size_t j = 0; j < i; j++)
+        {
+            if (sensors[j].bus == sensors[i].bus)
+            {
+                states[i].group = states[j].group;
+                break;
+            }
+        }
+        if (states[i].group == num_groups)
+        {
+            group_bus[num_groups++] = sensors[i].bus;
+        }
+
+        acq_metrics_init(&sensors[i], &states[i]);
+
+        states[i].ready = device_is_ready(sensors[i].dev);
+        if (!states[i].ready)
+        {
+            printk("Sensor %s not ready\n", sensors[i].name);
+            continue;
+        }
+        ready++;
+
+#ifdef CONFIG_AQM_ACQ_ASYNC
+        /* Synchronous fetches block the one thread, so they add up across groups */
+        if (sensors[i].fetch_async == NULL)
+        {
+            sync_budget_ms += sensors[i].budget_ms * (CONFIG_AQM_ACQ_RETRIES + 1);
+            continue;
+        }
+#endif
+        group_budget_ms[states[i].group] += sensors[i].budget_ms * (CONFIG_AQM_ACQ_RETRIES + 1);
+    }
+
+#ifdef CONFIG_AQM_ACQ_WORKERS
+    ARG_UNUSED(sync_budget_ms);
+    if (num_groups > 0)
+    {
+        acq_start_workers(group_budget_ms);
+    }
+#else
+    for (uint8_t group = 0; group < num_groups; group++)
+    {
+        struct acq_async_group *ag = &async_groups[group];
+
+        k_poll_signal_init(&ag->signal);
+        sensirion_i2c_async_init(&ag->op, &ag->signal, NULL, NULL);
+        ag->pending = -1;
+        cycle_budget_ms = MAX(cycle_budget_ms, group_budget_ms[group]);
+    }
+    cycle_budget_ms += sync_budget_ms;
+#endif
+
+    return ready;
+}
+
+static int acq_fetch(const struct acq_sensor *sensor, struct acq_sensor_state *state)
+{
+    int64_t start = k_uptime_get();
+    uint32_t start_cycles = k_cycle_get_32();
+    int ret;
+
+    for (int attempt = 0;; attempt++)
+    {
+        uint32_t fetch_start = bench_start();
+
+        /* Trace arguments: sensor index and attempt, then sensor index and result */
+        AQM_TRACE("fetch_start", sensor - sensors, attempt);
+        ret = sensor_sample_fetch(sensor->dev);
+        AQM_TRACE("fetch_end", sensor - sensors, ret);
+        bench_stop(BENCH_STAGE_FETCH, fetch_start);
+        if (ret == 0 || ret == -ENODATA)
+        {
+            break;
+        }
+
+        if (attempt >= CONFIG_AQM_ACQ_RETRIES || k_uptime_get() - start >= sensor->budget_ms)
+        {
+            break;
+        }
+
+        /* A device holding SDA low after an aborted transfer takes the whole bus with it */
+        if (ret == -EIO)
+        {
+            (void)i2c_recover_bus(sensor->bus);
+        }
+    }
+
+    metrics_histogram_record_since(&state->fetch_us, start_cycles);
+
+    if (ret == 0 && k_uptime_get() - start > sensor->budget_ms)
+    {
+        /* Keep the value, but treat the overrun like a failure for scheduling */
+        return -ETIMEDOUT;
+    }
+
+    return ret;
+}
+
+static void acq_store(const struct acq_sensor *sensor, struct acq_field *first, int64_t now,
+                      uint32_t seq)
+{
+    for (uint8_t i = 0; i < sensor->num_channels; i++)
+    {
+        struct sensor_value value;
+        uint32_t convert_start = bench_start();
+        int ret = sensor_channel_get(sensor->dev, sensor->channels[i].chan, &value);
+
+        bench_stop(BENCH_STAGE_CONVERT, convert_start);
+        if (ret == 0)
+        {
+            k_spinlock_key_t key = k_spin_lock(&fields_lock);
+
+            /* Too late for the cycle, the field stays stale or invalid */
+            if (seq == cycle_seq)
+            {
+                first[i].value = value;
+                first[i].timestamp = now;
+            }
+            k_spin_unlock(&fields_lock, key);
+        }
+    }
+}
+
+/* Whether a ready sensor is read this cycle, counts down the backoff otherwise */
+static bool acq_due(struct acq_sensor_state *state)
+{
+    if (!state->ready)
+    {
+        return false;
+    }
+
+    if (state->skip)
+    {
+        state->skip--;
+        return false;
+    }
+
+    return true;
+}
+
+/* Store the values of a fetch and schedule the sensor by its result */
+static void acq_account(const struct acq_sensor *sensor, struct acq_sensor_state *state, int ret,
+                        uint32_t seq)
+{
+    if (ret == 0 || ret == -ETIMEDOUT)
+    {
+        acq_store(sensor, &fields[state->first_field], k_uptime_get(), seq);
+    }
+
+    if (ret == 0 || ret == -ENODATA)
+    {
+        state->failures = 0;
+        return;
+    }
+
+    metrics_counter_inc(&state->fetch_err);
+    if (state->failures < 8)
+    {
+        state->failures++;
+    }
+    state->skip = MIN(BIT(state->failures - 1), ACQ_MAX_BACKOFF_CYCLES);
+    printk("Sensor %s: fetch failed (%d), skipping %u cycle(s)\n", sensor->name, ret,
+           state->skip);
+}
+
+#ifdef CONFIG_AQM_ACQ_WORKERS
+static void acq_run_group(uint8_t group, uint32_t seq)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(sensors); i++)
+    {
+        if (states[i].group != group || !acq_due(&states[i]))
+        {
+            continue;
+        }
+
+        acq_account(&sensors[i], &states[i], acq_fetch(&sensors[i], &states[i]), seq);
+    }
+}
+#endif /* CONFIG_AQM_ACQ_WORKERS */
+
+#ifdef CONFIG_AQM_ACQ_ASYNC
+static int acq_async_start(struct acq_async_group *ag, size_t idx)
+{
+    const struct acq_sensor *sensor = &sensors[idx];
+    uint32_t fetch_start = bench_start();
+    int ret;
+
+    AQM_TRACE("fetch_start", idx, states[idx].attempt);
+    ret = sensor->fetch_async(sensor->dev, &ag->op);
+    bench_stop(BENCH_STAGE_FETCH, fetch_start);
+    if (ret != 0)
+    {
+        AQM_TRACE("fetch_end", idx, ret);
+    }
+
+    return ret;
+}
+
+/* Move a group on to its next due sensor, until one has a read in flight */
+static void acq_async_advance(uint8_t group, uint32_t seq)
+{
+    struct acq_async_group *ag = &async_groups[group];
+
+    while (ag->next < ARRAY_SIZE(sensors))
+    {
+        size_t i = ag->next++;
+        struct acq_sensor_state *state = &states[i];
+        int ret;
+
+        if (state->group != group || !acq_due(state))
+        {
+            continue;
+        }
+
+        if (sensors[i].fetch_async == NULL)
+        {
+            acq_account(&sensors[i], state, acq_fetch(&sensors[i], state), seq);
+            continue;
+        }
+
+        state->attempt = 0;
+        state->fetch_start = k_uptime_get();
+        state->fetch_start_cycles = k_cycle_get_32();
+        ret = acq_async_start(ag, i);
+        if (ret == 0)
+        {
+            ag->pending = i;
+            ag->seq = seq;
+            return;
+        }
+
+        metrics_histogram_record_since(&state->fetch_us, state->fetch_start_cycles);
+        acq_account(&sensors[i], state, ret, seq);
+    }
+}
+
+static void acq_async_complete(uint8_t group, uint32_t seq)
+{
+    struct acq_async_group *ag = &async_groups[group];
+    const struct acq_sensor *sensor = &sensors[ag->pending];
+    struct acq_sensor_state *state = &states[ag->pending];
+    uint32_t finish_start = bench_start();
+    int ret;
+
+    ret = sensor->fetch_finish(sensor->dev, &ag->op);
+    bench_stop(BENCH_STAGE_FETCH, finish_start);
+    AQM_TRACE("fetch_end", ag->pending, ret);
+
+    if (ret != 0 && ret != -ENODATA && state->attempt < CONFIG_AQM_ACQ_RETRIES &&
+        k_uptime_get() - state->fetch_start < sensor->budget_ms)
+    {
+        /* A device holding SDA low after an aborted transfer takes the whole bus with it */
+        if (ret == -EIO)
+        {
+            (void)i2c_recover_bus(sensor->bus);
+        }
+
+        state->attempt++;
+        if (acq_async_start(ag, ag->pending) == 0)
+        {
+            return;
+        }
+    }
+
+    metrics_histogram_record_since(&state->fetch_us, state->fetch_start_cycles);
+    if (ret == 0 && k_uptime_get() - state->fetch_start > sensor->budget_ms)
+    {
+        ret = -ETIMEDOUT;
+    }
+
+    ag->pending = -1;
+    acq_account(sensor, state, ret, seq);
+    acq_async_advance(group, seq);
+}
+
+static bool acq_async_done(struct acq_async_group *ag)
+{
+    unsigned int signaled;
+    int result;
+
+    /* The signal is raised last, once it is set the context may be reused */
+    k_poll_signal_check(&ag->signal, &signaled, &result);
+    return signaled != 0;
+}
+
+static void acq_run_async(int64_t deadline)
+{
+    struct k_poll_event events[ARRAY_SIZE(sensors)];
+    uint32_t seq = cycle_seq;
+
+    for (uint8_t group = 0; group < num_groups; group++)
+    {
+        struct acq_async_group *ag = &async_groups[group];
+
+        if (ag->pending >= 0)
+        {
+            /* A read still in flight from an earlier cycle keeps its bus out of this one */
+            if (!acq_async_done(ag))
+            {
+                continue;
+            }
+
+            /* Its result is too late and was already counted as a failure */
+            ag->pending = -1;
+        }
+
+        ag->next = 0;
+        acq_async_advance(group, seq);
+    }
+
+    while (1)
+    {
+        int num_events = 0;
+
+        for (uint8_t group = 0; group < num_groups; group++)
+        {
+            struct acq_async_group *ag = &async_groups[group];
+
+            if (ag->pending >= 0 && ag->seq == seq)
+            {
+                k_poll_event_init(&events[num_events++], K_POLL_TYPE_SIGNAL,
+                                  K_POLL_MODE_NOTIFY_ONLY, &ag->signal);
+            }
+        }
+
+        if (num_events == 0 ||
+            k_poll(events, num_events, K_MSEC(MAX(deadline - k_uptime_get(), 0))) != 0)
+        {
+            break;
+        }
+
+        for (uint8_t group = 0; group < num_groups; group++)
+        {
+            struct acq_async_group *ag = &async_groups[group];
+
+            if (ag->pending >= 0 && ag->seq == seq && acq_async_done(ag))
+            {
+                acq_async_complete(group, seq);
+            }
+        }
+    }
+
+    for (uint8_t group = 0; group < num_groups; group++)
+    {
+        struct acq_async_group *ag = &async_groups[group];
+
+        if (ag->pending >= 0 && ag->seq == seq)
+        {
+            printk("Bus %u missed the cycle deadline\n", group);
+            acq_account(&sensors[ag->pending], &states[ag->pending], -EBUSY, seq);
+        }
+    }
+}
+#endif /* CONFIG_AQM_ACQ_ASYNC */
+
+void acq_run_cycle(void)
+{
+    k_spinlock_key_t key;
+
+    cycle_start = k_uptime_get();
+
+#ifdef CONFIG_AQM_ACQ_WORKERS
+    acq_run_workers(cycle_start + cycle_budget_ms);
+#else
+    acq_run_async(cycle_start + cycle_budget_ms);
+#endif
+
+    key = k_spin_lock(&fields_lock);
+    cycle_seq++;
+    k_spin_unlock(&fields_lock, key);
+}
+
+size_t acq_bus_count(void)
+{
+    return num_groups;
+}
+
+const struct device *acq_bus(size_t idx)
+{
+    return group_bus[idx];
+}
+
+size_t acq_thread_count(void)
+{
+#ifdef CONFIG_AQM_ACQ_WORKERS
+    return num_workers;
+#else
+    return 0;
+#endif
+}
+
+const struct k_thread *acq_thread(size_t idx)
+{
+#ifdef CONFIG_AQM_ACQ_WORKERS
+    return &workers[idx].thread;
+#else
+    ARG_UNUSED(idx);
+    return NULL;
+#endif
+}
+
+size_t acq_field_count(void)
+{
+    return ACQ_NUM_FIELDS;
+}
+
+const char *acq_field_name(size_t idx)
+{
+    uint8_t sensor = field_sensor[idx];
+
+    return sensors[sensor].channels[idx - states[sensor].first_field].name;
+}
+
+const char *acq_field_unit(size_t idx)
+{
+    uint8_t sensor = field_sensor[idx];
+
+    return sensors[sensor].channels[idx - states[sensor].first_field].unit;
+}
+
+uint8_t acq_field_precision(size_t idx)
+{
+    uint8_t sensor = field_sensor[idx];
+
+    return sensors[sensor].channels[idx - states[sensor].first_field].precision;
+}
+
+void acq_get_field(size_t idx, struct acq_field_sample *out)
+{
+    k_spinlock_key_t key = k_spin_lock(&fields_lock);
+    struct acq_field field = fields[idx];
+    int64_t age_ms;
+
+    k_spin_unlock(&fields_lock, key);
+
+    age_ms = k_uptime_get() - field.timestamp;
+    out->value = field.value;
+    out->age_s = age_ms / MSEC_PER_SEC;
+
+    if (field.timestamp == 0 || out->age_s > CONFIG_AQM_FIELD_MAX_AGE_S)
+    {
+        out->state = ACQ_FIELD_INVALID;
+    }
+    else if (field.timestamp < cycle_start)
+    {
+        out->state = ACQ_FIELD_STALE;
+    }
+    else
+    {
+        out->state = ACQ_FIELD_FRESH;
+    }
+}
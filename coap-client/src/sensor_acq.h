@@ -0,0 +1,98 @@
+#ifndef SENSOR_ACQ_H
+#define SENSOR_ACQ_H
+
+#include <zephyr/drivers/sensor.h>
+
+enum acq_field_state
+{
+    /* Read successfully in the last acquisition cycle */
+    ACQ_FIELD_FRESH,
+    /* Last good value of an earlier cycle, not older than CONFIG_AQM_FIELD_MAX_AGE_S */
+    ACQ_FIELD_STALE,
+    /* Never read, or the last good value is too old to be reported */
+    ACQ_FIELD_INVALID,
+};
+
+struct acq_field_sample
+{
+    struct sensor_value value;
+    enum acq_field_state state;
+    /* Seconds since the value was read */
+    uint32_t age_s;
+};
+
+/**
+ * Check which sensors are ready. Sensors that are not ready are left out of
+ * every cycle, their fields stay invalid.
+ *
+ * @return number of ready sensors
+ */
+int acq_init(void);
+
+/**
+ * Fetch all sensors once. Each sensor gets at most CONFIG_AQM_ACQ_SENSOR_BUDGET_MS
+ * (plus its command duration) and CONFIG_AQM_ACQ_RETRIES retries. A sensor that
+ * fails or overruns its budget is skipped for an exponentially growing number of
+ * cycles, so it cannot stretch the reporting period.
+ *
+ * Controllers are read in parallel and sensors on the same controller one
+ * after the other. With CONFIG_AQM_ACQ_WORKERS this is done by up to
+ * CONFIG_AQM_ACQ_BUS_WORKERS worker threads, one per I2C controller, and the
+ * caller only waits until the sum of the budgets on the busiest worker has
+ * passed. With CONFIG_AQM_ACQ_ASYNC the caller starts the asynchronous reads
+ * itself, fetches the other sensors in between, and waits for the longest
+ * controller plus all synchronous fetches. Fields of a read that misses this
+ * deadline keep their last value and are reported stale or invalid for the
+ * cycle.
+ */
+void acq_run_cycle(void);
+
+/**
+ * Number of distinct I2C controllers with sensors, valid after acq_init().
+ */
+size_t acq_bus_count(void);
+
+/**
+ * I2C controller by index, in the order of the first sensor on each.
+ */
+const struct device *acq_bus(size_t idx);
+
+/**
+ * Number of bus workers, valid after acq_init(). None with
+ * CONFIG_AQM_ACQ_ASYNC, which reads from the calling thread.
+ */
+size_t acq_thread_count(void);
+
+/**
+ * Bus worker thread by index.
+ */
+const struct k_thread *acq_thread(size_t idx);
+
+/**
+ * Number of reported fields. The fields of all okay SCD4x, CCS811 and SPS30
+ * devicetree nodes are numbered in that order, in devicetree instance order
+ * within each compatible.
+ */
+size_t acq_field_count(void);
+
+/**
+ * Name of a field, e.g. "co2" or "pm2_5".
+ */
+const char *acq_field_name(size_t idx);
+
+/**
+ * Unit of a field as a SenML symbol, e.g. "ppm" or "Cel".
+ */
+const char *acq_field_unit(size_t idx);
+
+/**
+ * Number of decimals a field is reported with.
+ */
+uint8_t acq_field_precision(size_t idx);
+
+/**
+ * Get the last value of a field together with its validity and age.
+ */
+void acq_get_field(size_t idx, struct acq_field_sample *out);
+
+#endif /* SENSOR_ACQ_H */
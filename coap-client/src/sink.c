@@ -0,0 +1,542 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/openthread.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/random/random.h>
+#include <openthread/coap.h>
+#include <openthread/link.h>
+#include <openthread/thread.h>
+#ifdef CONFIG_AQM_SINK_SERVICE
+#include <openthread/netdata.h>
+#endif
+
+#include "metrics.h"
+#include "sink.h"
+#include "sink_service.h"
+
+#define SINK_RLOC16_NONE 0xfffe
+#define SINK_COST_UNREACHABLE UINT8_MAX
+/* Sinks set aside at the same time, more than the sinks of a building */
+#define SINK_EXCLUDED_MAX 4
+
+/*
+ * The cache is used by the reporting thread and, on an aggregator, by the
+ * uploads from the OpenThread thread. The callback just marks it stale.
+ */
+static K_MUTEX_DEFINE(sink_lock);
+static otIp6Address sink_addr;
+static uint16_t sink_port;
+static bool sink_valid;
+static int64_t sink_selected_at;
+static atomic_t sink_stale = ATOMIC_INIT(1);
+
+/* Backoff deadline in k_uptime_get_32() milliseconds, valid while sink_backoff is set */
+static atomic_t sink_backoff;
+static atomic_t sink_backoff_until;
+
+/* RFC 7252 5.10.5 */
+#define SINK_DEFAULT_MAX_AGE_S 60
+
+static void sink_state_changed(otChangedFlags flags, struct openthread_context *ot_context,
+                               void *user_data)
+{
+    ARG_UNUSED(ot_context);
+    ARG_UNUSED(user_data);
+
+    if (flags & (OT_CHANGED_THREAD_NETDATA | OT_CHANGED_THREAD_ROLE | OT_CHANGED_THREAD_ML_ADDR))
+    {
+        atomic_set(&sink_stale, 1);
+    }
+}
+
+static struct openthread_state_changed_cb sink_state_cb = {
+    .state_changed_cb = sink_state_changed,
+};
+
+void sink_report_unavailable(const otMessage *rsp)
+{
+    otCoapOptionIterator iter;
+    uint64_t max_age = SINK_DEFAULT_MAX_AGE_S;
+    uint32_t backoff_ms;
+
+    if (otCoapOptionIteratorInit(&iter, rsp) == OT_ERROR_NONE &&
+        otCoapOptionIteratorGetFirstOptionMatching(&iter, OT_COAP_OPTION_MAX_AGE) != NULL)
+    {
+        (void)otCoapOptionIteratorGetOptionUintValue(&iter, &max_age);
+    }
+
+    backoff_ms = MIN(max_age, CONFIG_AQM_BACKOFF_MAX_S) * MSEC_PER_SEC;
+    backoff_ms += sys_rand32_get() % (backoff_ms / 2 + 1);
+
+    atomic_set(&sink_backoff_until, k_uptime_get_32() + backoff_ms);
+    atomic_set(&sink_backoff, 1);
+}
+
+uint32_t sink_backoff_remaining_s(void)
+{
+    int32_t left;
+
+    if (!atomic_get(&sink_backoff))
+    {
+        return 0;
+    }
+
+    left = (int32_t)((uint32_t)atomic_get(&sink_backoff_until) - k_uptime_get_32());
+    if (left <= 0)
+    {
+        atomic_clear(&sink_backoff);
+        return 0;
+    }
+
+    return DIV_ROUND_UP(left, MSEC_PER_SEC);
+}
+
+static __maybe_unused void sink_mesh_local(otInstance *inst, const uint8_t iid[8],
+                                           otIp6Address *addr)
+{
+    memcpy(&addr->mFields.m8[0], otThreadGetMeshLocalPrefix(inst), 8);
+    memcpy(&addr->mFields.m8[8], iid, 8);
+}
+
+static __maybe_unused void sink_set_mesh_local(otInstance *inst, const uint8_t iid[8],
+                                               uint16_t port)
+{
+    sink_mesh_local(inst, iid, &sink_addr);
+    sink_port = port;
+    sink_valid = true;
+}
+
+#ifdef CONFIG_AQM_SINK_SERVICE
+struct sink_candidate
+{
+    uint8_t eui64[8];
+    uint16_t rloc16;
+    uint16_t port;
+    uint8_t cost;
+    uint32_t score;
+    bool aggregator;
+};
+
+METRICS_COUNTER_DEFINE(sink_changes, "sink_changes");
+METRICS_COUNTER_DEFINE(sink_failover, "sink_failover");
+
+/* Current sink, identified by EUI-64 since its RLOC16 follows its role */
+static struct sink_candidate sink_current;
+static bool sink_have_current;
+static uint8_t own_eui64[8];
+
+/* Sink named by the reporting control, all zero for none; under sink_lock */
+static uint8_t sink_hint[8];
+
+/* Reports in a row without an ACK, counted from the CoAP response handler */
+static atomic_t sink_timeouts;
+
+static struct
+{
+    uint8_t eui64[8];
+    int64_t until;
+} sink_excluded[SINK_EXCLUDED_MAX];
+
+void sink_init(void)
+{
+    otExtAddress eui64;
+
+    otLinkGetFactoryAssignedIeeeEui64(openthread_get_default_instance(), &eui64);
+    memcpy(own_eui64, eui64.m8, sizeof(own_eui64));
+
+    metrics_counter_register(&sink_changes);
+    metrics_counter_register(&sink_failover);
+    openthread_state_changed_cb_register(openthread_get_default_context(), &sink_state_cb);
+}
+
+void sink_set_hint(const uint8_t eui64[8])
+{
+    k_mutex_lock(&sink_lock, K_FOREVER);
+    if (memcmp(sink_hint, eui64, sizeof(sink_hint)) != 0)
+    {
+        memcpy(sink_hint, eui64, sizeof(sink_hint));
+        atomic_set(&sink_stale, 1);
+    }
+    k_mutex_unlock(&sink_lock);
+}
+
+void sink_report_result(bool acked)
+{
+    if (acked)
+    {
+        atomic_clear(&sink_timeouts);
+    }
+    else
+    {
+        atomic_inc(&sink_timeouts);
+    }
+}
+
+/*
+ * Rendezvous score of this client with a sink: FNV-1a over both EUI-64s and
+ * the murmur3 finalizer, so that EUI-64s differing in one byte still get
+ * unrelated scores.
+ */
+static uint32_t sink_score(const uint8_t sink_eui64[8])
+{
+    uint32_t h = 2166136261u;
+
+    for (size_t i = 0; i < 16; i++)
+    {
+        h ^= i < 8 ? own_eui64[i] : sink_eui64[i - 8];
+        h *= 16777619u;
+    }
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static bool sink_is_excluded(const uint8_t eui64[8], int64_t now)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(sink_excluded); i++)
+    {
+        if (sink_excluded[i].until > now && memcmp(sink_excluded[i].eui64, eui64, 8) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void sink_exclude(const uint8_t eui64[8], int64_t now)
+{
+    size_t slot = 0;
+
+    /* Take a free slot, else the one that frees soonest */
+    for (size_t i = 1; i < ARRAY_SIZE(sink_excluded); i++)
+    {
+        if (sink_excluded[i].until < sink_excluded[slot].until)
+        {
+            slot = i;
+        }
+    }
+
+    memcpy(sink_excluded[slot].eui64, eui64, 8);
+    sink_excluded[slot].until = now + CONFIG_AQM_SINK_FAILOVER_HOLD_S * MSEC_PER_SEC;
+}
+
+static uint8_t sink_path_cost(otInstance *inst, uint16_t rloc16)
+{
+    uint16_t next_hop = SINK_RLOC16_NONE;
+    uint8_t cost = SINK_COST_UNREACHABLE;
+
+    if (rloc16 == otThreadGetRloc16(inst))
+    {
+        return 0;
+    }
+
+    if (otThreadGetNextHopAndPathCost(inst, rloc16, &next_hop, &cost) != OT_ERROR_NONE ||
+        next_hop == SINK_RLOC16_NONE)
+    {
+        return SINK_COST_UNREACHABLE;
+    }
+
+    return cost;
+}
+
+/*
+ * Order of preference: reachable before unreachable, then the highest score
+ * or the lowest path cost. With nearest selection the current sink wins a
+ * tie, so two equally distant sinks do not take turns.
+ */
+static bool sink_better(const struct sink_candidate *a, const struct sink_candidate *b)
+{
+    bool a_reachable = a->cost != SINK_COST_UNREACHABLE;
+    bool b_reachable = b->cost != SINK_COST_UNREACHABLE;
+
+    if (a_reachable != b_reachable)
+    {
+        return a_reachable;
+    }
+
+#ifdef CONFIG_AQM_SINK_SELECT_HASH
+    return a->score > b->score;
+#else
+    if (a->cost != b->cost)
+    {
+        return a->cost < b->cost;
+    }
+    return sink_have_current && memcmp(a->eui64, sink_current.eui64, 8) == 0;
+#endif
+}
+
+static bool sink_service_is(const otServiceConfig *config, const char *data, size_t len)
+{
+    return config->mEnterpriseNumber == CONFIG_AQM_SINK_ENTERPRISE_NUMBER &&
+           config->mServiceDataLength == len && memcmp(config->mServiceData, data, len) == 0 &&
+           config->mServerConfig.mServerDataLength >= SINK_SERVER_DATA_LEN;
+}
+
+/* The RLOC of a sink, which compresses to two bytes or less under 6LoWPAN */
+static void sink_rloc_iid(uint16_t rloc16, uint8_t iid[8])
+{
+    static const uint8_t rloc_prefix[6] = {0x00, 0x00, 0x00, 0xff, 0xfe, 0x00};
+
+    memcpy(iid, rloc_prefix, sizeof(rloc_prefix));
+    sys_put_be16(rloc16, &iid[6]);
+}
+
+/*
+ * Pick a sink among the announced ones, skipping the sinks set aside after
+ * missing ACKs unless no other is left. The hinted sink is taken whenever it
+ * is announced and not set aside.
+ *
+ * A client that is not an aggregator itself prefers the nearest aggregator
+ * within CONFIG_AQM_AGGREGATOR_MAX_COST, the highest score breaking ties,
+ * unless aggregators is false. Aggregators that missed ACKs are skipped
+ * without exception, the sinks are still there.
+ */
+static bool sink_find_service(otInstance *inst, int64_t now, bool aggregators,
+                              struct sink_candidate *result)
+{
+    otNetworkDataIterator iter = OT_NETWORK_DATA_ITERATOR_INIT;
+    otServiceConfig config;
+    struct sink_candidate best;
+    struct sink_candidate best_excluded;
+    bool found = false;
+    bool found_excluded = false;
+    struct sink_candidate hinted;
+    bool found_hinted = false;
+#if CONFIG_AQM_AGGREGATOR_MAX_COST > 0
+    struct sink_candidate best_aggregator;
+    bool found_aggregator = false;
+#else
+    ARG_UNUSED(aggregators);
+#endif
+
+    while (otNetDataGetNextService(inst, &iter, &config) == OT_ERROR_NONE)
+    {
+        const otServerConfig *server = &config.mServerConfig;
+        struct sink_candidate candidate;
+        bool aggregator = sink_service_is(&config, SINK_AGGREGATOR_SERVICE_DATA,
+                                          SINK_AGGREGATOR_SERVICE_DATA_LEN);
+
+        if (!aggregator && !sink_service_is(&config, SINK_SERVICE_DATA, SINK_SERVICE_DATA_LEN))
+        {
+            continue;
+        }
+
+        memcpy(candidate.eui64, &server->mServerData[SINK_SERVER_DATA_EUI64], 8);
+        candidate.rloc16 = server->mRloc16;
+        candidate.port = sys_get_be16(&server->mServerData[SINK_SERVER_DATA_PORT]);
+        candidate.cost = sink_path_cost(inst, server->mRloc16);
+        candidate.score = sink_score(candidate.eui64);
+        candidate.aggregator = aggregator;
+
+        if (aggregator)
+        {
+#if CONFIG_AQM_AGGREGATOR_MAX_COST > 0
+            if (aggregators && candidate.cost <= CONFIG_AQM_AGGREGATOR_MAX_COST &&
+                !sink_is_excluded(candidate.eui64, now) &&
+                (!found_aggregator || candidate.cost < best_aggregator.cost ||
+                 (candidate.cost == best_aggregator.cost &&
+                  candidate.score > best_aggregator.score)))
+            {
+                best_aggregator = candidate;
+                found_aggregator = true;
+            }
+#endif
+            continue;
+        }
+
+        if (memcmp(candidate.eui64, sink_hint, 8) == 0 && !sink_is_excluded(candidate.eui64, now))
+        {
+            hinted = candidate;
+            found_hinted = true;
+        }
+
+        if (sink_is_excluded(candidate.eui64, now))
+        {
+            if (!found_excluded || sink_better(&candidate, &best_excluded))
+            {
+                best_excluded = candidate;
+                found_excluded = true;
+            }
+        }
+        else if (!found || sink_better(&candidate, &best))
+        {
+            best = candidate;
+            found = true;
+        }
+    }
+
+#if CONFIG_AQM_AGGREGATOR_MAX_COST > 0
+    if (found_aggregator)
+    {
+        best = best_aggregator;
+        found = true;
+    }
+#endif
+
+    if (found_hinted)
+    {
+        best = hinted;
+        found = true;
+    }
+
+    if (!found)
+    {
+        if (!found_excluded)
+        {
+            return false;
+        }
+        best = best_excluded;
+    }
+
+    *result = best;
+    return true;
+}
+
+static bool sink_select_service(otInstance *inst, int64_t now)
+{
+    struct sink_candidate best;
+    uint8_t rloc_iid[8];
+
+    if (!sink_find_service(inst, now, true, &best))
+    {
+        return false;
+    }
+
+    sink_rloc_iid(best.rloc16, rloc_iid);
+    sink_set_mesh_local(inst, rloc_iid, best.port);
+
+    if (!sink_have_current || memcmp(best.eui64, sink_current.eui64, 8) != 0)
+    {
+        atomic_clear(&sink_timeouts);
+        metrics_counter_inc(&sink_changes);
+        printk("Sink %02x%02x%02x%02x%02x%02x%02x%02x (0x%04x), path cost %u\n", best.eui64[0],
+               best.eui64[1], best.eui64[2], best.eui64[3], best.eui64[4], best.eui64[5],
+               best.eui64[6], best.eui64[7], best.rloc16, best.cost);
+    }
+    sink_current = best;
+    sink_have_current = true;
+
+    return true;
+}
+
+/*
+ * Set the current sink aside once it missed enough ACKs in a row. Reports
+ * still in flight to it may time out after the switch and count against the
+ * new sink; they are at most the ones of one ACK timeout.
+ */
+static bool sink_check_failover(int64_t now)
+{
+    if (!sink_have_current || atomic_get(&sink_timeouts) < CONFIG_AQM_SINK_FAILOVER_TIMEOUTS)
+    {
+        return false;
+    }
+
+    atomic_clear(&sink_timeouts);
+    sink_exclude(sink_current.eui64, now);
+    metrics_counter_inc(&sink_failover);
+    printk("Sink 0x%04x not acknowledging, failing over\n", sink_current.rloc16);
+    return true;
+}
+#else
+void sink_init(void)
+{
+    openthread_state_changed_cb_register(openthread_get_default_context(), &sink_state_cb);
+}
+
+void sink_set_hint(const uint8_t eui64[8])
+{
+    ARG_UNUSED(eui64);
+}
+
+void sink_report_result(bool acked)
+{
+    ARG_UNUSED(acked);
+}
+#endif /* CONFIG_AQM_SINK_SERVICE */
+
+static void sink_select(otInstance *inst, int64_t now)
+{
+    sink_valid = false;
+
+#ifdef CONFIG_AQM_SINK_SERVICE
+    if (sink_select_service(inst, now))
+    {
+        return;
+    }
+
+    if (sink_have_current)
+    {
+        printk("Sink service gone\n");
+        sink_have_current = false;
+    }
+#else
+    ARG_UNUSED(now);
+#endif
+
+#ifdef CONFIG_AQM_SINK_FIXED_ADDR
+    static const uint8_t fixed_iid[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+    sink_set_mesh_local(inst, fixed_iid, OT_DEFAULT_COAP_PORT);
+#endif
+}
+
+bool sink_get(otInstance *inst, otIp6Address *addr, uint16_t *port)
+{
+    int64_t now = k_uptime_get();
+    bool reselect = atomic_cas(&sink_stale, 1, 0);
+    bool valid;
+
+    k_mutex_lock(&sink_lock, K_FOREVER);
+
+#ifdef CONFIG_AQM_SINK_SERVICE
+    reselect |= sink_check_failover(now);
+    reselect |= now - sink_selected_at >= CONFIG_AQM_SINK_REVALIDATE_S * MSEC_PER_SEC;
+#endif
+
+    if (reselect)
+    {
+        sink_select(inst, now);
+        sink_selected_at = now;
+    }
+
+    valid = sink_valid;
+    if (valid)
+    {
+        *addr = sink_addr;
+        *port = sink_port;
+    }
+
+    k_mutex_unlock(&sink_lock);
+    return valid;
+}
+
+bool sink_get_direct(otInstance *inst, otIp6Address *addr, uint16_t *port)
+{
+    if (!sink_get(inst, addr, port))
+    {
+        return false;
+    }
+
+#if CONFIG_AQM_AGGREGATOR_MAX_COST > 0
+    struct sink_candidate direct;
+    uint8_t rloc_iid[8];
+
+    k_mutex_lock(&sink_lock, K_FOREVER);
+    if (sink_have_current && sink_current.aggregator &&
+        sink_find_service(inst, k_uptime_get(), false, &direct))
+    {
+        sink_rloc_iid(direct.rloc16, rloc_iid);
+        sink_mesh_local(inst, rloc_iid, addr);
+        *port = direct.port;
+    }
+    k_mutex_unlock(&sink_lock);
+#endif
+
+    return true;
+}
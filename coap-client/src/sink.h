@@ -0,0 +1,88 @@
+#ifndef SINK_H
+#define SINK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <openthread/coap.h>
+#include <openthread/instance.h>
+#include <openthread/ip6.h>
+#include <openthread/message.h>
+
+/**
+ * Follow the OpenThread state changes that can move the sink. Call once,
+ * after OpenThread is started.
+ */
+void sink_init(void);
+
+/**
+ * Address and CoAP port of the sink to report to.
+ *
+ * With CONFIG_AQM_SINK_SERVICE the sink is one of the Network Data servers of
+ * the /storedata service:
+ * - with CONFIG_AQM_SINK_SELECT_HASH, the one with the highest rendezvous
+ *   hash of this node's and the sink's EUI-64;
+ * - with CONFIG_AQM_SINK_SELECT_NEAREST, the one with the lowest path cost.
+ * Sinks set aside after missing ACKs are skipped while others are left. The
+ * sink is addressed by its RLOC, which compresses to two bytes or less under
+ * 6LoWPAN.
+ *
+ * The choice is cached. It is made again after a Network Data, role or
+ * mesh-local address change, after a failover, or after
+ * CONFIG_AQM_SINK_REVALIDATE_S.
+ *
+ * While no sink is announced, or without discovery, this is the mesh-local
+ * ::1 address if CONFIG_AQM_SINK_FIXED_ADDR is set.
+ *
+ * @return false if there is no sink to report to
+ */
+bool sink_get(otInstance *inst, otIp6Address *addr, uint16_t *port);
+
+/**
+ * Like sink_get(), but past an aggregator: while the reports go to an
+ * aggregator, this is the sink that sink_get() would take without
+ * aggregators. An aggregator acknowledges a request itself and holds its
+ * payload until the next upload, which is too late and too lossy for an
+ * alarm. Falls back to the aggregator while no sink is announced.
+ *
+ * @return false if there is no sink to report to
+ */
+bool sink_get_direct(otInstance *inst, otIp6Address *addr, uint16_t *port);
+
+/**
+ * Prefer the sink with this EUI-64 whenever it is announced and not set
+ * aside, as asked by the reporting control. All zero clears the hint. Safe to
+ * call from the OpenThread thread.
+ */
+void sink_set_hint(const uint8_t eui64[8]);
+
+/**
+ * Record whether a report was acknowledged. After
+ * CONFIG_AQM_SINK_FAILOVER_TIMEOUTS reports in a row without an ACK, the next
+ * sink_get() sets the sink aside for CONFIG_AQM_SINK_FAILOVER_HOLD_S and picks
+ * another. Safe to call from the OpenThread thread.
+ */
+void sink_report_result(bool acked);
+
+/**
+ * Whether a response has a 2.xx code. Error responses such as 5.03 or 4.12
+ * did not deliver the request and count as not acknowledged.
+ */
+static inline bool sink_response_ok(const otMessage *rsp)
+{
+    return (otCoapMessageGetCode(rsp) >> 5) == 2;
+}
+
+/**
+ * Hold off after a 5.03 Service Unavailable response: for its Max-Age, 60 s
+ * without one, capped at CONFIG_AQM_BACKOFF_MAX_S, plus up to half of that
+ * again as random jitter so clients refused together do not return
+ * together. Safe to call from the OpenThread thread.
+ */
+void sink_report_unavailable(const otMessage *rsp);
+
+/**
+ * Seconds left of the current backoff, rounded up, 0 when reports may go out.
+ */
+uint32_t sink_backoff_remaining_s(void);
+
+#endif /* SINK_H */
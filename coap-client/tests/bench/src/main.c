@@ -0,0 +1,128 @@
+/*
+ * The benchmark of the application's cycle on the emulated SCD41 and SPS30:
+ * acquisition and record encoding timed per stage through bench.c, with the
+ * BENCH lines printed as by the application. The send stage needs OpenThread
+ * and is reported as "na" here. The suite checks that every cycle reads all
+ * fields, moves bytes on the sensor bus and encodes a record, and that the
+ * stacks of the acquisition threads are measured.
+ */
+
+#include <string.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/ztest.h>
+
+#include "bench.h"
+#include "record.h"
+#include "sensor_acq.h"
+
+/* One SCD41 measurement period plus a margin, so every cycle has new data */
+#define CYCLE_MS 5100
+
+/* A whole 802.15.4 frame, far more than a record of the two sensors */
+#define MAX_PAYLOAD_LEN 127
+
+struct buf_writer {
+	struct record_writer base;
+	char buf[MAX_PAYLOAD_LEN + 1];
+};
+
+static int buf_write(struct record_writer *writer, const char *data, size_t len)
+{
+	struct buf_writer *bw = CONTAINER_OF(writer, struct buf_writer, base);
+
+	if (writer->len + len >= sizeof(bw->buf)) {
+		return -ENOMEM;
+	}
+	memcpy(&bw->buf[writer->len], data, len + 1);
+
+	return 0;
+}
+
+static uint32_t i2c_msgs(void)
+{
+	uint32_t msgs = 0;
+
+	for (size_t i = 0; i < acq_bus_count(); i++) {
+		const struct device *bus = acq_bus(i);
+		struct i2c_device_state *state =
+			CONTAINER_OF(bus->state, struct i2c_device_state, devstate);
+
+		msgs += state->stats.message_count;
+	}
+
+	return msgs;
+}
+
+static void assert_fresh(void)
+{
+	struct acq_field_sample sample;
+
+	for (size_t i = 0; i < acq_field_count(); i++) {
+		acq_get_field(i, &sample);
+		zassert_equal(sample.state, ACQ_FIELD_FRESH, "%s: state %d", acq_field_name(i),
+			      sample.state);
+	}
+}
+
+static void assert_stack(const struct k_thread *thread)
+{
+	size_t unused;
+
+	zassert_ok(k_thread_stack_space_get(thread, &unused));
+	zassert_true(unused > 0 && unused < thread->stack_info.size, "unused %zu of %zu", unused,
+		     thread->stack_info.size);
+}
+
+ZTEST(bench, test_bench_cycles)
+{
+	struct buf_writer writer = {.base.write = buf_write};
+	uint32_t stage_start;
+	uint32_t msgs;
+
+	bench_init();
+
+	for (int i = 0; i < CONFIG_AQM_BENCH_ITERATIONS; i++) {
+		k_msleep(CYCLE_MS);
+
+		msgs = i2c_msgs();
+		stage_start = bench_start();
+		acq_run_cycle();
+		bench_stop(BENCH_STAGE_ACQ, stage_start);
+		zassert_true(i2c_msgs() > msgs);
+		assert_fresh();
+
+		writer.base.len = 0;
+		stage_start = bench_start();
+		zassert_ok(record_encode(&writer.base));
+		bench_stop(BENCH_STAGE_FORMAT, stage_start);
+		zassert_true(writer.base.len > 0);
+
+		bench_end_iteration(writer.base.len);
+	}
+}
+
+ZTEST(bench, test_bench_stacks)
+{
+	assert_stack(k_current_get());
+
+	for (size_t i = 0; i < acq_thread_count(); i++) {
+		assert_stack(acq_thread(i));
+	}
+
+#ifdef CONFIG_AQM_ACQ_WORKERS
+	zassert_equal(acq_thread_count(), MIN(acq_bus_count(), CONFIG_AQM_ACQ_BUS_WORKERS));
+#else
+	zassert_equal(acq_thread_count(), 0);
+	assert_stack(&k_sys_work_q.thread);
+#endif
+}
+
+static void *bench_setup(void)
+{
+	zassert_equal(acq_init(), 2);
+
+	return NULL;
+}
+
+ZTEST_SUITE(bench, NULL, bench_setup, NULL, NULL, NULL);
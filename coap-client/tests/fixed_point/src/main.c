@@ -0,0 +1,167 @@
+/*
+ * Fixed point SCD4x and SPS30 conversions against the datasheet formulas in
+ * double precision. Only runs on native_sim, where double is cheap.
+ */
+
+#include <float.h>
+#include <string.h>
+#include <zephyr/ztest.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "scd4x.h"
+#include "sensirion_common.h"
+
+#define ABS(x) ((x) < 0 ? -(x) : (x))
+
+/* Rounded to the nearest millionth, plus the error of the Q16 span constant */
+#define SCD4X_MAX_ERR 1e-6
+
+/* The Q40 inverse is 9e-10 short, below 1e-4 LSB at the top of the range */
+#define SCD4X_OFFSET_MAX_ERR (0.5 + 1e-4)
+
+/* Truncated to millionths */
+#define SPS30_MAX_ERR 1e-6
+
+/* Step through the floats from 0 to 1000 ug/m3, the SPS30 measurement range */
+#define SPS30_RANGE_STEP 97
+
+#define SPS30_RANDOM_MANTISSAS 8192
+
+static uint32_t lcg_next(uint32_t *state)
+{
+	/* Numerical Recipes LCG, as in <sensirion/emul.h> */
+	*state = *state * 1664525U + 1013904223U;
+	return *state;
+}
+
+static double scd4x_max_err(int32_t min_micro, uint64_t span_q16, int32_t min, int32_t span)
+{
+	double max_err = 0;
+
+	for (uint32_t raw = 0; raw <= UINT16_MAX; raw++) {
+		struct sensor_value val;
+		double ref = min + span * (double)raw / UINT16_MAX;
+		double err;
+
+		scd4x_micro_to_sensor_value(min_micro + scd4x_raw_to_micro(raw, span_q16), &val);
+		zassert_true((val.val1 >= 0 && val.val2 >= 0) || (val.val1 <= 0 && val.val2 <= 0),
+			     "raw %u: parts %d and %d differ in sign", raw, val.val1, val.val2);
+		zassert_true(ABS(val.val2) < 1000000, "raw %u: val2 %d", raw, val.val2);
+
+		err = ABS(sensor_value_to_double(&val) - ref);
+		max_err = MAX(max_err, err);
+	}
+
+	return max_err;
+}
+
+ZTEST(fixed_point, test_scd4x_temperature)
+{
+	double max_err = scd4x_max_err(SCD4X_MIN_TEMP * 1000000, SCD4X_TEMP_SPAN_MICRO_Q16,
+				       SCD4X_MIN_TEMP, SCD4X_MAX_TEMP);
+
+	TC_PRINT("temperature: max error %.9f degC\n", max_err);
+	zassert_true(max_err <= SCD4X_MAX_ERR, "max error %.9f degC", max_err);
+}
+
+ZTEST(fixed_point, test_scd4x_humidity)
+{
+	double max_err = scd4x_max_err(0, SCD4X_HUMI_SPAN_MICRO_Q16, 0, 100);
+
+	TC_PRINT("humidity: max error %.9f %%RH\n", max_err);
+	zassert_true(max_err <= SCD4X_MAX_ERR, "max error %.9f %%RH", max_err);
+}
+
+ZTEST(fixed_point, test_scd4x_temperature_offset)
+{
+	/* offset * 65535 / 175, rounded, over the whole offset range */
+	for (int64_t micro = 0; micro <= SCD4X_MAX_TEMP * 1000000LL; micro += 1009) {
+		double ref = (double)micro * UINT16_MAX / (SCD4X_MAX_TEMP * 1e6);
+		uint16_t raw = scd4x_micro_to_temp_raw(micro);
+
+		zassert_true(ABS(raw - ref) <= SCD4X_OFFSET_MAX_ERR, "offset %lld: raw %u, expected %.6f",
+			     (long long)micro, raw, ref);
+	}
+
+	/* Reading an offset back and writing it again keeps the raw word */
+	for (uint32_t raw = 0; raw <= UINT16_MAX; raw++) {
+		int32_t micro = scd4x_raw_to_micro(raw, SCD4X_TEMP_SPAN_MICRO_Q16);
+
+		zassert_equal(scd4x_micro_to_temp_raw(micro), raw, "raw %u", raw);
+	}
+
+	zassert_equal(scd4x_micro_to_temp_raw(-1), 0);
+	zassert_equal(scd4x_micro_to_temp_raw(200 * 1000000LL), UINT16_MAX);
+}
+
+static void sps30_check(uint32_t bits, double *max_err)
+{
+	uint8_t bytes[4];
+	int32_t integer;
+	int32_t micro;
+	double ref;
+	double err;
+	float value;
+
+	sys_put_be32(bits, bytes);
+	memcpy(&value, &bits, sizeof(value));
+	sensirion_bytes_to_fixed(bytes, &integer, &micro);
+
+	if (value != value || ABS(value) < FLT_MIN) {
+		/* NaN, zero and subnormals */
+		zassert_true(integer == 0 && micro == 0, "0x%08x: %d.%06d", bits, integer, micro);
+		return;
+	}
+
+	ref = value;
+	if (ABS(ref) >= 2147483648.0) {
+		zassert_equal(integer, ref > 0 ? INT32_MAX : -INT32_MAX, "0x%08x: %d", bits,
+			      integer);
+		zassert_equal(micro, 0, "0x%08x: micro %d", bits, micro);
+		return;
+	}
+
+	/* Both parts truncated toward zero with the sign of the value */
+	zassert_equal(integer, (int32_t)ref, "0x%08x: integer %d", bits, integer);
+	zassert_true(ref > 0 ? micro >= 0 : micro <= 0, "0x%08x: micro %d", bits, micro);
+
+	err = ABS(integer + micro / 1e6 - ref);
+	zassert_true(err < SPS30_MAX_ERR, "0x%08x: error %.9f", bits, err);
+	*max_err = MAX(*max_err, err);
+}
+
+ZTEST(fixed_point, test_sps30_measurement_range)
+{
+	const float range_max = 1000.0f;
+	uint32_t range_max_bits;
+	double max_err = 0;
+
+	memcpy(&range_max_bits, &range_max, sizeof(range_max_bits));
+	for (uint32_t bits = 0; bits <= range_max_bits; bits += SPS30_RANGE_STEP) {
+		sps30_check(bits, &max_err);
+	}
+	sps30_check(range_max_bits, &max_err);
+
+	TC_PRINT("0..1000: max error %.9f\n", max_err);
+}
+
+ZTEST(fixed_point, test_sps30_all_exponents)
+{
+	uint32_t state = 1;
+	double max_err = 0;
+
+	for (uint32_t exponent = 0; exponent <= 0xff; exponent++) {
+		for (uint32_t i = 0; i < SPS30_RANDOM_MANTISSAS; i++) {
+			/* The extremes first, then random mantissas */
+			uint32_t mantissa = i == 0 ? 0 : i == 1 ? 0x7fffff : lcg_next(&state) >> 9;
+			uint32_t bits = exponent << 23 | mantissa;
+
+			sps30_check(bits, &max_err);
+			sps30_check(bits | BIT(31), &max_err);
+		}
+	}
+
+	TC_PRINT("all exponents: max error %.9f\n", max_err);
+}
+
+ZTEST_SUITE(fixed_point, NULL, NULL, NULL, NULL, NULL);
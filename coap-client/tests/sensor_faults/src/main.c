@@ -0,0 +1,308 @@
+/*
+ * Faults injected into the emulated SCD41 and SPS30. The drivers have to
+ * report NACKs, CRC errors and a stuck bus, and acquisition has to retry,
+ * report the fields of a failing sensor stale and then invalid while the
+ * other sensor stays fresh, and pick the sensor up again once the fault is
+ * cleared. The synthetic signals and the SPS30 status register are checked
+ * end to end as well.
+ */
+
+#include <string.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/ztest.h>
+#include <sensirion/emul.h>
+#include <sensirion/scd4x.h>
+
+#include "sensor_acq.h"
+#include "sps30.h"
+
+/* One SCD41 measurement period plus a margin, so every cycle has new data */
+#define CYCLE_MS 5100
+
+/* Cycles until CONFIG_AQM_FIELD_MAX_AGE_S has passed */
+#define INVALID_CYCLES DIV_ROUND_UP(CONFIG_AQM_FIELD_MAX_AGE_S * MSEC_PER_SEC, CYCLE_MS)
+
+/* The backoff cap of sensor_acq.c plus the cycle of the next attempt */
+#define MAX_RECOVERY_CYCLES 33
+
+/* The SCD4x temperature and humidity words resolve about 0.003 degC and %RH */
+#define SCD41_MAX_ERR_MICRO 10000
+
+/* pm10 is 1.18 * pm2_5 in single precision */
+#define SPS30_MAX_ERR_MICRO 1000
+
+static const struct device *const scd41_dev = DEVICE_DT_GET(DT_NODELABEL(scd41));
+static const struct device *const sps30_dev = DEVICE_DT_GET(DT_NODELABEL(sps30));
+static const struct emul *const scd41_emul = EMUL_DT_GET(DT_NODELABEL(scd41));
+static const struct emul *const sps30_emul = EMUL_DT_GET(DT_NODELABEL(sps30));
+static const struct i2c_dt_spec sps30_bus = I2C_DT_SPEC_GET(DT_NODELABEL(sps30));
+
+static const char *const scd41_fields[] = {"co2", "temp", "humi"};
+static const char *const sps30_fields[] = {"pm2_5", "pm10"};
+
+static void clear_faults(void)
+{
+	scd4x_emul_set_fault(scd41_emul, SENSIRION_EMUL_FAULT_NONE, 0);
+	sps30_emul_set_fault(sps30_emul, SENSIRION_EMUL_FAULT_NONE, 0);
+}
+
+static enum acq_field_state field_state(const char *name)
+{
+	struct acq_field_sample sample;
+
+	for (size_t i = 0; i < acq_field_count(); i++) {
+		if (strcmp(acq_field_name(i), name) == 0) {
+			acq_get_field(i, &sample);
+			return sample.state;
+		}
+	}
+
+	zassert_unreachable("no field %s", name);
+	return ACQ_FIELD_INVALID;
+}
+
+static int64_t field_micro(const char *name)
+{
+	struct acq_field_sample sample;
+
+	for (size_t i = 0; i < acq_field_count(); i++) {
+		if (strcmp(acq_field_name(i), name) == 0) {
+			acq_get_field(i, &sample);
+			return sample.value.val1 * 1000000LL + sample.value.val2;
+		}
+	}
+
+	zassert_unreachable("no field %s", name);
+	return 0;
+}
+
+static void assert_field_near(const char *name, int64_t micro, int64_t max_err)
+{
+	int64_t value = field_micro(name);
+
+	zassert_true(value >= micro - max_err && value <= micro + max_err,
+		     "%s: %lld, expected %lld", name, (long long)value, (long long)micro);
+}
+
+static void assert_fields(const char *const *names, size_t num, enum acq_field_state state)
+{
+	for (size_t i = 0; i < num; i++) {
+		zassert_equal(field_state(names[i]), state, "%s: state %d, expected %d", names[i],
+			      field_state(names[i]), state);
+	}
+}
+
+static bool all_fresh(void)
+{
+	for (size_t i = 0; i < acq_field_count(); i++) {
+		struct acq_field_sample sample;
+
+		acq_get_field(i, &sample);
+		if (sample.state != ACQ_FIELD_FRESH) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void run_cycle(void)
+{
+	k_msleep(CYCLE_MS);
+	acq_run_cycle();
+}
+
+/* Clear the faults and run cycles until the backoff has run out and all fields are fresh */
+static void recover(void)
+{
+	clear_faults();
+
+	for (int i = 0; i < MAX_RECOVERY_CYCLES; i++) {
+		run_cycle();
+		if (all_fresh()) {
+			return;
+		}
+	}
+
+	zassert_unreachable("not recovered after %d cycles", MAX_RECOVERY_CYCLES);
+}
+
+ZTEST(sensor_faults, test_scd41_nack)
+{
+	k_msleep(CYCLE_MS);
+	scd4x_emul_set_fault(scd41_emul, SENSIRION_EMUL_FAULT_NACK, 0);
+	zassert_equal(sensor_sample_fetch(scd41_dev), -EIO);
+
+	clear_faults();
+	zassert_ok(sensor_sample_fetch(scd41_dev));
+}
+
+ZTEST(sensor_faults, test_scd41_crc)
+{
+	k_msleep(CYCLE_MS);
+	scd4x_emul_set_fault(scd41_emul, SENSIRION_EMUL_FAULT_CRC, 1);
+	zassert_equal(sensor_sample_fetch(scd41_dev), -EIO);
+
+	/* The corrupted data-ready word did not consume the measurement */
+	zassert_ok(sensor_sample_fetch(scd41_dev));
+}
+
+ZTEST(sensor_faults, test_sps30_nack)
+{
+	sps30_emul_set_fault(sps30_emul, SENSIRION_EMUL_FAULT_NACK, 0);
+	zassert_equal(sensor_sample_fetch(sps30_dev), -EIO);
+
+	clear_faults();
+	zassert_ok(sensor_sample_fetch(sps30_dev));
+}
+
+ZTEST(sensor_faults, test_sps30_crc)
+{
+	sps30_emul_set_fault(sps30_emul, SENSIRION_EMUL_FAULT_CRC, 1);
+	zassert_true(sensor_sample_fetch(sps30_dev) < 0);
+	zassert_ok(sensor_sample_fetch(sps30_dev));
+}
+
+ZTEST(sensor_faults, test_sps30_stuck_bus)
+{
+	sps30_emul_set_fault(sps30_emul, SENSIRION_EMUL_FAULT_STUCK_BUS, 0);
+	for (int i = 0; i < 3; i++) {
+		zassert_equal(sensor_sample_fetch(sps30_dev), -EIO);
+	}
+
+	clear_faults();
+	zassert_ok(sensor_sample_fetch(sps30_dev));
+}
+
+ZTEST(sensor_faults, test_acq_retry)
+{
+	recover();
+
+	/* One failed transfer each, the retry within the cycle succeeds */
+	scd4x_emul_set_fault(scd41_emul, SENSIRION_EMUL_FAULT_NACK, 1);
+	sps30_emul_set_fault(sps30_emul, SENSIRION_EMUL_FAULT_NACK, 1);
+	run_cycle();
+	zassert_true(all_fresh());
+
+	scd4x_emul_set_fault(scd41_emul, SENSIRION_EMUL_FAULT_CRC, 1);
+	sps30_emul_set_fault(sps30_emul, SENSIRION_EMUL_FAULT_CRC, 1);
+	run_cycle();
+	zassert_true(all_fresh());
+}
+
+ZTEST(sensor_faults, test_acq_sps30_crc)
+{
+	recover();
+
+	sps30_emul_set_fault(sps30_emul, SENSIRION_EMUL_FAULT_CRC, 0);
+	run_cycle();
+	assert_fields(sps30_fields, ARRAY_SIZE(sps30_fields), ACQ_FIELD_STALE);
+	assert_fields(scd41_fields, ARRAY_SIZE(scd41_fields), ACQ_FIELD_FRESH);
+
+	recover();
+}
+
+ZTEST(sensor_faults, test_acq_sps30_stuck_bus)
+{
+	recover();
+
+	sps30_emul_set_fault(sps30_emul, SENSIRION_EMUL_FAULT_STUCK_BUS, 0);
+	run_cycle();
+	assert_fields(sps30_fields, ARRAY_SIZE(sps30_fields), ACQ_FIELD_STALE);
+
+	for (int i = 1; i < INVALID_CYCLES; i++) {
+		run_cycle();
+	}
+	assert_fields(sps30_fields, ARRAY_SIZE(sps30_fields), ACQ_FIELD_INVALID);
+	assert_fields(scd41_fields, ARRAY_SIZE(scd41_fields), ACQ_FIELD_FRESH);
+
+	recover();
+}
+
+ZTEST(sensor_faults, test_acq_scd41_stuck_bus)
+{
+	recover();
+
+	scd4x_emul_set_fault(scd41_emul, SENSIRION_EMUL_FAULT_STUCK_BUS, 0);
+	run_cycle();
+	assert_fields(scd41_fields, ARRAY_SIZE(scd41_fields), ACQ_FIELD_STALE);
+
+	for (int i = 1; i < INVALID_CYCLES; i++) {
+		run_cycle();
+	}
+	assert_fields(scd41_fields, ARRAY_SIZE(scd41_fields), ACQ_FIELD_INVALID);
+	assert_fields(sps30_fields, ARRAY_SIZE(sps30_fields), ACQ_FIELD_FRESH);
+
+	recover();
+}
+
+ZTEST(sensor_faults, test_acq_signals)
+{
+	const struct sensirion_emul_signal co2 = {.base = 800000};
+	const struct sensirion_emul_signal temp = {.base = 21500};
+	const struct sensirion_emul_signal humi = {.base = 45000};
+	const struct sensirion_emul_signal pm2_5 = {.base = 12000};
+
+	recover();
+
+	zassert_ok(scd4x_emul_set_signal(scd41_emul, SENSOR_CHAN_CO2_SCD, &co2));
+	zassert_ok(scd4x_emul_set_signal(scd41_emul, SENSOR_CHAN_AMBIENT_TEMP, &temp));
+	zassert_ok(scd4x_emul_set_signal(scd41_emul, SENSOR_CHAN_HUMIDITY, &humi));
+	zassert_equal(scd4x_emul_set_signal(scd41_emul, SENSOR_CHAN_PM_2_5, &co2), -EINVAL);
+	sps30_emul_set_signal(sps30_emul, &pm2_5);
+	run_cycle();
+
+	zassert_true(all_fresh());
+	assert_field_near("co2", 800000000LL, 0);
+	assert_field_near("temp", 21500000LL, SCD41_MAX_ERR_MICRO);
+	assert_field_near("humi", 45000000LL, SCD41_MAX_ERR_MICRO);
+	assert_field_near("pm2_5", 12000000LL, 0);
+	assert_field_near("pm10", 14160000LL, SPS30_MAX_ERR_MICRO);
+}
+
+ZTEST(sensor_faults, test_sps30_status)
+{
+	uint32_t flags;
+
+	sps30_emul_set_status(sps30_emul, SPS30_DEVICE_STATUS_FAN_ERROR_MASK);
+	zassert_ok(sps30_read_device_status_register(&sps30_bus, &flags));
+	zassert_equal(flags, SPS30_DEVICE_STATUS_FAN_ERROR_MASK);
+
+#ifdef CONFIG_SENSIRION_I2C_ASYNC
+	struct sensirion_i2c_async op;
+	struct k_poll_signal signal;
+	struct k_poll_event event =
+		K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &signal);
+
+	k_poll_signal_init(&signal);
+	sensirion_i2c_async_init(&op, &signal, NULL, NULL);
+	sps30_emul_set_status(sps30_emul, 0);
+	zassert_ok(sps30_read_device_status_register_async(&sps30_bus, &op));
+	zassert_equal(sps30_read_device_status_register_async(&sps30_bus, &op), -EBUSY);
+	zassert_ok(k_poll(&event, 1, K_SECONDS(1)));
+	zassert_ok(sps30_read_device_status_register_finish(&op, &flags));
+	zassert_equal(flags, 0);
+#endif
+
+	sps30_emul_set_status(sps30_emul, 0);
+}
+
+static void *sensor_faults_setup(void)
+{
+	zassert_true(device_is_ready(scd41_dev));
+	zassert_true(device_is_ready(sps30_dev));
+	zassert_equal(acq_init(), 2);
+
+	return NULL;
+}
+
+static void sensor_faults_after(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	clear_faults();
+}
+
+ZTEST_SUITE(sensor_faults, NULL, sensor_faults_setup, NULL, sensor_faults_after, NULL);
@@ -0,0 +1,179 @@
+/*
+ * Central reporting control, see control.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+#include <openthread/coap.h>
+#include <openthread/message.h>
+
+#include "control.h"
+#include "control_option.h"
+
+LOG_MODULE_DECLARE(coap_srv, CONFIG_LOG_DEFAULT_LEVEL);
+
+#define CONTROL_TEXT_LEN 96
+
+/* Option value as sent, only touched from the OpenThread thread */
+static uint8_t control[CONTROL_SINK_LEN];
+static uint8_t control_len;
+
+otError control_append(otMessage *rsp)
+{
+	if (control_len == 0) {
+		return OT_ERROR_NONE;
+	}
+
+	return otCoapMessageAppendOption(rsp, CONTROL_OPTION, control_len, control);
+}
+
+static bool control_parse_uint(const char *value, unsigned long max, unsigned long *out)
+{
+	char *end;
+
+	*out = strtoul(value, &end, 10);
+	return end != value && *end == '\0' && *out <= max;
+}
+
+/* Parse a PUT payload into a new option value, see control.h */
+static bool control_parse(char *text, uint8_t *value, uint8_t *len)
+{
+	char *save;
+	unsigned long n;
+
+	memset(value, 0, CONTROL_SINK_LEN);
+	*len = CONTROL_LEN;
+
+	for (char *tok = strtok_r(text, " ,\r\n", &save); tok;
+	     tok = strtok_r(NULL, " ,\r\n", &save)) {
+		char *arg = strchr(tok, '=');
+
+		if (!arg) {
+			return false;
+		}
+		*arg++ = '\0';
+
+		if (strcmp(tok, "interval_s") == 0 && control_parse_uint(arg, UINT16_MAX, &n)) {
+			sys_put_be16(n, &value[CONTROL_INTERVAL_S]);
+		} else if (strcmp(tok, "batch") == 0 && control_parse_uint(arg, UINT8_MAX, &n)) {
+			value[CONTROL_BATCH] = n;
+		} else if (strcmp(tok, "con_every") == 0 &&
+			   control_parse_uint(arg, UINT8_MAX, &n)) {
+			value[CONTROL_CON_EVERY] = n;
+		} else if (strcmp(tok, "sink") == 0 && strcmp(arg, "none") == 0) {
+			*len = CONTROL_SINK_LEN;
+		} else if (strcmp(tok, "sink") == 0 && strlen(arg) == 16 &&
+			   hex2bin(arg, 16, &value[CONTROL_SINK], 8) == 8) {
+			*len = CONTROL_SINK_LEN;
+		} else {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static size_t control_format(char *buf, size_t size)
+{
+	static const uint8_t no_sink[8];
+	char sink[17] = "none";
+	int len;
+
+	len = snprintf(buf, size, "interval_s=%u batch=%u con_every=%u",
+		       sys_get_be16(&control[CONTROL_INTERVAL_S]), control[CONTROL_BATCH],
+		       control[CONTROL_CON_EVERY]);
+
+	if (control_len == CONTROL_SINK_LEN) {
+		if (memcmp(&control[CONTROL_SINK], no_sink, sizeof(no_sink)) != 0) {
+			bin2hex(&control[CONTROL_SINK], 8, sink, sizeof(sink));
+		}
+		len += snprintf(&buf[len], size - len, " sink=%s", sink);
+	}
+
+	return MIN(len, size - 1);
+}
+
+static void control_coap_cb(void *context, otMessage *msg, const otMessageInfo *msg_info)
+{
+	otInstance *inst = context;
+	otCoapCode code = otCoapMessageGetCode(msg);
+	char text[CONTROL_TEXT_LEN];
+	uint8_t value[CONTROL_SINK_LEN];
+	uint8_t len;
+	otMessage *rsp;
+	otCoapCode rsp_code;
+	otError err;
+
+	if (code == OT_COAP_CODE_PUT) {
+		uint16_t offset = otMessageGetOffset(msg);
+		uint16_t text_len = otMessageGetLength(msg) - offset;
+
+		if (text_len >= sizeof(text)) {
+			rsp_code = OT_COAP_CODE_REQUEST_TOO_LARGE;
+		} else {
+			otMessageRead(msg, offset, text, text_len);
+			text[text_len] = '\0';
+			rsp_code = control_parse(text, value, &len) ? OT_COAP_CODE_CHANGED
+								    : OT_COAP_CODE_BAD_REQUEST;
+		}
+
+		if (rsp_code == OT_COAP_CODE_CHANGED) {
+			memcpy(control, value, sizeof(control));
+			control_len = len;
+			control_format(text, sizeof(text));
+			LOG_INF("Reporting control %s", text);
+		}
+	} else if (code == OT_COAP_CODE_GET) {
+		rsp_code = OT_COAP_CODE_CONTENT;
+	} else {
+		return;
+	}
+
+	if (otCoapMessageGetType(msg) != OT_COAP_TYPE_CONFIRMABLE && code == OT_COAP_CODE_PUT) {
+		return;
+	}
+
+	rsp = otCoapNewMessage(inst, NULL);
+	if (!rsp) {
+		return;
+	}
+
+	err = otCoapMessageInitResponse(rsp, msg,
+					otCoapMessageGetType(msg) == OT_COAP_TYPE_CONFIRMABLE
+						? OT_COAP_TYPE_ACKNOWLEDGMENT
+						: OT_COAP_TYPE_NON_CONFIRMABLE,
+					rsp_code);
+	if (err == OT_ERROR_NONE && rsp_code == OT_COAP_CODE_CONTENT) {
+		err = otCoapMessageAppendContentFormatOption(rsp,
+							     OT_COAP_OPTION_CONTENT_FORMAT_TEXT_PLAIN);
+		if (err == OT_ERROR_NONE) {
+			err = otCoapMessageSetPayloadMarker(rsp);
+		}
+		if (err == OT_ERROR_NONE) {
+			err = otMessageAppend(rsp, text, control_format(text, sizeof(text)));
+		}
+	}
+	if (err == OT_ERROR_NONE) {
+		err = otCoapSendResponse(inst, rsp, msg_info);
+	}
+
+	if (err != OT_ERROR_NONE) {
+		otMessageFree(rsp);
+	}
+}
+
+void control_coap_init(otInstance *instance)
+{
+	static otCoapResource res = {
+		.mUriPath = "control",
+		.mHandler = control_coap_cb,
+	};
+
+	res.mContext = instance;
+	otCoapAddResource(instance, &res);
+}
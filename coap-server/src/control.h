@@ -0,0 +1,32 @@
+/*
+ * Central reporting control, see control_option.h.
+ *
+ * The operator sets the reporting parameters with a PUT to /control, and
+ * every response to /storedata carries them to the clients from then on.
+ */
+
+#ifndef CONTROL_H_
+#define CONTROL_H_
+
+#include <openthread/instance.h>
+#include <openthread/message.h>
+
+/**
+ * @brief Append the control option to a /storedata response.
+ *
+ * Nothing is appended before the first PUT to /control. Append it after all
+ * options with a lower number.
+ */
+otError control_append(otMessage *rsp);
+
+/**
+ * @brief Serve GET and PUT /control as text/plain. CoAP must be started.
+ *
+ * The payload is "interval_s=<s> batch=<n> con_every=<n> sink=<eui64>".
+ * A PUT replaces the whole control; keys left out are 0, which lets the
+ * clients fall back to their own configuration. "sink=none" clears the
+ * clients' sink hint, leaving sink out keeps it.
+ */
+void control_coap_init(otInstance *instance);
+
+#endif /* CONTROL_H_ */
@@ -1,11 +1,16 @@
 /*
  * Simple CoAP “/storedata” server.
- * Listens for PUTs on coap://[fdde:ad00:beef::1]/storedata
- * ACKs with 2.04 Changed and logs the payload.
+ * Announces itself as a sink in the Thread Network Data and listens for PUTs
+ * on coap://[<RLOC>]/storedata, or on coap://[fdde:ad00:beef::1]/storedata.
+ * ACKs with 2.04 Changed, carrying the reporting control set on /control,
+ * and logs the payload. Block-wise uploads are logged block by block, compact
+ * records are decoded with the schema their client registered on /schema.
  */
 
+#include <string.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
 LOG_MODULE_REGISTER(coap_srv, CONFIG_LOG_DEFAULT_LEVEL);
 
 #include <zephyr/net/openthread.h>
@@ -13,11 +18,39 @@ LOG_MODULE_REGISTER(coap_srv, CONFIG_LOG_DEFAULT_LEVEL);
 #include <openthread/thread.h>
 #include <openthread/ip6.h>
 #include <openthread/coap.h>
+#ifdef CONFIG_AQM_SINK_SERVICE
+#include <openthread/link.h>
+#include <openthread/server.h>
+#endif
+
+#include "aqm_trace.h"
+#include "coap_block.h"
+#ifdef CONFIG_AQM_CONTROL
+#include "control.h"
+#endif
+#include "members.h"
+#include "metrics.h"
+#include "ot_monitor.h"
+#ifdef CONFIG_AQM_SCHEMA
+#include "schema.h"
+#include "schema_wire.h"
+#endif
+#include "sink_service.h"
 
 #define TEXT_BUF_SZ 256
 static char text_buf[TEXT_BUF_SZ];
 static size_t text_len;
 
+METRICS_COUNTER_DEFINE(storedata_con, "storedata_con");
+METRICS_COUNTER_DEFINE(storedata_non, "storedata_non");
+METRICS_COUNTER_DEFINE(storedata_reply_err, "storedata_reply_err");
+METRICS_COUNTER_DEFINE(storedata_shed, "storedata_shed");
+METRICS_COUNTER_DEFINE(storedata_unavailable, "storedata_unavailable");
+METRICS_COUNTER_DEFINE(storedata_incomplete, "storedata_incomplete");
+METRICS_HISTOGRAM_DEFINE(storedata_cb_us, "storedata_cb_us", METRICS_BOUNDS_US);
+METRICS_HISTOGRAM_DEFINE(storedata_payload, "storedata_payload", 32, 64, 96, 128, 160, 192, 255);
+
+#ifdef CONFIG_AQM_SINK_FIXED_ADDR
 /* Add ::0001 mesh-local address so clients can reach us */
 static void add_meshlocal_routing_id_addr(void)
 {
@@ -38,47 +71,317 @@ static void add_meshlocal_routing_id_addr(void)
 		LOG_ERR("Add unicast addr failed (%d)", err);
 	}
 }
+#endif
+
+#ifdef CONFIG_AQM_SINK_SERVICE
+/*
+ * Announce /storedata in the Network Data. The entry is stable and OpenThread
+ * keeps it registered with the leader across role and RLOC16 changes.
+ */
+static void sink_service_register(void)
+{
+	otInstance *inst = openthread_get_default_instance();
+	otServiceConfig config = { 0 };
+	otExtAddress eui64;
+	otError err;
+
+	config.mEnterpriseNumber = CONFIG_AQM_SINK_ENTERPRISE_NUMBER;
+	config.mServiceDataLength = SINK_SERVICE_DATA_LEN;
+	memcpy(config.mServiceData, SINK_SERVICE_DATA, SINK_SERVICE_DATA_LEN);
+	config.mServerConfig.mStable = true;
+	config.mServerConfig.mServerDataLength = SINK_SERVER_DATA_LEN;
+	sys_put_be16(OT_DEFAULT_COAP_PORT,
+		     &config.mServerConfig.mServerData[SINK_SERVER_DATA_PORT]);
+	otLinkGetFactoryAssignedIeeeEui64(inst, &eui64);
+	memcpy(&config.mServerConfig.mServerData[SINK_SERVER_DATA_EUI64], eui64.m8, 8);
+
+	err = otServerAddService(inst, &config);
+	if (err == OT_ERROR_NONE) {
+		err = otServerRegister(inst);
+	}
+
+	if (err != OT_ERROR_NONE) {
+		LOG_ERR("Sink service registration failed (%d)", err);
+		return;
+	}
+
+	LOG_INF("Sink service registered");
+}
+#endif
 
-static void storedata_reply(const otMessage *req, const otMessageInfo *req_info)
+/*
+ * max_age is only sent with a non-zero value, as the Max-Age option in seconds.
+ * block1 is echoed to acknowledge a block of an upload, NULL otherwise.
+ */
+static void storedata_reply(const otMessage *req, const otMessageInfo *req_info, otCoapCode code,
+			    uint32_t max_age, const struct coap_block *block1)
 {
 	otInstance *inst = openthread_get_default_instance();
 	otMessage *rsp = otCoapNewMessage(inst, NULL);
 
 	if (!rsp) {
+		metrics_counter_inc(&storedata_reply_err);
+		ot_monitor_alloc_failed();
 		LOG_ERR("No mem for CoAP ACK");
 		return;
 	}
 
 	otError err = otCoapMessageInitResponse(rsp, req,
 		OT_COAP_TYPE_ACKNOWLEDGMENT,
-		OT_COAP_CODE_CHANGED);
+		code);
+	if (err == OT_ERROR_NONE && max_age > 0) {
+		err = otCoapMessageAppendMaxAgeOption(rsp, max_age);
+	}
+	if (err == OT_ERROR_NONE && block1) {
+		err = otCoapMessageAppendBlock1Option(rsp, block1->num, block1->more, block1->szx);
+	}
+#ifdef CONFIG_AQM_CONTROL
+	if (err == OT_ERROR_NONE) {
+		err = control_append(rsp);
+	}
+#endif
 	if (err == OT_ERROR_NONE) {
 		err = otCoapSendResponse(inst, rsp, req_info);
 	}
 
 	if (err != OT_ERROR_NONE) {
 		otMessageFree(rsp);
+		metrics_counter_inc(&storedata_reply_err);
 		LOG_ERR("Send CoAP ACK failed (%d)", err);
 	}
 }
 
+#ifdef CONFIG_AQM_ADMISSION
+/*
+ * Admission control for CON requests, checked on every request since the
+ * monitor only samples once per period. A request is refused while message
+ * buffers are short or while the 6LoWPAN send queue is too deep for the radio
+ * to drain. The returned Max-Age tells the client how long to hold off; a
+ * buffer shortage gets twice the time, it takes longer to clear.
+ *
+ * @return 0 to admit, else the Max-Age of the 5.03 response in seconds
+ */
+static uint32_t storedata_admit(void)
+{
+	otBufferInfo info;
+
+	otMessageGetBufferInfo(openthread_get_default_instance(), &info);
+
+	if (ot_monitor_backpressure() ||
+	    info.mFreeBuffers < CONFIG_AQM_OT_MONITOR_LOW_WATERMARK) {
+		return 2 * CONFIG_AQM_ADMISSION_MAX_AGE_S;
+	}
+
+	if (info.m6loSendQueue.mNumMessages >= CONFIG_AQM_ADMISSION_MAX_SEND_QUEUE) {
+		return CONFIG_AQM_ADMISSION_MAX_AGE_S;
+	}
+
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_AQM_BLOCKWISE
+/* MAX_TRANSMIT_WAIT of RFC 7252, the sender has given up on a block by then */
+#define STOREDATA_STREAM_TIMEOUT_MS (93 * MSEC_PER_SEC)
+
+/*
+ * Block1 uploads in progress, one per sender. Blocks are logged as they
+ * arrive, only the position in the upload is kept, so an upload is not
+ * limited in size. A free entry has next 0.
+ */
+struct storedata_stream {
+	otIp6Address addr;
+	uint16_t port;
+	uint32_t next;
+	int64_t last_ms;
+};
+
+/* Only touched from the OpenThread thread, by storedata_cb */
+static struct storedata_stream streams[CONFIG_AQM_BLOCK_STREAMS];
+
+static struct storedata_stream *storedata_stream_find(const otMessageInfo *info, int64_t now)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(streams); i++) {
+		if (streams[i].next > 0 && now - streams[i].last_ms <= STOREDATA_STREAM_TIMEOUT_MS &&
+		    streams[i].port == info->mPeerPort &&
+		    memcmp(&streams[i].addr, &info->mPeerAddr, sizeof(streams[i].addr)) == 0) {
+			return &streams[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* A free or timed out entry, else the one heard from least recently */
+static struct storedata_stream *storedata_stream_alloc(int64_t now)
+{
+	struct storedata_stream *slot = &streams[0];
+
+	for (size_t i = 0; i < ARRAY_SIZE(streams); i++) {
+		if (streams[i].next == 0 ||
+		    now - streams[i].last_ms > STOREDATA_STREAM_TIMEOUT_MS) {
+			return &streams[i];
+		}
+		if (streams[i].last_ms < slot->last_ms) {
+			slot = &streams[i];
+		}
+	}
+
+	return slot;
+}
+
+/*
+ * Follow the sender through its upload. Block 0 starts it again, any other
+ * block has to be the next one; a lost 2.31 Continue makes the sender repeat
+ * the previous block, which is acknowledged again but not logged twice. That
+ * holds for block 0 too: while block 1 is expected, block 0 is the repeat, as
+ * a sender only starts a new upload once the last one ended or timed out.
+ *
+ * @return 1 to log the block, 0 to only acknowledge it, -1 if it does not
+ *	   continue an upload of this sender
+ */
+static int storedata_stream_advance(const otMessageInfo *info, const struct coap_block *block)
+{
+	int64_t now = k_uptime_get();
+	struct storedata_stream *stream = storedata_stream_find(info, now);
+
+	if (block->num == 0) {
+		if (stream && stream->next == 1) {
+			stream->last_ms = now;
+			return 0;
+		}
+		if (!stream) {
+			stream = storedata_stream_alloc(now);
+			stream->addr = info->mPeerAddr;
+			stream->port = info->mPeerPort;
+		}
+		stream->next = 0;
+	} else if (!stream) {
+		return -1;
+	} else if (block->num + 1 == stream->next) {
+		stream->last_ms = now;
+		return 0;
+	} else if (block->num != stream->next) {
+		stream->next = 0;
+		return -1;
+	}
+
+	stream->next = block->more ? block->num + 1 : 0;
+	stream->last_ms = now;
+	return 1;
+}
+#endif /* CONFIG_AQM_BLOCKWISE */
+
 static void storedata_cb(void *context, otMessage *msg, const otMessageInfo *msg_info)
 {
 	ARG_UNUSED(context);
 
+	uint32_t start = k_cycle_get_32();
+#ifdef CONFIG_AQM_BLOCKWISE
+	struct coap_block block1;
+#endif
+	struct coap_block *blockwise = NULL;
+	bool store = true;
+	bool known = true;
+
 	if (otCoapMessageGetCode(msg) != OT_COAP_CODE_PUT) {
 		return;
 	}
 
-	text_len = otMessageRead(msg, otMessageGetOffset(msg), text_buf, TEXT_BUF_SZ - 1);
-	text_buf[text_len] = '\0';
+	/* Full payload length, the copy below is truncated to the buffer */
+	uint16_t payload_len = otMessageGetLength(msg) - otMessageGetOffset(msg);
 
-	// LOG_INF("PUT /storedata : \"%s\"", text_buf);
-	printk("%s", text_buf);
+	AQM_TRACE("storedata_start", payload_len, otCoapMessageGetType(msg));
+	metrics_histogram_record(&storedata_payload, payload_len);
 
+	/*
+	 * Shed NON requests while buffers are short: nobody retransmits them and
+	 * they are not answered. CON requests are always answered, with a 5.03 if
+	 * they are not admitted, so the clients back off instead of adding
+	 * retransmissions to the congestion.
+	 */
+	if (otCoapMessageGetType(msg) != OT_COAP_TYPE_CONFIRMABLE && ot_monitor_backpressure()) {
+		metrics_counter_inc(&storedata_shed);
+		AQM_TRACE("storedata_end", payload_len, 1);
+		return;
+	}
+
+#ifdef CONFIG_AQM_ADMISSION
 	if (otCoapMessageGetType(msg) == OT_COAP_TYPE_CONFIRMABLE) {
-		storedata_reply(msg, msg_info);
+		uint32_t max_age = storedata_admit();
+
+		if (max_age > 0) {
+			metrics_counter_inc(&storedata_unavailable);
+			storedata_reply(msg, msg_info, OT_COAP_CODE_SERVICE_UNAVAILABLE, max_age,
+					NULL);
+			AQM_TRACE("storedata_end", payload_len, 2);
+			return;
+		}
+	}
+#endif
+
+#ifdef CONFIG_AQM_BLOCKWISE
+	if (coap_block_get(msg, OT_COAP_OPTION_BLOCK1, &block1)) {
+		int ret = storedata_stream_advance(msg_info, &block1);
+
+		if (ret < 0) {
+			metrics_counter_inc(&storedata_incomplete);
+			storedata_reply(msg, msg_info, OT_COAP_CODE_REQUEST_INCOMPLETE, 0, NULL);
+			AQM_TRACE("storedata_end", payload_len, 3);
+			return;
+		}
+
+		blockwise = &block1;
+		store = ret > 0;
 	}
+#endif
+
+	/* An upload in blocks counts once, with its last block */
+	if (store && !(blockwise && blockwise->more)) {
+		members_seen(&msg_info->mPeerAddr);
+	}
+
+	/* Aggregated uploads can be longer than the buffer, print them in pieces */
+	for (uint16_t offset = otMessageGetOffset(msg); store && offset < otMessageGetLength(msg);
+	     offset += text_len) {
+		text_len = otMessageRead(msg, offset, text_buf, TEXT_BUF_SZ - 1);
+#ifdef CONFIG_AQM_SCHEMA
+		/* Compact records are decoded, the text between them is logged as it is */
+		if (SCHEMA_IS_ID(text_buf[0])) {
+			text_len = schema_print_record(msg, offset, &known);
+			continue;
+		}
+		for (size_t i = 1; i < text_len; i++) {
+			if (SCHEMA_IS_ID(text_buf[i])) {
+				text_len = i;
+				break;
+			}
+		}
+#endif
+		text_buf[text_len] = '\0';
+
+		// LOG_INF("PUT /storedata : \"%s\"", text_buf);
+		printk("%s", text_buf);
+	}
+
+	if (otCoapMessageGetType(msg) == OT_COAP_TYPE_CONFIRMABLE) {
+		otCoapCode code = OT_COAP_CODE_CHANGED;
+
+		if (blockwise && blockwise->more) {
+			code = OT_COAP_CODE_CONTINUE;
+		} else if (!known) {
+			/* The client registers its schema again */
+			code = OT_COAP_CODE_PRECONDITION_FAILED;
+		}
+
+		metrics_counter_inc(&storedata_con);
+		storedata_reply(msg, msg_info, code, 0, blockwise);
+	} else {
+		metrics_counter_inc(&storedata_non);
+	}
+
+	metrics_histogram_record_since(&storedata_cb_us, start);
+	AQM_TRACE("storedata_end", payload_len, 0);
 }
 
 static void coap_init(void)
@@ -100,6 +403,26 @@ static void coap_init(void)
 
 	otCoapAddResource(inst, &res);
 	LOG_INF("CoAP resource \"/storedata\" registered");
+
+	metrics_counter_register(&storedata_con);
+	metrics_counter_register(&storedata_non);
+	metrics_counter_register(&storedata_reply_err);
+	metrics_counter_register(&storedata_shed);
+	metrics_counter_register(&storedata_unavailable);
+	metrics_counter_register(&storedata_incomplete);
+	metrics_histogram_register(&storedata_cb_us);
+	metrics_histogram_register(&storedata_payload);
+#ifdef CONFIG_AQM_METRICS_COAP
+	metrics_coap_init(inst);
+#endif
+	members_coap_init(inst);
+#ifdef CONFIG_AQM_CONTROL
+	control_coap_init(inst);
+#endif
+#ifdef CONFIG_AQM_SCHEMA
+	schema_coap_init(inst);
+#endif
+	ot_monitor_init();
 }
 
 int main(void)
@@ -112,8 +435,13 @@ int main(void)
 		k_sleep(K_MSEC(100));
 	}
 
+#ifdef CONFIG_AQM_SINK_FIXED_ADDR
 	add_meshlocal_routing_id_addr();
+#endif
 	coap_init();
+#ifdef CONFIG_AQM_SINK_SERVICE
+	sink_service_register();
+#endif
 
 	while (true) {
 		k_sleep(K_SECONDS(1));
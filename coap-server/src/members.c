@@ -0,0 +1,166 @@
+/*
+ * Sink membership, see members.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <openthread/coap.h>
+#include <openthread/link.h>
+#include <openthread/message.h>
+#include <openthread/thread.h>
+#ifdef CONFIG_AQM_SINK_SERVICE
+#include <openthread/netdata.h>
+#endif
+
+#include "members.h"
+#include "sink_service.h"
+
+/* Whole lines only, the rest is cut so the response fits one IPv6 packet */
+#define MEMBERS_MAX_PAYLOAD 1024
+#define MEMBERS_LINE_LEN (8 + OT_IP6_ADDRESS_STRING_SIZE + 40)
+
+struct member {
+	otIp6Address addr;
+	uint32_t records;
+	int64_t last_seen;
+};
+
+/* Only touched from the OpenThread thread, by storedata_cb and the GET handler */
+static struct member members[CONFIG_AQM_SINK_MAX_MEMBERS];
+static size_t num_members;
+
+void members_seen(const otIp6Address *client)
+{
+	struct member *slot = NULL;
+	int64_t now = k_uptime_get();
+
+	for (size_t i = 0; i < num_members; i++) {
+		if (memcmp(&members[i].addr, client, sizeof(*client)) == 0) {
+			members[i].records++;
+			members[i].last_seen = now;
+			return;
+		}
+		if (!slot || members[i].last_seen < slot->last_seen) {
+			slot = &members[i];
+		}
+	}
+
+	if (num_members < ARRAY_SIZE(members)) {
+		slot = &members[num_members++];
+	}
+
+	slot->addr = *client;
+	slot->records = 1;
+	slot->last_seen = now;
+}
+
+struct members_rsp {
+	otMessage *msg;
+	size_t len;
+	bool full;
+};
+
+static void members_append(struct members_rsp *rsp, const char *line)
+{
+	size_t line_len = strlen(line);
+
+	if (rsp->full || rsp->len + line_len > MEMBERS_MAX_PAYLOAD ||
+	    otMessageAppend(rsp->msg, line, line_len) != OT_ERROR_NONE) {
+		rsp->full = true;
+		return;
+	}
+
+	rsp->len += line_len;
+}
+
+#ifdef CONFIG_AQM_SINK_SERVICE
+static void members_append_sinks(otInstance *inst, struct members_rsp *rsp)
+{
+	otNetworkDataIterator iter = OT_NETWORK_DATA_ITERATOR_INIT;
+	otServiceConfig config;
+	char line[MEMBERS_LINE_LEN];
+	uint16_t own_rloc16 = otThreadGetRloc16(inst);
+
+	while (otNetDataGetNextService(inst, &iter, &config) == OT_ERROR_NONE) {
+		const otServerConfig *server = &config.mServerConfig;
+		const uint8_t *eui64 = &server->mServerData[SINK_SERVER_DATA_EUI64];
+
+		if (config.mEnterpriseNumber != CONFIG_AQM_SINK_ENTERPRISE_NUMBER ||
+		    config.mServiceDataLength != SINK_SERVICE_DATA_LEN ||
+		    memcmp(config.mServiceData, SINK_SERVICE_DATA, SINK_SERVICE_DATA_LEN) != 0 ||
+		    server->mServerDataLength < SINK_SERVER_DATA_LEN) {
+			continue;
+		}
+
+		snprintf(line, sizeof(line),
+			 "sink %02x%02x%02x%02x%02x%02x%02x%02x rloc16=0x%04x port=%u%s\n",
+			 eui64[0], eui64[1], eui64[2], eui64[3], eui64[4], eui64[5], eui64[6],
+			 eui64[7], server->mRloc16,
+			 sys_get_be16(&server->mServerData[SINK_SERVER_DATA_PORT]),
+			 server->mRloc16 == own_rloc16 ? " self" : "");
+		members_append(rsp, line);
+	}
+}
+#endif
+
+static void members_coap_cb(void *context, otMessage *msg, const otMessageInfo *msg_info)
+{
+	otInstance *inst = context;
+	struct members_rsp rsp = { 0 };
+	char addr[OT_IP6_ADDRESS_STRING_SIZE];
+	char line[MEMBERS_LINE_LEN];
+	int64_t now = k_uptime_get();
+	otError err;
+
+	if (otCoapMessageGetCode(msg) != OT_COAP_CODE_GET) {
+		return;
+	}
+
+	rsp.msg = otCoapNewMessage(inst, NULL);
+	if (!rsp.msg) {
+		return;
+	}
+
+	err = otCoapMessageInitResponse(rsp.msg, msg,
+					otCoapMessageGetType(msg) == OT_COAP_TYPE_CONFIRMABLE
+						? OT_COAP_TYPE_ACKNOWLEDGMENT
+						: OT_COAP_TYPE_NON_CONFIRMABLE,
+					OT_COAP_CODE_CONTENT);
+	if (err == OT_ERROR_NONE) {
+		err = otCoapMessageAppendContentFormatOption(rsp.msg,
+							     OT_COAP_OPTION_CONTENT_FORMAT_TEXT_PLAIN);
+	}
+	if (err == OT_ERROR_NONE) {
+		err = otCoapMessageSetPayloadMarker(rsp.msg);
+	}
+	if (err == OT_ERROR_NONE) {
+#ifdef CONFIG_AQM_SINK_SERVICE
+		members_append_sinks(inst, &rsp);
+#endif
+		for (size_t i = 0; i < num_members; i++) {
+			otIp6AddressToString(&members[i].addr, addr, sizeof(addr));
+			snprintf(line, sizeof(line), "client %s records=%u age_s=%u\n", addr,
+				 members[i].records,
+				 (uint32_t)((now - members[i].last_seen) / MSEC_PER_SEC));
+			members_append(&rsp, line);
+		}
+		err = otCoapSendResponse(inst, rsp.msg, msg_info);
+	}
+
+	if (err != OT_ERROR_NONE) {
+		otMessageFree(rsp.msg);
+	}
+}
+
+void members_coap_init(otInstance *instance)
+{
+	static otCoapResource res = {
+		.mUriPath = "members",
+		.mHandler = members_coap_cb,
+	};
+
+	res.mContext = instance;
+	otCoapAddResource(instance, &res);
+}
@@ -0,0 +1,30 @@
+/*
+ * Sink membership: the sinks of the partition and the clients reporting here.
+ *
+ * With several sinks every client reports to one of them, so the records of a
+ * building are spread over the sinks' logs. GET /members tells the host which
+ * sinks exist and which clients each one receives from, so the streams can be
+ * merged and a client that failed over is not taken for a new one.
+ */
+
+#ifndef MEMBERS_H_
+#define MEMBERS_H_
+
+#include <openthread/instance.h>
+#include <openthread/ip6.h>
+
+/**
+ * @brief Note a report from a client. Call from the OpenThread thread.
+ */
+void members_seen(const otIp6Address *client);
+
+/**
+ * @brief Serve GET /members as text/plain. CoAP must be started.
+ *
+ * One line per announced sink,
+ * "sink <eui64> rloc16=<rloc16> port=<port>[ self]", then one per client,
+ * "client <address> records=<count> age_s=<seconds since the last report>".
+ */
+void members_coap_init(otInstance *instance);
+
+#endif /* MEMBERS_H_ */
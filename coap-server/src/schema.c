@@ -0,0 +1,314 @@
+/*
+ * Schema registry of the sink, see schema.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+#include <openthread/coap.h>
+#include <openthread/message.h>
+
+#include "metrics.h"
+#include "ot_monitor.h"
+#include "schema.h"
+#include "schema_wire.h"
+
+LOG_MODULE_DECLARE(coap_srv, CONFIG_LOG_DEFAULT_LEVEL);
+
+/* "<id> ", ahead of the layout in a registration */
+#define SCHEMA_ID_TEXT_LEN 3
+/* Bytes logged per line of a raw record */
+#define SCHEMA_RAW_CHUNK 32
+
+struct schema_field {
+	/* Name within the layout, not NUL-terminated */
+	uint8_t name;
+	uint8_t name_len;
+	uint8_t precision;
+};
+
+struct schema {
+	/* 0 for a free entry */
+	uint8_t id;
+	uint8_t num_fields;
+	int64_t last_used;
+	char layout[SCHEMA_LAYOUT_MAX + 1];
+	struct schema_field fields[SCHEMA_MAX_FIELDS];
+};
+
+struct schema_value {
+	int32_t value;
+	uint32_t age_s;
+	bool present;
+	bool stale;
+};
+
+METRICS_COUNTER_DEFINE(schema_records, "schema_records");
+METRICS_COUNTER_DEFINE(schema_unknown, "schema_unknown");
+
+static const uint32_t schema_pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+/* Only touched from the OpenThread thread, by storedata_cb and the PUT handler */
+static struct schema schemas[CONFIG_AQM_SCHEMA_MAX];
+static struct schema_value values[SCHEMA_MAX_FIELDS];
+
+/* Split the layout into its "name:unit:decimals" fields */
+static bool schema_parse(struct schema *schema)
+{
+	const char *layout = schema->layout;
+	size_t len = strlen(layout);
+	size_t pos = 0;
+
+	schema->num_fields = 0;
+	if (len == 0 || layout[len - 1] == ',') {
+		return false;
+	}
+
+	while (pos < len) {
+		const char *end = memchr(&layout[pos], ',', len - pos);
+		size_t field_len = (end ? end - layout : len) - pos;
+		const char *colon = memchr(&layout[pos], ':', field_len);
+		char decimals = layout[pos + field_len - 1];
+
+		/* Name, unit separator and ":<decimals>" at the end */
+		if (schema->num_fields == SCHEMA_MAX_FIELDS || field_len < 4 || !colon ||
+		    colon == &layout[pos] || colon == &layout[pos + field_len - 2] ||
+		    layout[pos + field_len - 2] != ':' || decimals < '0' ||
+		    decimals >= '0' + ARRAY_SIZE(schema_pow10)) {
+			return false;
+		}
+
+		schema->fields[schema->num_fields].name = pos;
+		schema->fields[schema->num_fields].name_len = colon - &layout[pos];
+		schema->fields[schema->num_fields].precision = decimals - '0';
+		schema->num_fields++;
+		pos += field_len + 1;
+	}
+
+	return true;
+}
+
+static struct schema *schema_find(uint8_t id)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(schemas); i++) {
+		if (schemas[i].id == id) {
+			return &schemas[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Take a registration "<id> <layout>" */
+static otCoapCode schema_register(const otMessage *msg)
+{
+	/* Too large for the OpenThread thread's stack */
+	static struct schema candidate;
+	uint16_t offset = otMessageGetOffset(msg);
+	uint16_t len = otMessageGetLength(msg) - offset;
+	char id_text[SCHEMA_ID_TEXT_LEN];
+	struct schema *slot = NULL;
+	uint8_t id;
+
+	if (len > SCHEMA_ID_TEXT_LEN + SCHEMA_LAYOUT_MAX) {
+		return OT_COAP_CODE_REQUEST_TOO_LARGE;
+	}
+	if (len <= SCHEMA_ID_TEXT_LEN) {
+		return OT_COAP_CODE_BAD_REQUEST;
+	}
+
+	otMessageRead(msg, offset, id_text, SCHEMA_ID_TEXT_LEN);
+	if (id_text[2] != ' ' || hex2bin(id_text, 2, &id, 1) != 1 || !SCHEMA_IS_ID(id)) {
+		return OT_COAP_CODE_BAD_REQUEST;
+	}
+
+	len -= SCHEMA_ID_TEXT_LEN;
+	otMessageRead(msg, offset + SCHEMA_ID_TEXT_LEN, candidate.layout, len);
+	candidate.layout[len] = '\0';
+	if (!schema_parse(&candidate)) {
+		return OT_COAP_CODE_BAD_REQUEST;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(schemas); i++) {
+		if (schemas[i].id == id) {
+			if (strcmp(schemas[i].layout, candidate.layout) != 0) {
+				LOG_WRN("Schema %02x registered with another layout", id);
+				return OT_COAP_CODE_FORBIDDEN;
+			}
+			schemas[i].last_used = k_uptime_get();
+			return OT_COAP_CODE_CHANGED;
+		}
+		/* Free entries were never used, they go first */
+		if (!slot || schemas[i].last_used < slot->last_used) {
+			slot = &schemas[i];
+		}
+	}
+
+	*slot = candidate;
+	slot->id = id;
+	slot->last_used = k_uptime_get();
+	printk("<SCHEMA %02x>%s</SCHEMA>\n", id, slot->layout);
+
+	return OT_COAP_CODE_CHANGED;
+}
+
+static void schema_coap_cb(void *context, otMessage *msg, const otMessageInfo *msg_info)
+{
+	otInstance *inst = context;
+	otCoapCode rsp_code;
+	otMessage *rsp;
+
+	if (otCoapMessageGetCode(msg) != OT_COAP_CODE_PUT) {
+		return;
+	}
+
+	rsp_code = schema_register(msg);
+	if (otCoapMessageGetType(msg) != OT_COAP_TYPE_CONFIRMABLE) {
+		return;
+	}
+
+	rsp = otCoapNewMessage(inst, NULL);
+	if (!rsp) {
+		ot_monitor_alloc_failed();
+		return;
+	}
+
+	if (otCoapMessageInitResponse(rsp, msg, OT_COAP_TYPE_ACKNOWLEDGMENT, rsp_code) !=
+		    OT_ERROR_NONE ||
+	    otCoapSendResponse(inst, rsp, msg_info) != OT_ERROR_NONE) {
+		otMessageFree(rsp);
+	}
+}
+
+void schema_coap_init(otInstance *instance)
+{
+	static otCoapResource res = {
+		.mUriPath = SCHEMA_URI,
+		.mHandler = schema_coap_cb,
+	};
+
+	metrics_counter_register(&schema_records);
+	metrics_counter_register(&schema_unknown);
+
+	res.mContext = instance;
+	otCoapAddResource(instance, &res);
+}
+
+/* Decode a whole record into values before anything of it is logged */
+static bool schema_decode(const struct schema *schema, const uint8_t *rec, size_t len)
+{
+	size_t bitmap_len = SCHEMA_BITMAP_LEN(schema->num_fields);
+	const uint8_t *present = &rec[SCHEMA_RECORD_HDR];
+	const uint8_t *stale = &present[bitmap_len];
+	size_t pos = SCHEMA_RECORD_HDR + 2 * bitmap_len;
+	uint32_t raw;
+	size_t n;
+
+	if (len < pos) {
+		return false;
+	}
+
+	for (size_t i = 0; i < schema->num_fields; i++) {
+		values[i].present = present[i / 8] & BIT(i % 8);
+		values[i].stale = stale[i / 8] & BIT(i % 8);
+		if (!values[i].present) {
+			continue;
+		}
+
+		n = schema_get_varint(&rec[pos], len - pos, &raw);
+		if (n == 0) {
+			return false;
+		}
+		values[i].value = schema_unzigzag(raw);
+		pos += n;
+
+		if (values[i].stale) {
+			n = schema_get_varint(&rec[pos], len - pos, &values[i].age_s);
+			if (n == 0) {
+				return false;
+			}
+			pos += n;
+		}
+	}
+
+	return pos == len;
+}
+
+static void schema_print_values(const struct schema *schema)
+{
+	char field[SCHEMA_LAYOUT_MAX + 32];
+
+	printk("<DATA>");
+	for (size_t i = 0; i < schema->num_fields; i++) {
+		const struct schema_field *f = &schema->fields[i];
+		uint32_t scale = schema_pow10[f->precision];
+		uint32_t mag = values[i].value < 0 ? 0U - (uint32_t)values[i].value
+						   : (uint32_t)values[i].value;
+		int len = 0;
+
+		if (i > 0) {
+			field[len++] = ',';
+		}
+		memcpy(&field[len], &schema->layout[f->name], f->name_len);
+		len += f->name_len;
+		field[len++] = '=';
+
+		if (values[i].present) {
+			len += snprintf(&field[len], sizeof(field) - len, "%s%u",
+					values[i].value < 0 ? "-" : "", mag / scale);
+			if (f->precision > 0) {
+				len += snprintf(&field[len], sizeof(field) - len, ".%0*u",
+						f->precision, mag % scale);
+			}
+			if (values[i].stale) {
+				len += snprintf(&field[len], sizeof(field) - len, "@%u",
+						values[i].age_s);
+			}
+		}
+
+		field[MIN(len, sizeof(field) - 1)] = '\0';
+		printk("%s", field);
+	}
+	printk("</DATA>");
+}
+
+static void schema_print_raw(const uint8_t *rec, size_t len)
+{
+	char hex[2 * SCHEMA_RAW_CHUNK + 1];
+
+	printk("<RAW>");
+	for (size_t i = 0; i < len; i += SCHEMA_RAW_CHUNK) {
+		bin2hex(&rec[i], MIN(len - i, SCHEMA_RAW_CHUNK), hex, sizeof(hex));
+		printk("%s", hex);
+	}
+	printk("</RAW>");
+}
+
+uint16_t schema_print_record(const otMessage *msg, uint16_t offset, bool *known)
+{
+	static uint8_t rec[SCHEMA_RECORD_MAX];
+	uint16_t len = otMessageRead(msg, offset, rec,
+				     MIN(otMessageGetLength(msg) - offset, sizeof(rec)));
+	struct schema *schema = schema_find(rec[0]);
+
+	if (len >= SCHEMA_RECORD_HDR) {
+		len = MIN(len, SCHEMA_RECORD_HDR + rec[1]);
+	}
+
+	if (!schema) {
+		*known = false;
+		metrics_counter_inc(&schema_unknown);
+	}
+
+	if (schema && schema_decode(schema, rec, len)) {
+		schema->last_used = k_uptime_get();
+		metrics_counter_inc(&schema_records);
+		schema_print_values(schema);
+	} else {
+		schema_print_raw(rec, len);
+	}
+
+	return len;
+}
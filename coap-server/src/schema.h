@@ -0,0 +1,38 @@
+/*
+ * Schema registry of the sink, see schema_wire.h.
+ *
+ * Clients register the layout of their records once and then report
+ * compact binary records tagged with the schema ID. The sink keeps the
+ * layouts and logs the records with the field names, so the log stays
+ * readable when the fields change.
+ */
+
+#ifndef SCHEMA_H_
+#define SCHEMA_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <openthread/instance.h>
+#include <openthread/message.h>
+
+/**
+ * @brief Serve PUT /schema and register the metrics. CoAP must be started.
+ *
+ * A new schema is logged as "<SCHEMA id>layout</SCHEMA>", so the log can be
+ * decoded on its own.
+ */
+void schema_coap_init(otInstance *instance);
+
+/**
+ * @brief Log the compact record at offset of a /storedata payload.
+ *
+ * A record of a known schema is logged as
+ * "<DATA>name=value,name=value@age,name=</DATA>", any other as
+ * "<RAW>hex</RAW>". Call from the OpenThread thread.
+ *
+ * @param known cleared if the schema ID is not registered
+ * @return length of the record, at least 1
+ */
+uint16_t schema_print_record(const otMessage *msg, uint16_t offset, bool *known);
+
+#endif /* SCHEMA_H_ */
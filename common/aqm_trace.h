@@ -0,0 +1,24 @@
+/*
+ * Named trace points for the Zephyr CTF timeline.
+ *
+ * Each point is one CTF named event with two 32-bit arguments, so a trace
+ * viewer shows sensor fetches, bus transfers, command sleeps and CoAP
+ * exchanges next to the kernel's thread switches and ISRs. Names carry a
+ * _start/_end suffix where a point brackets a span and are limited to 20
+ * characters by the CTF named event. Without CONFIG_AQM_TRACE the points
+ * compile to nothing and their arguments are not evaluated.
+ */
+
+#ifndef AQM_TRACE_H_
+#define AQM_TRACE_H_
+
+#ifdef CONFIG_AQM_TRACE
+#include <zephyr/tracing/tracing.h>
+
+#define AQM_TRACE(_name, _arg0, _arg1)                                                             \
+	sys_trace_named_event(_name, (uint32_t)(_arg0), (uint32_t)(_arg1))
+#else
+#define AQM_TRACE(_name, _arg0, _arg1) ((void)0)
+#endif
+
+#endif /* AQM_TRACE_H_ */
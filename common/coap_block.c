@@ -0,0 +1,73 @@
+/*
+ * Block option helpers, see coap_block.h.
+ */
+
+#include <string.h>
+#include <zephyr/sys/util.h>
+
+#include "coap_block.h"
+
+/* Block option value: NUM << 4 | M << 3 | SZX, at most 3 bytes */
+#define BLOCK_M BIT(3)
+#define BLOCK_SZX_MASK BIT_MASK(3)
+#define BLOCK_SZX_RESERVED 7
+#define BLOCK_NUM_MAX BIT_MASK(20)
+
+bool coap_block_get(const otMessage *msg, uint16_t number, struct coap_block *block)
+{
+	otCoapOptionIterator iter;
+	uint64_t value;
+
+	if (otCoapOptionIteratorInit(&iter, msg) != OT_ERROR_NONE ||
+	    otCoapOptionIteratorGetFirstOptionMatching(&iter, number) == NULL ||
+	    otCoapOptionIteratorGetOptionUintValue(&iter, &value) != OT_ERROR_NONE) {
+		return false;
+	}
+
+	if ((value & BLOCK_SZX_MASK) == BLOCK_SZX_RESERVED || (value >> 4) > BLOCK_NUM_MAX) {
+		return false;
+	}
+
+	block->num = value >> 4;
+	block->more = (value & BLOCK_M) != 0;
+	block->szx = value & BLOCK_SZX_MASK;
+	return true;
+}
+
+otCoapBlockSzx coap_block_szx_fit(uint16_t budget, uint16_t overhead)
+{
+	otCoapBlockSzx szx = OT_COAP_OPTION_BLOCK_SZX_16;
+
+	while (szx < CONFIG_AQM_BLOCK_SZX_MAX && COAP_BLOCK_SIZE(szx + 1) + overhead <= budget) {
+		szx++;
+	}
+
+	return szx;
+}
+
+void coap_block_window_init(struct coap_block_window *win, char *buf, uint32_t num,
+			    otCoapBlockSzx szx)
+{
+	win->buf = buf;
+	win->size = COAP_BLOCK_SIZE(szx);
+	win->start = num * win->size;
+	win->len = 0;
+	win->pos = 0;
+}
+
+bool coap_block_window_put(struct coap_block_window *win, const char *data, size_t len)
+{
+	uint32_t end = win->start + win->size;
+
+	if (win->pos < end && win->pos + len > win->start) {
+		/* Overlap of [pos, pos + len) with [start, end) */
+		uint32_t from = MAX(win->pos, win->start);
+		uint32_t to = MIN(win->pos + len, end);
+
+		memcpy(&win->buf[from - win->start], &data[from - win->pos], to - from);
+		win->len += to - from;
+	}
+
+	win->pos += len;
+	return win->pos <= end;
+}
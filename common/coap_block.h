@@ -0,0 +1,83 @@
+/*
+ * Block-wise transfers (RFC 7959) on top of the OpenThread CoAP API.
+ *
+ * OpenThread can append Block1 and Block2 options but leaves reading them,
+ * and the transfer itself, to the application. A Block option carries the
+ * block number, a more flag and the block size as SZX: 16 << SZX bytes.
+ *
+ * Block2 responses here are stateless. Every request for block NUM generates
+ * the representation again and keeps only the bytes of that block, so no
+ * copy is held between the requests of a transfer.
+ */
+
+#ifndef AQM_COAP_BLOCK_H_
+#define AQM_COAP_BLOCK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <openthread/coap.h>
+
+#define COAP_BLOCK_SIZE(szx) (16U << (szx))
+
+/* Largest block served, see CONFIG_AQM_BLOCK_SZX_MAX */
+#define COAP_BLOCK_MAX_SIZE COAP_BLOCK_SIZE(CONFIG_AQM_BLOCK_SZX_MAX)
+
+struct coap_block {
+	uint32_t num;
+	bool more;
+	otCoapBlockSzx szx;
+};
+
+/**
+ * @brief Read the Block1 or Block2 option of a message.
+ *
+ * @param number OT_COAP_OPTION_BLOCK1 or OT_COAP_OPTION_BLOCK2
+ * @return false if the option is absent or malformed
+ */
+bool coap_block_get(const otMessage *msg, uint16_t number, struct coap_block *block);
+
+/**
+ * @brief Largest SZX whose blocks fit next to overhead bytes of header and
+ * options in budget bytes, at least 16-byte blocks.
+ */
+otCoapBlockSzx coap_block_szx_fit(uint16_t budget, uint16_t overhead);
+
+/*
+ * Collects the bytes of one Block2 block while the whole representation is
+ * generated piece by piece. Pieces before the block are skipped, the first
+ * byte past it tells that more follow.
+ */
+struct coap_block_window {
+	char *buf;
+	uint32_t start;
+	uint16_t size;
+	uint16_t len;
+	/* Bytes of the representation generated so far */
+	uint32_t pos;
+};
+
+/**
+ * @brief Start collecting block num of size 16 << szx into buf, which holds
+ * at least that many bytes.
+ */
+void coap_block_window_init(struct coap_block_window *win, char *buf, uint32_t num,
+			    otCoapBlockSzx szx);
+
+/**
+ * @brief Add the next piece of the representation.
+ *
+ * @return false once the block is complete and more is known, the rest of
+ * the representation does not need to be generated
+ */
+bool coap_block_window_put(struct coap_block_window *win, const char *data, size_t len);
+
+/**
+ * @brief Whether the representation continues after the block.
+ */
+static inline bool coap_block_window_more(const struct coap_block_window *win)
+{
+	return win->pos > win->start + win->size;
+}
+
+#endif /* AQM_COAP_BLOCK_H_ */
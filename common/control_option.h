@@ -0,0 +1,32 @@
+/*
+ * Reporting control carried in the responses to /storedata.
+ *
+ * A sink attaches its reporting parameters as a CoAP option to the ACKs it
+ * sends anyway, so an operator retunes every client reporting there without
+ * a single extra request. The option number is from the experimental range
+ * (RFC 7252, 12.2) and even, i.e. elective: clients that do not know it
+ * ignore it.
+ *
+ * A field of 0 tells the client to use its own configured value. The sink
+ * hint is optional; an option without it leaves the client's hint as it is,
+ * an all-zero EUI-64 clears it.
+ */
+
+#ifndef AQM_CONTROL_OPTION_H_
+#define AQM_CONTROL_OPTION_H_
+
+#define CONTROL_OPTION 65004
+
+/* Reporting period in seconds, big endian */
+#define CONTROL_INTERVAL_S 0
+/* Records merged into one report message */
+#define CONTROL_BATCH 2
+/* One report in this many is confirmable, the others are NON */
+#define CONTROL_CON_EVERY 3
+#define CONTROL_LEN 4
+
+/* EUI-64 of the sink the client should report to */
+#define CONTROL_SINK 4
+#define CONTROL_SINK_LEN 12
+
+#endif /* AQM_CONTROL_OPTION_H_ */
@@ -0,0 +1,283 @@
+/*
+ * Lock-free application metrics, see metrics.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/slist.h>
+
+#ifdef CONFIG_AQM_METRICS_SHELL
+#include <zephyr/shell/shell.h>
+#endif
+
+#ifdef CONFIG_AQM_METRICS_COAP
+#include <openthread/coap.h>
+#include <openthread/message.h>
+#endif
+
+#ifdef CONFIG_AQM_BLOCKWISE
+#include "coap_block.h"
+#endif
+#include "metrics.h"
+
+#define METRICS_LINE_LEN 160
+
+static sys_slist_t counters = SYS_SLIST_STATIC_INIT(&counters);
+static sys_slist_t histograms = SYS_SLIST_STATIC_INIT(&histograms);
+static struct k_spinlock register_lock;
+
+void metrics_counter_register(struct metrics_counter *counter)
+{
+	k_spinlock_key_t key = k_spin_lock(&register_lock);
+
+	sys_slist_append(&counters, &counter->node);
+	k_spin_unlock(&register_lock, key);
+}
+
+void metrics_histogram_register(struct metrics_histogram *hist)
+{
+	k_spinlock_key_t key = k_spin_lock(&register_lock);
+
+	sys_slist_append(&histograms, &hist->node);
+	k_spin_unlock(&register_lock, key);
+}
+
+void metrics_histogram_record(struct metrics_histogram *hist, uint32_t value)
+{
+	uint8_t bucket = 0;
+	atomic_val_t max;
+
+	/* A handful of bounds, a linear scan beats a binary search here */
+	while (bucket < hist->num_bounds && value > hist->bounds[bucket]) {
+		bucket++;
+	}
+
+	atomic_inc(&hist->buckets[bucket]);
+	atomic_inc(&hist->count);
+	atomic_add(&hist->sum, value);
+
+	do {
+		max = atomic_get(&hist->max);
+	} while ((uint32_t)max < value && !atomic_cas(&hist->max, max, value));
+}
+
+static void metrics_format_histogram(const struct metrics_histogram *hist, char *line,
+				     size_t len)
+{
+	int pos;
+
+	/* Fields are read one by one, a concurrent update may skew a line by one sample */
+	pos = snprintf(line, len, "%s n=%u sum=%u max=%u", hist->name,
+		       (uint32_t)atomic_get(&hist->count), (uint32_t)atomic_get(&hist->sum),
+		       (uint32_t)atomic_get(&hist->max));
+
+	for (uint8_t i = 0; i <= hist->num_bounds && pos > 0 && pos < len; i++) {
+		uint32_t n = atomic_get(&hist->buckets[i]);
+
+		if (i < hist->num_bounds) {
+			pos += snprintf(&line[pos], len - pos, " %u:%u", hist->bounds[i], n);
+		} else {
+			pos += snprintf(&line[pos], len - pos, " +inf:%u", n);
+		}
+	}
+}
+
+void metrics_foreach_line(metrics_line_cb_t cb, void *user_data)
+{
+	char line[METRICS_LINE_LEN];
+	struct metrics_counter *counter;
+	struct metrics_histogram *hist;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&counters, counter, node) {
+		snprintf(line, sizeof(line), "%s %u", counter->name,
+			 (uint32_t)atomic_get(&counter->value));
+		cb(line, user_data);
+	}
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&histograms, hist, node) {
+		metrics_format_histogram(hist, line, sizeof(line));
+		cb(line, user_data);
+	}
+}
+
+void metrics_reset(void)
+{
+	struct metrics_counter *counter;
+	struct metrics_histogram *hist;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&counters, counter, node) {
+		atomic_clear(&counter->value);
+	}
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&histograms, hist, node) {
+		for (uint8_t i = 0; i <= hist->num_bounds; i++) {
+			atomic_clear(&hist->buckets[i]);
+		}
+		atomic_clear(&hist->count);
+		atomic_clear(&hist->sum);
+		atomic_clear(&hist->max);
+	}
+}
+
+#ifdef CONFIG_AQM_METRICS_SHELL
+static void shell_line(const char *line, void *user_data)
+{
+	shell_print((const struct shell *)user_data, "%s", line);
+}
+
+static int cmd_stats(const struct shell *sh, size_t argc, char **argv)
+{
+	if (argc > 1) {
+		if (strcmp(argv[1], "reset") != 0) {
+			shell_error(sh, "unknown argument %s", argv[1]);
+			return -EINVAL;
+		}
+		metrics_reset();
+		return 0;
+	}
+
+	metrics_foreach_line(shell_line, (void *)sh);
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(aqm_cmds,
+	SHELL_CMD_ARG(stats, NULL, "Print metrics, \"stats reset\" zeroes them", cmd_stats, 1, 1),
+	SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(aqm, &aqm_cmds, "Air quality monitor", NULL);
+#endif /* CONFIG_AQM_METRICS_SHELL */
+
+#ifdef CONFIG_AQM_METRICS_COAP
+#ifdef CONFIG_AQM_BLOCKWISE
+static void coap_line(const char *line, void *user_data)
+{
+	struct coap_block_window *win = user_data;
+
+	if (coap_block_window_put(win, line, strlen(line))) {
+		coap_block_window_put(win, "\n", 1);
+	}
+}
+
+/*
+ * Append the block of the metrics text asked for in the Block2 option, the
+ * first one if there is none. The counters move between the requests of a
+ * transfer, every block shows the values at the time it was sent.
+ */
+static otError metrics_coap_block(otMessage *rsp, const otMessage *req)
+{
+	static char block_buf[COAP_BLOCK_MAX_SIZE];
+	struct coap_block block = { .szx = CONFIG_AQM_BLOCK_SZX_MAX };
+	struct coap_block_window win;
+	bool requested = coap_block_get(req, OT_COAP_OPTION_BLOCK2, &block);
+	otError err = OT_ERROR_NONE;
+
+	/* Answer a larger block size with ours, at the same byte offset */
+	if (block.szx > CONFIG_AQM_BLOCK_SZX_MAX) {
+		block.num <<= block.szx - CONFIG_AQM_BLOCK_SZX_MAX;
+		block.szx = CONFIG_AQM_BLOCK_SZX_MAX;
+	}
+
+	coap_block_window_init(&win, block_buf, block.num, block.szx);
+	metrics_foreach_line(coap_line, &win);
+	block.more = coap_block_window_more(&win);
+
+	if (requested || block.more) {
+		err = otCoapMessageAppendBlock2Option(rsp, block.num, block.more, block.szx);
+	}
+	if (err == OT_ERROR_NONE && win.len > 0) {
+		err = otCoapMessageSetPayloadMarker(rsp);
+	}
+	if (err == OT_ERROR_NONE) {
+		err = otMessageAppend(rsp, block_buf, win.len);
+	}
+
+	return err;
+}
+#else
+struct metrics_coap_ctx {
+	otMessage *msg;
+	size_t len;
+	bool full;
+};
+
+static void coap_line(const char *line, void *user_data)
+{
+	struct metrics_coap_ctx *ctx = user_data;
+	size_t line_len = strlen(line);
+
+	/* Whole lines only; the rest is cut so the response fits one IPv6 packet */
+	if (ctx->full || ctx->len + line_len + 1 > CONFIG_AQM_METRICS_COAP_MAX_PAYLOAD) {
+		ctx->full = true;
+		return;
+	}
+
+	if (otMessageAppend(ctx->msg, line, line_len) != OT_ERROR_NONE ||
+	    otMessageAppend(ctx->msg, "\n", 1) != OT_ERROR_NONE) {
+		ctx->full = true;
+		return;
+	}
+
+	ctx->len += line_len + 1;
+}
+#endif /* CONFIG_AQM_BLOCKWISE */
+
+static void metrics_coap_cb(void *context, otMessage *msg, const otMessageInfo *msg_info)
+{
+	otInstance *inst = context;
+	otMessage *rsp;
+	otError err;
+
+	if (otCoapMessageGetCode(msg) != OT_COAP_CODE_GET) {
+		return;
+	}
+
+	rsp = otCoapNewMessage(inst, NULL);
+	if (!rsp) {
+		return;
+	}
+
+	err = otCoapMessageInitResponse(rsp, msg,
+					otCoapMessageGetType(msg) == OT_COAP_TYPE_CONFIRMABLE
+						? OT_COAP_TYPE_ACKNOWLEDGMENT
+						: OT_COAP_TYPE_NON_CONFIRMABLE,
+					OT_COAP_CODE_CONTENT);
+	if (err == OT_ERROR_NONE) {
+		err = otCoapMessageAppendContentFormatOption(rsp,
+							     OT_COAP_OPTION_CONTENT_FORMAT_TEXT_PLAIN);
+	}
+#ifdef CONFIG_AQM_BLOCKWISE
+	if (err == OT_ERROR_NONE) {
+		err = metrics_coap_block(rsp, msg);
+	}
+#else
+	if (err == OT_ERROR_NONE) {
+		err = otCoapMessageSetPayloadMarker(rsp);
+	}
+	if (err == OT_ERROR_NONE) {
+		struct metrics_coap_ctx ctx = { .msg = rsp };
+
+		metrics_foreach_line(coap_line, &ctx);
+	}
+#endif
+	if (err == OT_ERROR_NONE) {
+		err = otCoapSendResponse(inst, rsp, msg_info);
+	}
+
+	if (err != OT_ERROR_NONE) {
+		otMessageFree(rsp);
+	}
+}
+
+void metrics_coap_init(otInstance *instance)
+{
+	static otCoapResource res = {
+		.mUriPath = "metrics",
+		.mHandler = metrics_coap_cb,
+	};
+
+	res.mContext = instance;
+	otCoapAddResource(instance, &res);
+}
+#endif /* CONFIG_AQM_METRICS_COAP */
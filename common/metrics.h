@@ -0,0 +1,156 @@
+/*
+ * Lock-free application metrics shared by coap-client and coap-server.
+ *
+ * Counters and fixed-bucket histograms are updated with atomic operations
+ * only, so they can be touched from any thread or from OpenThread callbacks
+ * and stay enabled in production. Metrics are registered once at init and
+ * read through the "aqm stats" shell command and the CoAP /metrics resource.
+ */
+
+#ifndef AQM_METRICS_H_
+#define AQM_METRICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/slist.h>
+#include <zephyr/sys/util.h>
+
+struct metrics_counter {
+	sys_snode_t node;
+	const char *name;
+	atomic_t value;
+};
+
+struct metrics_histogram {
+	sys_snode_t node;
+	const char *name;
+	/* Ascending upper bounds, values above the last go to an overflow bucket */
+	const uint32_t *bounds;
+	uint8_t num_bounds;
+	/* num_bounds + 1 buckets */
+	atomic_t *buckets;
+	atomic_t count;
+	atomic_t sum;
+	atomic_t max;
+};
+
+#define METRICS_COUNTER_DEFINE(_var, _name)                                                        \
+	static struct metrics_counter _var = {                                                     \
+		.name = _name,                                                                     \
+	}
+
+#define METRICS_HISTOGRAM_DEFINE(_var, _name, ...)                                                 \
+	static const uint32_t _var##_bounds[] = {__VA_ARGS__};                                     \
+	static atomic_t _var##_buckets[ARRAY_SIZE(_var##_bounds) + 1];                             \
+	static struct metrics_histogram _var = {                                                   \
+		.name = _name,                                                                     \
+		.bounds = _var##_bounds,                                                           \
+		.num_bounds = ARRAY_SIZE(_var##_bounds),                                           \
+		.buckets = _var##_buckets,                                                         \
+	}
+
+/* Bucket bounds shared by the duration histograms, in microseconds */
+#define METRICS_BOUNDS_US 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 100000, 1000000
+
+#ifdef CONFIG_AQM_METRICS
+
+/**
+ * @brief Make a counter visible to the readers. Call once, before it is updated.
+ */
+void metrics_counter_register(struct metrics_counter *counter);
+
+/**
+ * @brief Make a histogram visible to the readers. Call once, before it is updated.
+ */
+void metrics_histogram_register(struct metrics_histogram *hist);
+
+static inline void metrics_counter_inc(struct metrics_counter *counter)
+{
+	atomic_inc(&counter->value);
+}
+
+static inline void metrics_counter_add(struct metrics_counter *counter, uint32_t n)
+{
+	atomic_add(&counter->value, n);
+}
+
+/**
+ * @brief Overwrite the value, for counters used as gauges of sampled state.
+ */
+static inline void metrics_counter_set(struct metrics_counter *counter, uint32_t value)
+{
+	atomic_set(&counter->value, value);
+}
+
+/**
+ * @brief Add a value to a histogram.
+ */
+void metrics_histogram_record(struct metrics_histogram *hist, uint32_t value);
+
+/**
+ * @brief Record the microseconds since a k_cycle_get_32() timestamp.
+ */
+static inline void metrics_histogram_record_since(struct metrics_histogram *hist, uint32_t start)
+{
+	metrics_histogram_record(hist, k_cyc_to_us_floor32(k_cycle_get_32() - start));
+}
+
+typedef void (*metrics_line_cb_t)(const char *line, void *user_data);
+
+/**
+ * @brief Format every registered metric as one text line.
+ *
+ * Counters read "<name> <value>", histograms
+ * "<name> n=<count> sum=<sum> max=<max> <bound>:<count> ... +inf:<count>".
+ */
+void metrics_foreach_line(metrics_line_cb_t cb, void *user_data);
+
+/**
+ * @brief Zero all registered metrics.
+ */
+void metrics_reset(void);
+
+#else
+
+static inline void metrics_counter_register(struct metrics_counter *counter)
+{
+}
+
+static inline void metrics_histogram_register(struct metrics_histogram *hist)
+{
+}
+
+static inline void metrics_counter_inc(struct metrics_counter *counter)
+{
+}
+
+static inline void metrics_counter_add(struct metrics_counter *counter, uint32_t n)
+{
+}
+
+static inline void metrics_counter_set(struct metrics_counter *counter, uint32_t value)
+{
+}
+
+static inline void metrics_histogram_record(struct metrics_histogram *hist, uint32_t value)
+{
+}
+
+static inline void metrics_histogram_record_since(struct metrics_histogram *hist, uint32_t start)
+{
+}
+
+#endif /* CONFIG_AQM_METRICS */
+
+#ifdef CONFIG_AQM_METRICS_COAP
+#include <openthread/instance.h>
+
+/**
+ * @brief Serve the metrics as text/plain on GET /metrics. CoAP must be started.
+ */
+void metrics_coap_init(otInstance *instance);
+#endif
+
+#endif /* AQM_METRICS_H_ */
@@ -0,0 +1,120 @@
+/*
+ * OpenThread message buffer and link counter monitor, see ot_monitor.h.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/openthread.h>
+#include <zephyr/sys/atomic.h>
+#include <openthread/link.h>
+#include <openthread/message.h>
+
+#include "metrics.h"
+#include "ot_monitor.h"
+
+LOG_MODULE_REGISTER(ot_monitor, CONFIG_LOG_DEFAULT_LEVEL);
+
+BUILD_ASSERT(CONFIG_AQM_OT_MONITOR_LOW_WATERMARK < CONFIG_AQM_OT_MONITOR_HIGH_WATERMARK,
+	     "the backpressure watermarks need a gap for hysteresis");
+
+/* Gauges of the last sample */
+METRICS_COUNTER_DEFINE(ot_buf_total, "ot_buf_total");
+METRICS_COUNTER_DEFINE(ot_buf_free, "ot_buf_free");
+METRICS_COUNTER_DEFINE(ot_buf_max_used, "ot_buf_max_used");
+METRICS_COUNTER_DEFINE(ot_buf_min_free, "ot_buf_min_free");
+METRICS_COUNTER_DEFINE(ot_coap_queue, "ot_coap_queue");
+METRICS_COUNTER_DEFINE(ot_6lo_send_queue, "ot_6lo_send_queue");
+
+/* OpenThread's own MAC counters since boot */
+METRICS_COUNTER_DEFINE(ot_mac_tx, "ot_mac_tx");
+METRICS_COUNTER_DEFINE(ot_mac_tx_retry, "ot_mac_tx_retry");
+METRICS_COUNTER_DEFINE(ot_mac_tx_fail, "ot_mac_tx_fail");
+METRICS_COUNTER_DEFINE(ot_mac_tx_err_cca, "ot_mac_tx_err_cca");
+METRICS_COUNTER_DEFINE(ot_mac_rx, "ot_mac_rx");
+METRICS_COUNTER_DEFINE(ot_mac_rx_err, "ot_mac_rx_err");
+
+METRICS_COUNTER_DEFINE(ot_alloc_fail, "ot_alloc_fail");
+METRICS_COUNTER_DEFINE(ot_backpressure, "ot_backpressure");
+
+static atomic_t backpressure;
+static uint16_t min_free = UINT16_MAX;
+
+static void ot_monitor_raise(const char *reason)
+{
+	if (atomic_cas(&backpressure, 0, 1)) {
+		metrics_counter_inc(&ot_backpressure);
+		LOG_WRN("Backpressure on: %s", reason);
+	}
+}
+
+static void ot_monitor_sample(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct openthread_context *ctx = openthread_get_default_context();
+	const otMacCounters *mac;
+	otBufferInfo info;
+
+	openthread_api_mutex_lock(ctx);
+	otMessageGetBufferInfo(ctx->instance, &info);
+	mac = otLinkGetCounters(ctx->instance);
+
+	min_free = MIN(min_free, info.mFreeBuffers);
+	metrics_counter_set(&ot_buf_total, info.mTotalBuffers);
+	metrics_counter_set(&ot_buf_free, info.mFreeBuffers);
+	metrics_counter_set(&ot_buf_max_used, info.mMaxUsedBuffers);
+	metrics_counter_set(&ot_buf_min_free, min_free);
+	metrics_counter_set(&ot_coap_queue, info.mApplicationCoapQueue.mNumMessages);
+	metrics_counter_set(&ot_6lo_send_queue, info.m6loSendQueue.mNumMessages);
+
+	metrics_counter_set(&ot_mac_tx, mac->mTxTotal);
+	metrics_counter_set(&ot_mac_tx_retry, mac->mTxRetry);
+	metrics_counter_set(&ot_mac_tx_fail,
+			    mac->mTxDirectMaxRetryExpiry + mac->mTxIndirectMaxRetryExpiry);
+	metrics_counter_set(&ot_mac_tx_err_cca, mac->mTxErrCca);
+	metrics_counter_set(&ot_mac_rx, mac->mRxTotal);
+	metrics_counter_set(&ot_mac_rx_err,
+			    mac->mRxErrNoFrame + mac->mRxErrFcs + mac->mRxErrOther);
+	openthread_api_mutex_unlock(ctx);
+
+	if (info.mFreeBuffers < CONFIG_AQM_OT_MONITOR_LOW_WATERMARK) {
+		ot_monitor_raise("low message buffers");
+	} else if (info.mFreeBuffers >= CONFIG_AQM_OT_MONITOR_HIGH_WATERMARK &&
+		   atomic_cas(&backpressure, 1, 0)) {
+		LOG_INF("Backpressure off, %u free buffers", info.mFreeBuffers);
+	}
+
+	k_work_reschedule(dwork, K_MSEC(CONFIG_AQM_OT_MONITOR_INTERVAL_MS));
+}
+
+static K_WORK_DELAYABLE_DEFINE(sample_work, ot_monitor_sample);
+
+void ot_monitor_init(void)
+{
+	metrics_counter_register(&ot_buf_total);
+	metrics_counter_register(&ot_buf_free);
+	metrics_counter_register(&ot_buf_max_used);
+	metrics_counter_register(&ot_buf_min_free);
+	metrics_counter_register(&ot_coap_queue);
+	metrics_counter_register(&ot_6lo_send_queue);
+	metrics_counter_register(&ot_mac_tx);
+	metrics_counter_register(&ot_mac_tx_retry);
+	metrics_counter_register(&ot_mac_tx_fail);
+	metrics_counter_register(&ot_mac_tx_err_cca);
+	metrics_counter_register(&ot_mac_rx);
+	metrics_counter_register(&ot_mac_rx_err);
+	metrics_counter_register(&ot_alloc_fail);
+	metrics_counter_register(&ot_backpressure);
+
+	k_work_schedule(&sample_work, K_NO_WAIT);
+}
+
+void ot_monitor_alloc_failed(void)
+{
+	metrics_counter_inc(&ot_alloc_fail);
+	ot_monitor_raise("message allocation failed");
+}
+
+bool ot_monitor_backpressure(void)
+{
+	return atomic_get(&backpressure) != 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * OpenThread message buffer and link counter monitor.
+ *
+ * Samples the message pool (otMessageGetBufferInfo) and the MAC counters
+ * (otLinkGetCounters) periodically, exports them as metrics and keeps a
+ * backpressure flag: it is raised when free message buffers fall below
+ * CONFIG_AQM_OT_MONITOR_LOW_WATERMARK or a message allocation fails, and
+ * cleared once a sample sees at least CONFIG_AQM_OT_MONITOR_HIGH_WATERMARK
+ * free buffers again. Senders check the flag before they allocate.
+ */
+
+#ifndef AQM_OT_MONITOR_H_
+#define AQM_OT_MONITOR_H_
+
+#include <stdbool.h>
+
+#ifdef CONFIG_AQM_OT_MONITOR
+#include <zephyr/sys/atomic.h>
+
+/**
+ * @brief Register the metrics and start sampling. OpenThread must be initialized.
+ */
+void ot_monitor_init(void);
+
+/**
+ * @brief Report a failed otCoapNewMessage() or otMessageAppend(); raises backpressure at once.
+ */
+void ot_monitor_alloc_failed(void);
+
+/**
+ * @brief True while free message buffers are below the watermarks.
+ */
+bool ot_monitor_backpressure(void);
+
+#else
+
+static inline void ot_monitor_init(void)
+{
+}
+
+static inline void ot_monitor_alloc_failed(void)
+{
+}
+
+static inline bool ot_monitor_backpressure(void)
+{
+	return false;
+}
+
+#endif /* CONFIG_AQM_OT_MONITOR */
+
+#endif /* AQM_OT_MONITOR_H_ */
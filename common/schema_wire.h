@@ -0,0 +1,94 @@
+/*
+ * Compact records with registered schemas.
+ *
+ * A client registers the layout of its records once with its sink, with a
+ * CON PUT /schema of text/plain "<id> <layout>":
+ * - id, two hex digits, SCHEMA_ID_MIN or above;
+ * - layout, "name:unit:decimals" per field, comma separated, in record order,
+ *   e.g. "co2:ppm:0,temp:Cel:2".
+ * The sink answers 2.04, or 4.03 if it already has a different layout under
+ * that ID.
+ *
+ * From then on the client reports binary records:
+ *
+ *   id | len | present bitmap | stale bitmap | fields
+ *
+ * - len, bytes after the len byte;
+ * - the bitmaps, SCHEMA_BITMAP_LEN(fields) bytes each, bit i % 8 of byte
+ *   i / 8 for field i;
+ * - fields, for every present field the value times 10^decimals as a zigzag
+ *   varint, followed for a stale field by its age in seconds as a varint.
+ *
+ * Text records start with '<', so the ID range tells compact records apart
+ * and both can follow each other in one payload. A sink that does not know
+ * the ID logs the record as hex and answers a CON report with 4.12
+ * Precondition Failed, after which the client registers again.
+ */
+
+#ifndef AQM_SCHEMA_WIRE_H_
+#define AQM_SCHEMA_WIRE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCHEMA_URI "schema"
+
+#define SCHEMA_ID_MIN 0x80
+#define SCHEMA_IS_ID(byte) ((uint8_t)(byte) >= SCHEMA_ID_MIN)
+
+#define SCHEMA_MAX_FIELDS 32
+#define SCHEMA_LAYOUT_MAX 192
+
+#define SCHEMA_BITMAP_LEN(fields) (((fields) + 7) / 8)
+
+/* ID and len */
+#define SCHEMA_RECORD_HDR 2
+#define SCHEMA_RECORD_MAX (SCHEMA_RECORD_HDR + UINT8_MAX)
+
+/* Longest varint of a 32-bit value */
+#define SCHEMA_VARINT_MAX 5
+
+/* Longest record of a layout: every field present and stale, with 5-byte value and age */
+#define SCHEMA_RECORD_WORST(fields)                                                                \
+	(SCHEMA_RECORD_HDR + 2 * SCHEMA_BITMAP_LEN(fields) + (fields) * 2 * SCHEMA_VARINT_MAX)
+
+static inline uint32_t schema_zigzag(int32_t value)
+{
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t schema_unzigzag(uint32_t value)
+{
+	return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/* @return bytes written, at most SCHEMA_VARINT_MAX */
+static inline size_t schema_put_varint(uint8_t *buf, uint32_t value)
+{
+	size_t len = 0;
+
+	while (value >= 0x80) {
+		buf[len++] = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+	buf[len++] = value;
+
+	return len;
+}
+
+/* @return bytes read, 0 if the varint is cut off or too long */
+static inline size_t schema_get_varint(const uint8_t *buf, size_t len, uint32_t *value)
+{
+	*value = 0;
+
+	for (size_t i = 0; i < len && i < SCHEMA_VARINT_MAX; i++) {
+		*value |= (uint32_t)(buf[i] & 0x7f) << (7 * i);
+		if (!(buf[i] & 0x80)) {
+			return i + 1;
+		}
+	}
+
+	return 0;
+}
+
+#endif /* AQM_SCHEMA_WIRE_H_ */
@@ -0,0 +1,30 @@
+/*
+ * Thread Network Data service that announces a /storedata sink.
+ *
+ * Every coap-server registers the service with its CoAP port and EUI-64 as
+ * server data; OpenThread adds the server's RLOC16. Clients find the sinks by
+ * walking the services of the partition, so no sink needs a well-known
+ * address. The EUI-64 names a sink independently of its RLOC16, which
+ * changes with its role.
+ */
+
+#ifndef AQM_SINK_SERVICE_H_
+#define AQM_SINK_SERVICE_H_
+
+/* Service data, matched together with CONFIG_AQM_SINK_ENTERPRISE_NUMBER */
+#define SINK_SERVICE_DATA "storedata"
+#define SINK_SERVICE_DATA_LEN (sizeof(SINK_SERVICE_DATA) - 1)
+
+/*
+ * Service data of a client in the aggregation role, which takes the reports
+ * of its neighbours and uploads them in batches. Same server data.
+ */
+#define SINK_AGGREGATOR_SERVICE_DATA "storedata-agg"
+#define SINK_AGGREGATOR_SERVICE_DATA_LEN (sizeof(SINK_AGGREGATOR_SERVICE_DATA) - 1)
+
+/* Server data: the CoAP port, big endian, then the factory EUI-64 */
+#define SINK_SERVER_DATA_PORT 0
+#define SINK_SERVER_DATA_EUI64 2
+#define SINK_SERVER_DATA_LEN 10
+
+#endif /* AQM_SINK_SERVICE_H_ */
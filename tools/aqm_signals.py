@@ -0,0 +1,53 @@
+"""Synthetic sensor records shared by the host-side tools.
+
+The signals follow struct sensirion_emul_signal in
+coap-client/drivers/include/sensirion/emul.h and the default signals of the
+SCD4x and SPS30 emulators, so tools and native_sim runs see the same data.
+"""
+
+
+class Signal:
+    """Python port of struct sensirion_emul_signal (triangle wave plus seeded noise)."""
+
+    def __init__(self, base, amplitude, period_ms, noise, seed):
+        self.base = base
+        self.amplitude = amplitude
+        self.period_ms = period_ms
+        self.noise = noise
+        self.seed = seed & 0xFFFFFFFF
+
+    def at(self, t_ms):
+        value = self.base
+        if self.period_ms > 0 and self.amplitude != 0:
+            phase = t_ms % self.period_ms
+            half = max(self.period_ms // 2, 1)
+            if phase < half:
+                value += -self.amplitude + (2 * self.amplitude * phase) // half
+            else:
+                value += self.amplitude - (2 * self.amplitude * (phase - half)) // half
+        if self.noise > 0:
+            self.seed = (self.seed * 1664525 + 1013904223) & 0xFFFFFFFF
+            value += (self.seed >> 8) % (2 * self.noise + 1) - self.noise
+        return value
+
+
+class EmulatedSensors:
+    """Record of one client: SCD41 (co2, temp, humi) and SPS30 (pm2_5, pm10)."""
+
+    def __init__(self, seed):
+        self.co2 = Signal(650000, 150000, 600000, 5000, 0x62 + seed)
+        self.temp = Signal(23000, 500, 600000, 50, 1 + seed)
+        self.humi = Signal(45000, 2000, 600000, 200, 2 + seed)
+        self.pm2_5 = Signal(8000, 4000, 300000, 500, 0x69 + seed)
+
+    def record(self, t_ms):
+        pm2_5 = max(self.pm2_5.at(t_ms), 0) / 1000.0
+        # Same decimals per field as the client's channel table
+        fields = [
+            "%d" % (self.co2.at(t_ms) // 1000),
+            "%.2f" % (self.temp.at(t_ms) / 1000.0),
+            "%.2f" % (self.humi.at(t_ms) / 1000.0),
+            "%.2f" % pm2_5,
+            "%.2f" % (pm2_5 * 1.18),
+        ]
+        return "<DATA>" + ",".join(fields) + "</DATA>"
@@ -0,0 +1,292 @@
+#!/usr/bin/env python3
+"""CoAP load generator and replay tool for the /storedata server.
+
+Sends PUT /storedata requests with JSON content format over UDP, as
+coap-client does, at a fixed rate with a bound on outstanding confirmable
+requests. The payloads are either <DATA>...</DATA> records replayed from a
+captured client log or synthetic records from the emulator signals.
+
+The target is any UDP/IPv6 endpoint that answers PUT /storedata. An
+OpenThread posix node (simulated RCP) on the host, reached through its tun
+interface, is a stand-in: the figures describe that node, not coap-server.
+To load coap-server itself, target a board running it through a border
+router. Only the Python standard library is needed.
+
+    # 200 req/s for 60 s, 80 % confirmable, at most 32 outstanding
+    python3 tools/coap_load.py fdde:ad00:beef::1 --rate 200 --con 0.8 --concurrency 32
+
+    # replay a client log as fast as the server acknowledges
+    python3 tools/coap_load.py fdde:ad00:beef::1 --replay client.log --rate 0
+
+    # step the rate until the server saturates
+    python3 tools/coap_load.py fdde:ad00:beef::1 --sweep 50:1000:50 --duration 20
+
+Every run prints one JSON line: sent requests, responses by code, timeouts,
+retransmissions, throughput and the ACK round-trip distribution of
+confirmable requests (first transmission to response).
+"""
+
+import argparse
+import asyncio
+import json
+import math
+import os
+import random
+import re
+import socket
+import struct
+import sys
+import time
+
+from aqm_signals import EmulatedSensors
+
+URI = "storedata"
+CONTENT_FORMAT_JSON = 50
+
+TYPE_CON, TYPE_NON, TYPE_ACK, TYPE_RST = range(4)
+CODE_PUT = 3
+
+OPTION_URI_PATH = 11
+OPTION_CONTENT_FORMAT = 12
+
+# RFC 7252 transmission parameters
+ACK_TIMEOUT = 2.0
+ACK_RANDOM_FACTOR = 1.5
+MAX_RETRANSMIT = 4
+
+
+def encode_option(delta, value):
+    """Option with delta and length below 13, enough for the options used here."""
+    assert delta < 13 and len(value) < 13
+    return bytes([(delta << 4) | len(value)]) + value
+
+
+def encode_request(msg_type, message_id, token, payload):
+    header = struct.pack("!BBH", 0x40 | (msg_type << 4) | len(token), CODE_PUT, message_id)
+    options = encode_option(OPTION_URI_PATH, URI.encode())
+    options += encode_option(OPTION_CONTENT_FORMAT - OPTION_URI_PATH, bytes([CONTENT_FORMAT_JSON]))
+    return header + token + options + b"\xff" + payload
+
+
+def decode_response(data):
+    """Return (type, code string, message id, token) or None for a malformed datagram."""
+    if len(data) < 4 or data[0] >> 6 != 1:
+        return None
+    msg_type = (data[0] >> 4) & 0x3
+    tkl = data[0] & 0xF
+    code = data[1]
+    message_id = struct.unpack("!H", data[2:4])[0]
+    token = data[4:4 + tkl]
+    return msg_type, "%d.%02d" % (code >> 5, code & 0x1F), message_id, token
+
+
+def replay_source(path):
+    with open(path, errors="replace") as f:
+        records = re.findall(r"<DATA(?: \d+)?>.*?</DATA>", f.read())
+    if not records:
+        sys.exit("no <DATA> records in %s" % path)
+    while True:
+        for record in records:
+            yield record
+
+
+def synthetic_source(nodes, seed):
+    sensors = [EmulatedSensors(seed + i) for i in range(nodes)]
+    start = time.monotonic()
+    while True:
+        t_ms = int((time.monotonic() - start) * 1000)
+        for sensor in sensors:
+            yield sensor.record(t_ms)
+
+
+def percentile(values, p):
+    if not values:
+        return None
+    values = sorted(values)
+    k = (len(values) - 1) * p / 100.0
+    lo, hi = math.floor(k), math.ceil(k)
+    return round(values[lo] + (values[hi] - values[lo]) * (k - lo), 3)
+
+
+class Request:
+    def __init__(self, msg_type, data):
+        self.msg_type = msg_type
+        self.data = data
+        self.first_sent = time.monotonic()
+        self.sends = 1
+        self.done = asyncio.get_running_loop().create_future()
+
+
+class LoadClient(asyncio.DatagramProtocol):
+    def __init__(self, args):
+        self.args = args
+        self.transport = None
+        self.pending = {}
+        self.message_id = random.randrange(0x10000)
+        self.codes = {}
+        self.rtts_ms = []
+        self.sent = {"con": 0, "non": 0}
+        self.retransmissions = 0
+        self.timeouts = 0
+        self.unmatched = 0
+
+    def connection_made(self, transport):
+        self.transport = transport
+
+    def datagram_received(self, data, addr):
+        decoded = decode_response(data)
+        if decoded is None:
+            self.unmatched += 1
+            return
+        msg_type, code, message_id, token = decoded
+
+        request = self.pending.pop(token, None)
+        if request is None:
+            # Duplicate ACK after a retransmission, or a late response
+            self.unmatched += 1
+            return
+
+        key = "RST" if msg_type == TYPE_RST else code
+        self.codes[key] = self.codes.get(key, 0) + 1
+        if request.msg_type == TYPE_CON:
+            self.rtts_ms.append((time.monotonic() - request.first_sent) * 1000.0)
+        request.done.set_result(key)
+
+    def error_received(self, exc):
+        self.codes[type(exc).__name__] = self.codes.get(type(exc).__name__, 0) + 1
+
+    async def send(self, payload, confirmable):
+        self.message_id = (self.message_id + 1) & 0xFFFF
+        token = os.urandom(4)
+        msg_type = TYPE_CON if confirmable else TYPE_NON
+        request = Request(msg_type, encode_request(msg_type, self.message_id, token,
+                                                   payload.encode()))
+        self.pending[token] = request
+        self.sent["con" if confirmable else "non"] += 1
+        self.transport.sendto(request.data)
+
+        if not confirmable:
+            # The server does not answer NON requests; keep the token for error responses
+            asyncio.get_running_loop().call_later(ACK_TIMEOUT, self.pending.pop, token, None)
+            return
+
+        timeout = ACK_TIMEOUT * random.uniform(1.0, ACK_RANDOM_FACTOR)
+        for attempt in range(MAX_RETRANSMIT + 1):
+            try:
+                await asyncio.wait_for(asyncio.shield(request.done), timeout)
+                return
+            except asyncio.TimeoutError:
+                if attempt == MAX_RETRANSMIT or not self.args.retransmit:
+                    break
+                self.transport.sendto(request.data)
+                request.sends += 1
+                self.retransmissions += 1
+                timeout *= 2
+
+        self.pending.pop(token, None)
+        self.timeouts += 1
+
+
+async def run_load(args, rate, source):
+    loop = asyncio.get_running_loop()
+    family = socket.AF_INET6 if ":" in args.host else socket.AF_INET
+    transport, client = await loop.create_datagram_endpoint(
+        lambda: LoadClient(args), remote_addr=(args.host, args.port), family=family)
+
+    outstanding = asyncio.Semaphore(args.concurrency)
+    tasks = set()
+    rng = random.Random(args.seed)
+    start = time.monotonic()
+    sent = 0
+
+    async def one(payload, confirmable):
+        try:
+            await client.send(payload, confirmable)
+        finally:
+            outstanding.release()
+
+    while time.monotonic() - start < args.duration and (args.count == 0 or sent < args.count):
+        if rate > 0:
+            delay = start + sent / rate - time.monotonic()
+            if delay > 0:
+                await asyncio.sleep(delay)
+        await outstanding.acquire()
+        task = asyncio.create_task(one(next(source), rng.random() < args.con))
+        tasks.add(task)
+        task.add_done_callback(tasks.discard)
+        sent += 1
+
+    elapsed = time.monotonic() - start
+    if tasks:
+        await asyncio.gather(*tasks)
+    transport.close()
+
+    answered = sum(n for code, n in client.codes.items() if code.startswith("2."))
+    return {
+        "rate": rate,
+        "duration_s": round(elapsed, 3),
+        "sent": client.sent,
+        "retransmissions": client.retransmissions,
+        "timeouts": client.timeouts,
+        "codes": client.codes,
+        "unmatched": client.unmatched,
+        "throughput_per_s": round(answered / elapsed, 2) if elapsed > 0 else 0,
+        "ack_rtt_ms": {
+            "p50": percentile(client.rtts_ms, 50),
+            "p90": percentile(client.rtts_ms, 90),
+            "p99": percentile(client.rtts_ms, 99),
+            "max": round(max(client.rtts_ms), 3) if client.rtts_ms else None,
+        },
+    }
+
+
+def saturated(result, args):
+    con = result["sent"]["con"]
+    if con == 0:
+        return False
+    ok = sum(n for code, n in result["codes"].items() if code.startswith("2."))
+    return ok / con < args.min_success
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host", help="server address, e.g. fdde:ad00:beef::1")
+    parser.add_argument("--port", type=int, default=5683)
+    parser.add_argument("--rate", type=float, default=50, help="requests/s, 0 for unpaced")
+    parser.add_argument("--concurrency", type=int, default=16,
+                        help="maximum outstanding requests")
+    parser.add_argument("--con", type=float, default=1.0,
+                        help="share of confirmable requests 0..1")
+    parser.add_argument("--duration", type=float, default=60.0, help="seconds per run")
+    parser.add_argument("--count", type=int, default=0, help="stop after this many requests")
+    parser.add_argument("--replay", help="log file with <DATA> records to replay")
+    parser.add_argument("--nodes", type=int, default=30,
+                        help="synthetic nodes interleaved in the stream")
+    parser.add_argument("--no-retransmit", dest="retransmit", action="store_false",
+                        help="do not retransmit unacknowledged CON requests")
+    parser.add_argument("--sweep", help="START:STOP:STEP rates, stops at saturation")
+    parser.add_argument("--min-success", type=float, default=0.99,
+                        help="success ratio of CON requests below which a sweep stops")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    random.seed(args.seed)
+    source = replay_source(args.replay) if args.replay else synthetic_source(args.nodes, args.seed)
+
+    if not args.sweep:
+        print(json.dumps(asyncio.run(run_load(args, args.rate, source))))
+        return
+
+    start, stop, step = (float(v) for v in args.sweep.split(":"))
+    rate = start
+    while rate <= stop:
+        result = asyncio.run(run_load(args, rate, source))
+        print(json.dumps(result), flush=True)
+        if saturated(result, args):
+            print("saturated at %.0f req/s" % rate, file=sys.stderr)
+            break
+        rate += step
+
+
+if __name__ == "__main__":
+    main()
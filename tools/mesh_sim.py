@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+"""Load test of one /storedata server with N reporting clients on a simulated
+Thread mesh.
+
+The mesh runs in OTNS (OpenThread Network Simulator): every node is an
+OpenThread simulation-platform CLI node on a simulated 802.15.4 radio in
+virtual time. The server node plays coap-server (mesh-local ::1 address,
+/storedata resource answering CON requests with an ACK), each client node
+plays coap-client: every report interval it sends a CON PUT /storedata with a
+<DATA>...</DATA> record from the same synthetic signals as the SCD4x and SPS30
+emulators. The Zephyr firmware itself is not run, only its CoAP exchange.
+
+Topology, radio range, packet loss and report interval are configurable; the
+hop count follows from the topology and the node spacing relative to the
+radio range.
+
+The report has delivered samples/s, ACK round-trip percentiles, CoAP
+retransmissions and the server's message buffer usage. CoAP traffic is taken
+from OTNS' CoAP message collection ("coaps"), buffer usage from polling the
+server's "bufferinfo". All server figures describe the reference CLI node,
+whose "coap" command answers without any of coap-server's parsing, logging or
+overload handling; they bound what the radio and the OpenThread stack allow,
+not what coap-server achieves. This is a stand-in measurement, not a load
+test of the server.
+
+Requires OTNS (https://github.com/openthread/ot-ns) with its Python bindings
+(pylibs/ in the OTNS tree, "pip install ./pylibs"):
+
+    python3 tools/mesh_sim.py --clients 30 --topology grid --plr 0.05 --duration 600
+"""
+
+import argparse
+import json
+import math
+import random
+import re
+import sys
+
+try:
+    from otns.cli import OTNS
+except ImportError:
+    sys.exit("pyOTNS is required, install pylibs/ from the OTNS tree")
+
+from aqm_signals import EmulatedSensors
+
+URI = "storedata"
+
+
+def place_nodes(topology, count, spacing, rng):
+    """Positions of count nodes, the server first."""
+    if topology == "line":
+        # One hop per spacing if spacing is just below the radio range
+        return [(100 + i * spacing, 100) for i in range(count)]
+    if topology == "grid":
+        side = math.ceil(math.sqrt(count))
+        return [(100 + (i % side) * spacing, 100 + (i // side) * spacing) for i in range(count)]
+    if topology == "random":
+        side = math.ceil(math.sqrt(count)) * spacing
+        return [(100 + side / 2, 100 + side / 2)] + [
+            (100 + rng.uniform(0, side), 100 + rng.uniform(0, side)) for _ in range(count - 1)
+        ]
+    raise ValueError(topology)
+
+
+def percentile(values, p):
+    if not values:
+        return None
+    values = sorted(values)
+    k = (len(values) - 1) * p / 100.0
+    lo, hi = math.floor(k), math.ceil(k)
+    return values[lo] + (values[hi] - values[lo]) * (k - lo)
+
+
+def parse_bufferinfo(lines):
+    info = {}
+    for line in lines:
+        m = re.match(r"\s*([\w-]+):\s*(\d+)", line)
+        if m:
+            info[m.group(1)] = int(m.group(2))
+    return info
+
+
+def setup(ns, args, rng):
+    positions = place_nodes(args.topology, args.clients + 1, args.spacing, rng)
+    server = ns.add("router", *positions[0], radio_range=args.radio_range)
+    clients = [
+        ns.add(args.client_role, x, y, radio_range=args.radio_range) for x, y in positions[1:]
+    ]
+
+    ns.go(args.settle)
+
+    # Same address as add_meshlocal_routing_id_addr() in coap-server
+    prefix = ns.node_cmd(server, "meshlocalprefix")[0].split("/")[0]
+    server_addr = prefix.rstrip(":") + "::1"
+    ns.node_cmd(server, "ipaddr add %s" % server_addr)
+    ns.node_cmd(server, "coap start")
+    ns.node_cmd(server, "coap resource %s" % URI)
+
+    for node in clients:
+        ns.node_cmd(node, "coap start")
+
+    return server, clients, server_addr
+
+
+def run(ns, args, server, clients, server_addr, rng):
+    sensors = {node: EmulatedSensors(node) for node in clients}
+    # Clients start their cycles spread over one interval, like unsynchronised boots
+    next_send = {node: rng.uniform(0, args.interval) for node in clients}
+    buffer_samples = []
+    elapsed = 0.0
+    step = args.step
+
+    ns.coaps_enable()
+    start_us = ns.time
+
+    while elapsed < args.duration:
+        for node in clients:
+            if next_send[node] <= elapsed:
+                payload = sensors[node].record(int((start_us / 1000) + elapsed * 1000))
+                ns.node_cmd(node, "coap put %s %s con %s" % (server_addr, URI, payload))
+                next_send[node] += args.interval
+
+        ns.go(step)
+        elapsed += step
+
+        info = parse_bufferinfo(ns.node_cmd(server, "bufferinfo"))
+        if "free" in info:
+            buffer_samples.append(info)
+
+    # Let the last requests finish their retransmissions
+    ns.go(args.drain)
+
+    return ns.coaps(), buffer_samples
+
+
+def analyse(messages, buffer_samples, args, server):
+    requests = {}
+    acks = {}
+    sends = 0
+
+    for msg in messages:
+        key = (msg["src"], msg["id"])
+        if msg.get("uri") == URI and msg.get("type") == "CON":
+            sends += 1
+            if key in requests:
+                requests[key]["sends"] += 1
+            else:
+                requests[key] = {"time": msg["time"], "sends": 1, "delivered": False}
+            for rcv in msg.get("receivers", []):
+                if rcv["dst"] == server and not rcv.get("err"):
+                    requests[key]["delivered"] = True
+        elif msg.get("type") == "ACK" and msg["src"] == server:
+            for rcv in msg.get("receivers", []):
+                if not rcv.get("err"):
+                    acks.setdefault((rcv["dst"], msg["id"]), rcv["time"])
+
+    rtts_ms = []
+    for key, req in requests.items():
+        ack_time = acks.get(key)
+        if ack_time is not None and ack_time >= req["time"]:
+            rtts_ms.append((ack_time - req["time"]) / 1000.0)
+
+    delivered = sum(1 for r in requests.values() if r["delivered"])
+    free = [s["free"] for s in buffer_samples]
+
+    return {
+        "sink": "ot-cli",
+        "clients": args.clients,
+        "topology": args.topology,
+        "plr": args.plr,
+        "interval_s": args.interval,
+        "duration_s": args.duration,
+        "requests": len(requests),
+        "delivered": delivered,
+        "delivered_per_s": delivered / args.duration,
+        "acked": len(rtts_ms),
+        "retransmissions": sends - len(requests),
+        "ack_rtt_ms": {
+            "p50": percentile(rtts_ms, 50),
+            "p90": percentile(rtts_ms, 90),
+            "p99": percentile(rtts_ms, 99),
+            "max": max(rtts_ms) if rtts_ms else None,
+        },
+        "cli_sink_buffers": {
+            "total": buffer_samples[0].get("total") if buffer_samples else None,
+            "min_free": min(free) if free else None,
+            "exhausted_samples": sum(1 for f in free if f == 0),
+            "samples": len(free),
+        },
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--clients", type=int, default=30)
+    parser.add_argument("--topology", choices=["grid", "line", "random"], default="grid")
+    parser.add_argument("--spacing", type=float, default=120, help="node distance in OTNS units")
+    parser.add_argument("--radio-range", type=float, default=160)
+    parser.add_argument("--plr", type=float, default=0.0, help="packet loss ratio 0..1")
+    parser.add_argument("--client-role", choices=["router", "fed", "med", "sed"], default="router")
+    parser.add_argument("--interval", type=float, default=5.0, help="report interval in s")
+    parser.add_argument("--duration", type=float, default=300.0, help="measured time in s")
+    parser.add_argument("--settle", type=float, default=120.0, help="mesh formation time in s")
+    parser.add_argument("--drain", type=float, default=60.0, help="time after the last send in s")
+    parser.add_argument("--step", type=float, default=0.1, help="simulation step in s")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--otns-args", default="", help="extra arguments for the otns binary")
+    parser.add_argument("--json", action="store_true", help="print the report as JSON only")
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    ns = OTNS(otns_args=["-seed", str(args.seed)] + args.otns_args.split())
+    try:
+        ns.speed = float("inf")
+        ns.packet_loss_ratio = args.plr
+        server, clients, server_addr = setup(ns, args, rng)
+        messages, buffer_samples = run(ns, args, server, clients, server_addr, rng)
+    finally:
+        ns.close()
+
+    report = analyse(messages, buffer_samples, args, server)
+
+    if args.json:
+        print(json.dumps(report))
+        return
+
+    rtt = report["ack_rtt_ms"]
+    buffers = report["cli_sink_buffers"]
+    print("%d clients, %s topology, plr %.2f, interval %.1fs, %.0fs measured"
+          % (args.clients, args.topology, args.plr, args.interval, args.duration))
+    print("sink is the reference OT CLI node, not coap-server")
+    print("delivered        %d/%d (%.2f samples/s)"
+          % (report["delivered"], report["requests"], report["delivered_per_s"]))
+    print("retransmissions  %d" % report["retransmissions"])
+    if rtt["p50"] is not None:
+        print("ack rtt ms       p50 %.1f  p90 %.1f  p99 %.1f  max %.1f"
+              % (rtt["p50"], rtt["p90"], rtt["p99"], rtt["max"]))
+    if buffers["min_free"] is not None:
+        print("sink buffers     total %s  min free %d  exhausted in %d/%d samples"
+              % (buffers["total"], buffers["min_free"], buffers["exhausted_samples"],
+                 buffers["samples"]))
+    print(json.dumps(report))
+
+
+if __name__ == "__main__":
+    main()